@@ -8,9 +8,24 @@
 // ======================================================================
 
 #include <QtWidgets>
+#include <QtConcurrent>
 #include "MainWindow.h"
 #include "glWidget.h"
 #include "glvisualizer.h"
+#include "playbackStats.h"
+#include "statsPanel.h"
+#include "memoryPanel.h"
+#include "playQueue.h"
+#include "playlistIO.h"
+#include "libraryScanner.h"
+#include "libraryIndex.h"
+#include "coverArt.h"
+#include "sessionState.h"
+#include "trackSorter.h"
+#include "queryEngine.h"
+#include "resultCache.h"
+#include "traceRecorder.h"
+#include "metricsRegistry.h"
 
 #include <tag.h>
 #include <fileref.h>
@@ -22,13 +37,64 @@
 
 using namespace std;
 
-enum {TITLE, TRACK, TIME, ARTIST, ALBUM, GENRE, PATH};
-const int COLS = PATH;
+// largest side of cover flow images; pictures are decoded at this size
+const int COVER_SIZE = 256;
+
+// label covers kept decoded: about 100 at 100x100
+const int THUMB_BYTES = 100 * 100 * 100 * 4;
+
+// number of upcoming tracks whose waveform is generated ahead of time
+const int WAVEFORM_LOOKAHEAD = 3;
+
+// values coalesced until the next frame (bits of m_pendingMask)
+enum {UPDATE_POSITION = 1, UPDATE_DURATION = 2, UPDATE_STATUS = 4};
+
+// steps of a background library load (libraryRoot::phase)
+enum {LOAD_INDEX, LOAD_SCAN, LOAD_COVERS};
+
+// interval of the load progress display in ms
+const int LOAD_PROGRESS_MS = 100;
+
+// interval at which a changed session snapshot is written, in ms
+const int SESSION_MS = 5000;
+
+// library folder restored or scanned off the GUI thread, or the
+// merge of those loaded so far
+struct libraryLoad {
+    QString         root;           // folder, or rootsKey() if merged
+    trackStore      store;
+    QList<QImage>   covers;         // by album ID; in albumOrder() if merged
+    bool            fromIndex;
+    bool            stale;          // restored, but a folder has changed
+    QString         report;         // of the scan, if there was one
+    QByteArray      hash;           // sessionState::hashLibrary(), if merged
+};
+
+// playlist read off the GUI thread: the entries found on disk, in
+// order, and the files among them that were not in the library
+struct playlistLoad {
+    QStringList     paths;
+    QSharedPointer<libraryLoad> fresh;
+    int             missing;        // entries not on disk
+};
+
+static QSharedPointer<playlistLoad> importInBackground(QStringList, QStringList,
+                                                       const std::atomic<bool> *);
+
+// one library folder with its own load state, index and reader limit;
+// the counters are written by the loading thread, which gives up once
+// abort is set
+struct libraryRoot {
+    QString         path;
+    int             readers;        // concurrent tag reads on its drive
+    std::atomic<int> phase;
+    std::atomic<int> done;
+    std::atomic<int> total;         // 0 while unknown
+    std::atomic<bool> abort;        // set to end the load early
+    bool            loading;
+    QSharedPointer<libraryLoad> shard;  // last load, or null
+};
 
-bool caseInsensitive(const QString &s1, const QString &s2)
-{
-    return s1.toLower() < s2.toLower();
-}
 
 
 
@@ -37,8 +103,12 @@ bool caseInsensitive(const QString &s1, const QString &s2)
 //
 // Constructor. Initialize user-interface elements.
 //
-MainWindow::MainWindow	(QString program)
-       : m_directory(".") {
+MainWindow::MainWindow	(QString program, const QElapsedTimer *startup)
+       : m_directory("."), m_mergeAgain(false), m_importAbort(false), m_firstFrame(false),
+         m_libraryReady(false), m_sessionPending(false), m_trackResumed(false) {
+    if(startup)
+        m_startup = *startup;
+
     // set the focus for keyPressEvents to GUI
     setFocusPolicy(Qt::StrongFocus);
 
@@ -76,7 +146,19 @@ MainWindow::MainWindow	(QString program)
 //
 // Destructor. Save settings.
 //
-MainWindow::~MainWindow() {}
+MainWindow::~MainWindow() {
+    // the workers only touch their own stores, but must not outlive us;
+    // folder loads are cut short rather than waited for
+    for(auto it = m_rootJobs.begin(); it != m_rootJobs.end(); ++it)
+        it.value()->abort = true;
+    m_importAbort = true;
+    m_rootPool.waitForDone();
+    m_mergeWatcher->waitForFinished();
+    m_importWatcher->waitForFinished();
+    delete m_sorter;
+    delete m_query;
+    delete m_results;
+}
 
 
 
@@ -88,16 +170,30 @@ MainWindow::~MainWindow() {}
 void MainWindow::createActions() {
     // initializes a media player
     m_device = new QMediaPlayer;
-    // playlist
-    m_playlist = new QMediaPlaylist();
-    m_playlist->setCurrentIndex(0);
-    m_playlist->setPlaybackMode(QMediaPlaylist::Loop);
-    m_device->setPlaylist(m_playlist);
+    // play queue of track IDs; media is set one track at a time
+    m_queue = new playQueue(this);
+
+    // live playback counters and their debug panel
+    m_stats = new playbackStats(m_device, this);
+    m_statsPanel = NULL;
+    m_memoryPanel = NULL;
 
     m_loadAction = new QAction("&Load Music Folder", this);
     m_loadAction->setShortcut(tr("Ctrl+L"));
     connect(m_loadAction, SIGNAL(triggered()), this, SLOT(s_load()));
 
+    m_addRootAction = new QAction("&Add Music Folder...", this);
+    m_addRootAction->setShortcut(tr("Ctrl+Shift+L"));
+    connect(m_addRootAction, SIGNAL(triggered()), this, SLOT(s_addRoot()));
+
+    m_importAction = new QAction("&Import Playlist...", this);
+    m_importAction->setShortcut(tr("Ctrl+I"));
+    connect(m_importAction, SIGNAL(triggered()), this, SLOT(s_importPlaylist()));
+
+    m_exportAction = new QAction("&Export Playlist...", this);
+    m_exportAction->setShortcut(tr("Ctrl+E"));
+    connect(m_exportAction, SIGNAL(triggered()), this, SLOT(s_exportPlaylist()));
+
     m_quitAction = new QAction("&Quit", this);
     m_quitAction->setShortcut(tr("Ctrl+Q"));
     connect(m_quitAction, SIGNAL(triggered()), this, SLOT(close()));
@@ -106,8 +202,27 @@ void MainWindow::createActions() {
     m_aboutAction->setShortcut(tr("Ctrl+A"));
     connect(m_aboutAction, SIGNAL(triggered()), this, SLOT(s_about()));
 
-    connect(m_playlist, SIGNAL(currentIndexChanged(int)),
-            this, SLOT(updateSong()));
+    m_statsAction = new QAction("Playback &Stats", this);
+    connect(m_statsAction, SIGNAL(triggered()), this, SLOT(s_showStats()));
+
+    m_overlayAction = new QAction("Frame &Timing", this);
+    m_overlayAction->setShortcut(tr("Ctrl+Shift+F"));
+    m_overlayAction->setCheckable(true);
+    connect(m_overlayAction, SIGNAL(toggled(bool)), this, SLOT(s_toggleOverlay(bool)));
+
+    m_memoryAction = new QAction("&Memory Report", this);
+    connect(m_memoryAction, SIGNAL(triggered()), this, SLOT(s_showMemory()));
+
+    m_playNextAction = new QAction("Play &Next", this);
+    connect(m_playNextAction, SIGNAL(triggered()), this, SLOT(s_playNext()));
+
+    m_enqueueAction = new QAction("Add to &Queue", this);
+    connect(m_enqueueAction, SIGNAL(triggered()), this, SLOT(s_enqueue()));
+
+    connect(m_queue, SIGNAL(currentChanged(int)),
+            this, SLOT(s_trackChanged(int)));
+    connect(m_device, SIGNAL(mediaStatusChanged(QMediaPlayer::MediaStatus)),
+            this, SLOT(s_mediaStatusChanged(QMediaPlayer::MediaStatus)));
 }
 
 
@@ -120,9 +235,15 @@ void MainWindow::createActions() {
 void MainWindow::createMenus() {
     m_fileMenu = menuBar()->addMenu("&File");
     m_fileMenu->addAction(m_loadAction);
+    m_fileMenu->addAction(m_addRootAction);
+    m_fileMenu->addAction(m_importAction);
+    m_fileMenu->addAction(m_exportAction);
     m_fileMenu->addAction(m_quitAction);
 
     m_helpMenu = menuBar()->addMenu("&Help");
+    m_helpMenu->addAction(m_statsAction);
+    m_helpMenu->addAction(m_overlayAction);
+    m_helpMenu->addAction(m_memoryAction);
     m_helpMenu->addAction(m_aboutAction);
 }
 
@@ -161,11 +282,15 @@ void MainWindow::createWidgets() {
     // initialize list widgets: genre, artist, album
     for(int i=0; i<3; i++)
         m_panel[i] = new QListWidget;
+    m_panel[0]->setObjectName("genrePanel");
+    m_panel[1]->setObjectName("artistPanel");
+    m_panel[2]->setObjectName("albumPanel");
 
     // initialize table widget: complete song data
     m_table = new QTableWidget(0, COLS);
     QHeaderView *header = new QHeaderView(Qt::Horizontal,m_table);
     m_table->setHorizontalHeader(header);
+    m_table->setObjectName("songTable");
     m_table->horizontalHeader()->setSectionResizeMode(QHeaderView::Stretch);
     m_table->setHorizontalHeaderLabels(QStringList() <<
                                        "Name" << "Track" << "Time" << "Artist" << "Album" << "Genre");
@@ -174,14 +299,23 @@ void MainWindow::createWidgets() {
     m_table->setShowGrid(1);
     m_table->setEditTriggers (QAbstractItemView::NoEditTriggers);
     m_table->setSelectionBehavior(QAbstractItemView::SelectRows);
-
-    // initialize variable for sorting in table
+    m_table->setContextMenuPolicy(Qt::ActionsContextMenu);
+    m_table->addAction(m_playNextAction);
+    m_table->addAction(m_enqueueAction);
+
+    // initialize variables for sorting in table
+    m_sorter       = new trackSorter(&m_library);
+    m_query        = new queryEngine(&m_library);
+    m_results      = new resultCache(&m_library);
+    m_thumbs.setMaxCost(THUMB_BYTES);
+    m_facet[0] = m_facet[1] = m_facet[2] = -1;
+    m_sortColumn   = -1;
     m_ascendSorted = false;
 
     // initialize labels and sliders for current song playing
     m_albumLabel = new QLabel(QString("Album Cover"));
     m_albumLabel->setAlignment(Qt::AlignCenter);
-    m_positionSlider = new QSlider(Qt::Horizontal, this);
+    m_positionSlider = new waveformSlider(this);
     m_positionSlider->setEnabled(false);
     m_positionSlider->setToolTip(tr("Seek"));
     m_positionLabel = new QLabel(QString("0:00"));
@@ -189,6 +323,39 @@ void MainWindow::createWidgets() {
     m_infoLabel->setMaximumHeight(15);
     m_infoLabel->setAlignment(Qt::AlignHCenter);
 
+    // overviews are decoded in the background and cached on disk
+    m_waveforms = new waveformCache(this);
+
+    // frequent value updates are applied at most once per frame
+    qreal refresh = QGuiApplication::primaryScreen()->refreshRate();
+    m_pendingMask = 0;
+    m_frameTimer  = new QTimer(this);
+    m_frameTimer->setSingleShot(true);
+    m_frameTimer->setInterval(qMax(1, qRound(1000 / (refresh > 0 ? refresh : 60))));
+    connect(m_frameTimer, SIGNAL(timeout()), this, SLOT(s_flushUpdates()));
+
+    // progress of background library loads, shown in the status bar
+    m_mergeWatcher = new QFutureWatcher<QSharedPointer<libraryLoad>>(this);
+    connect(m_mergeWatcher, SIGNAL(finished()), this, SLOT(s_libraryLoaded()));
+    m_importWatcher = new QFutureWatcher<QSharedPointer<playlistLoad>>(this);
+    connect(m_importWatcher, SIGNAL(finished()), this, SLOT(s_playlistImported()));
+    m_loadBar = new QProgressBar;
+    m_loadBar->setMaximumWidth(150);
+    m_loadBar->setTextVisible(false);
+    m_loadBar->hide();
+    statusBar()->addPermanentWidget(m_loadBar);
+    m_loadTimer = new QTimer(this);
+    m_loadTimer->setInterval(LOAD_PROGRESS_MS);
+    connect(m_loadTimer, SIGNAL(timeout()), this, SLOT(s_loadProgress()));
+
+    // the session is saved periodically once changed, and on close
+    m_resumePosition = -1;
+    m_sessionDirty   = false;
+    m_sessionTimer = new QTimer(this);
+    m_sessionTimer->setInterval(SESSION_MS);
+    connect(m_sessionTimer, SIGNAL(timeout()), this, SLOT(s_saveSession()));
+    m_sessionTimer->start();
+
     // initialize tool buttons and slider dealing with playing songs
     m_stop = new QToolButton(this);
     m_play = new QToolButton(this);
@@ -217,21 +384,31 @@ void MainWindow::createWidgets() {
     // initialize widgets for searching through table items
     m_typeSearch = new QLineEdit();
     m_typeSearch->setMinimumWidth(70);
+    m_typeSearch->setObjectName("searchText");
     m_search = new QComboBox(this);
+    m_search->setObjectName("searchField");
     m_search->addItem("Search");
     m_search->addItem("Song Title");
     m_search->addItem("Artist");
     m_search->addItem("Album");
+    m_search->addItem("Query");
 
     // create gl widgets (visualizer and cover flow)
     m_glWidget= new glWidget();
+    m_glWidget->setObjectName("coverFlow");
     m_visualizer = new glVisualizer();
     m_glWidget->update();
 
+    // kiosks start with the frame timing shown (QTUNES_OVERLAY=1)
+    if(qgetenv("QTUNES_OVERLAY") == "1")
+        m_overlayAction->setChecked(true);
+
     // initialize buttons for gl widgets
     m_next = new QToolButton(this);
+    m_next->setObjectName("nextCover");
     m_next->setSizePolicy(QSizePolicy::Fixed, QSizePolicy::Expanding);
     m_previous = new QToolButton(this);
+    m_previous->setObjectName("previousCover");
     m_previous->setSizePolicy(QSizePolicy::Fixed, QSizePolicy::Expanding);
     m_toggleColor = new QPushButton(this);
     m_toggleColor->setText("Toggle Color");
@@ -280,6 +457,8 @@ void MainWindow::createWidgets() {
             this, SLOT(s_updateDuration(qint64)));
     connect(m_positionSlider, SIGNAL(valueChanged(int)),
             this, SLOT(s_setPosition(int)));
+    connect(m_waveforms, SIGNAL(ready(const QString &)),
+            this, SLOT(s_waveformReady(const QString &)));
 
     connect(m_volumeSlider, SIGNAL(valueChanged(int)),
             m_device, SLOT(setVolume(int)));
@@ -298,6 +477,25 @@ void MainWindow::createWidgets() {
             this, SLOT(s_shuffle()));
     connect(m_repeat, SIGNAL(clicked()),
             this, SLOT(s_repeat()));
+
+    // anything kept in the session snapshot marks it for saving; the
+    // position while playing does not, it is saved with the next change
+    // and on close
+    connect(m_queue, SIGNAL(currentChanged(int)),              this, SLOT(s_sessionChanged()));
+    connect(m_device, SIGNAL(stateChanged(QMediaPlayer::State)), this, SLOT(s_sessionChanged()));
+    connect(m_device, SIGNAL(mutedChanged(bool)),              this, SLOT(s_sessionChanged()));
+    connect(m_volumeSlider, SIGNAL(valueChanged(int)),         this, SLOT(s_sessionChanged()));
+    connect(m_typeSearch, SIGNAL(textChanged(QString)),        this, SLOT(s_sessionChanged()));
+    connect(m_search, SIGNAL(activated(int)),                  this, SLOT(s_sessionChanged()));
+    connect(header, SIGNAL(sectionDoubleClicked(int)),         this, SLOT(s_sessionChanged()));
+    for(int p=0; p<3; p++)
+        connect(m_panel[p], SIGNAL(itemClicked(QListWidgetItem*)), this, SLOT(s_sessionChanged()));
+    connect(m_shuffle, SIGNAL(clicked()),                      this, SLOT(s_sessionChanged()));
+    connect(m_repeat, SIGNAL(clicked()),                       this, SLOT(s_sessionChanged()));
+    connect(m_previous, SIGNAL(clicked()),                     this, SLOT(s_sessionChanged()));
+    connect(m_next, SIGNAL(clicked()),                         this, SLOT(s_sessionChanged()));
+    connect(m_leftMoveAction, SIGNAL(triggered()),             this, SLOT(s_sessionChanged()));
+    connect(m_rightMoveAction, SIGNAL(triggered()),            this, SLOT(s_sessionChanged()));
 }
 
 
@@ -392,153 +590,159 @@ void MainWindow::createLayouts() {
 // Populate lists with data (first time).
 //
 void MainWindow::initLists() {
-    // error checking
-    if(m_listSongs.isEmpty()) return;
-
-    // create separate lists for genres, artists, and albums
-    m_listGenre << QString("ALL");
-    for(int i=0; i<m_listSongs.size(); i++) {
-        m_listGenre << m_listSongs[i][GENRE];
-        m_listArtist << m_listSongs[i][ARTIST];
-        m_listAlbum << m_listSongs[i][ALBUM];
+    TRACE_SCOPE("MainWindow::initLists", "ui");
+    // error checking; no IDs of an earlier library may be left
+    if(m_library.isEmpty()) {
+        m_listGenre.clear();
+        m_listArtist.clear();
+        m_listAlbum.clear();
+        return;
     }
 
-    // sort each list
-    qStableSort(m_listGenre .begin()+1, m_listGenre .end(), caseInsensitive);
-    qStableSort(m_listArtist.begin(), m_listArtist.end(), caseInsensitive);
-    qStableSort(m_listAlbum .begin(), m_listAlbum .end(), caseInsensitive);
+    // distinct genres, artists, and albums in collation order
+    m_listGenre  = m_library.distinctValues(GENRE);
+    m_listArtist = m_library.distinctValues(ARTIST);
+    m_listAlbum  = m_library.albumOrder();
 
-    // add each list to list widgets, filtering out repeated strings
-    for(int i=0; i<m_listGenre.size(); i+=m_listGenre.count(m_listGenre[i]))
-        m_panel[0]->addItem(m_listGenre [i]);
-    // do same for m_listArtist and m_listAlbum to populate m_panel[1] and m_panel[2]
-    for(int i=0; i<m_listArtist.size(); i+=m_listArtist.count(m_listArtist[i]))
-        m_panel[1]->addItem(m_listArtist[i]);
-    for(int i=0; i<m_listAlbum.size(); i+=m_listAlbum.count(m_listAlbum[i]))
-        m_panel[2]->addItem(m_listAlbum[i]);
-
-    // copy data to table widget
-    QTableWidgetItem *item[COLS];
-    for(int i=0; i<m_listSongs.size(); i++) {
-        m_table->insertRow(i);
-        for(int j=0; j<COLS; j++) {
-            item[j] = new QTableWidgetItem;
-            item[j]->setText(m_listSongs[i][j]);
-            item[j]->setTextAlignment(Qt::AlignCenter);
-            m_table->setItem(i, j, item[j]);
-        }
-        m_playlist->addMedia(QUrl::fromLocalFile(m_listSongs[i][PATH]));
-    }
+    // show everything matching the current search
+    m_facet[0] = m_facet[1] = m_facet[2] = -1;
+    applyFilter();
 }
 
 
 
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
-// MainWindow::redrawLists:
-//
-// Re-populate lists with data matching item's text in field x.
-//
-void MainWindow::redrawLists(QListWidgetItem *listItem, int x) {
-    m_table->setRowCount(0);
-
-    // copy data to table widget
-    for(int i=0,row=0; i<m_listSongs.size(); i++) {
-        // skip rows whose field doesn't match text
-        if(m_listSongs[i][x] != listItem->text()) continue;
-
-        m_table->insertRow(row);
-        QTableWidgetItem *item[COLS];
-        for(int j=0; j<COLS; j++) {
-            item[j] = new QTableWidgetItem;
-            item[j]->setText(m_listSongs[i][j]);
-            item[j]->setTextAlignment(Qt::AlignCenter);
-            // put item[j] into m_table in proper row and column j
-            m_table->setItem(row, j, item[j]);
+// MainWindow::fillPanel:
+//
+// Refill a panel with the values of field f that have tracks, each
+// with its track count; each item keeps its value ID. The album panel
+// holds album IDs and names the artist of albums sharing a title.
+//
+void MainWindow::fillPanel(int panel, int f, const QVector<int> &values,
+                           const QVector<int> &counts) {
+    QListWidget *list = m_panel[panel];
+    list->clear();
+
+    QListWidgetItem *all = new QListWidgetItem("ALL", list);
+    all->setData(Qt::UserRole, -1);
+    if(m_facet[panel] < 0) list->setCurrentItem(all);
+
+    for(int i=0; i<values.size(); i++) {
+        int count = counts[values[i]];
+        if(!count) continue;
+
+        QString text;
+        if(f == ALBUM) {
+            const trackAlbum &album = m_library.albumInfo(values[i]);
+            text = m_library.value(ALBUM, album.title);
+            if((i > 0 && m_library.albumInfo(values[i-1]).title == album.title) ||
+               (i+1 < values.size() && m_library.albumInfo(values[i+1]).title == album.title))
+                text += " - " + m_library.value(ARTIST, album.artist);
         }
+        else
+            text = m_library.value(f, values[i]);
 
-        // increment table row index (row <= i)
-        row++;
+        QListWidgetItem *item = new QListWidgetItem(QString("%1 (%2)")
+                .arg(text).arg(count), list);
+        item->setData(Qt::UserRole, values[i]);
+        if(values[i] == m_facet[panel]) list->setCurrentItem(item);
     }
 }
 
 
 
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
-// MainWindow::traverseDirs:
+// MainWindow::applyFilter:
 //
-// Traverse all subdirectories and collect filenames into m_listSongs.
+// Evaluate the search query, narrow it by the genre, artist, and album
+// picked in the panels, and show the result in the current sort order.
+// Each panel lists the values left by the query and the panels above
+// it. Recently shown results come from m_results.
 //
-void MainWindow::traverseDirs(QString path) {
-
-    QString			key, val;
-    QStringList		list;
+void MainWindow::applyFilter() {
+    TRACE_SCOPE("MainWindow::applyFilter", "ui");
+    TRACE_DETAIL(m_searchText);
 
-    // init listDirs with subdirectories of path
-    QDir dir(path);
-    dir.setFilter(QDir::AllDirs | QDir::NoDotAndDotDot);
-    QFileInfoList listDirs = dir.entryInfoList();
+    static const int fields[3] = {GENRE, ARTIST, ALBUM};
+    const QVector<int> *lists[3] = {&m_listGenre, &m_listArtist, &m_listAlbum};
 
-    // init listFiles with all *.mp3 files in path
-    QDir files(path);
-    files.setFilter(QDir::Files);
-    files.setNameFilters(QStringList("*.mp3"));
-    QFileInfoList listFiles = files.entryInfoList();
+    // panel picks, sort column, and query identify a result
+    QString key = QString("%1 %2 %3 %4 ").arg(m_facet[0]).arg(m_facet[1])
+                  .arg(m_facet[2]).arg(m_sortColumn) + m_searchText;
 
-    for(int i=0; i<listFiles.size(); i++) {
-        // init list with default values: ""
-        for(int j=0; j<=COLS; j++)
-            list.insert(j, "");
+    resultCache::entry shown;
+    const resultCache::entry *cached = m_results->lookup(key);
+    if(cached)
+        shown = *cached;
+    else {
+        trackBitmap result;
+        QString error;
+        if(!m_query->evaluate(m_searchText, &result, &error)) {
+            showStatus(QString("Query: %1").arg(error));
+            return;
+        }
 
-        // store file pathname into 0th position in list
-        QFileInfo fileInfo = listFiles.at(i);
-        list.replace(PATH, fileInfo.filePath());
+        for(int p=0; p<2; p++) {
+            shown.counts[p] = m_query->facetCounts(fields[p], result);
+            if(m_facet[p] >= 0)
+                result = result & m_query->postings(fields[p], m_facet[p]);
+        }
+        shown.counts[2] = m_query->albumCounts(result);
+        if(m_facet[2] >= 0)
+            result = result & m_query->albumPostings(m_facet[2]);
+        shown.tracks = result.toVector();
+        if(m_sortColumn >= 0)
+            shown.tracks = m_sorter->sort(shown.tracks, m_sortColumn);
+        m_results->insert(key, shown);
+    }
 
-        // convert it from QString to Ascii and store in source using TabLib
-        TagLib::FileRef source(QFile::encodeName(fileInfo.filePath()).constData());
+    for(int p=0; p<3; p++)
+        fillPanel(p, fields[p], *lists[p], shown.counts[p]);
 
-        // process all song tags
-        // store tag value in proper position in list
-        if(!source.isNull()&& source.tag()) {
+    m_viewTracks = shown.tracks;
+    fillRows(m_viewTracks, m_sortColumn >= 0 && !m_ascendSorted);
+}
 
-            // gets tag key
-            TagLib::Tag *tag=source.tag();
-            if(tag->genre()!="")
-                list.replace(GENRE,TStringToQString(tag->genre()));
-            if(tag->artist()!="")
-                list.replace(ARTIST,TStringToQString(tag->artist()));
-            if(tag->album()!="")
-                list.replace(ALBUM,TStringToQString(tag->album()));
-            if(tag->title()!="")
-                list.replace(TITLE,TStringToQString(tag->title()));
 
-            list.replace(TRACK ,QString("%1").arg(tag->track()));
 
-            // gets the length of the source's audio properties and stores length with time format
-            if(source.audioProperties()) {
-                int seconds=source.audioProperties()->length()%60;
-                int minutes=source.audioProperties()->length()/60;
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// MainWindow::fillTable:
+//
+// Re-populate table with the given tracks, in order. The table is
+// shown unsorted until a header is double-clicked.
+//
+void MainWindow::fillTable(const QVector<int> &tracks) {
+    m_viewTracks = tracks;
+    m_sortColumn = -1;
+    m_table->horizontalHeader()->setSortIndicatorShown(false);
+    fillRows(tracks, false);
+}
 
-                if(seconds<10)
-                    list.replace(TIME,QString("%1:0%2").arg(minutes).arg(seconds));
-                else
-                    list.replace(TIME,QString("%1:%2").arg(minutes).arg(seconds));
-            }
-        }
 
-        // append list (song data) into songlist m_listSongs;
-        // uninitialized fields are empty strings
-        m_listSongs << list;
-    }
 
-    // base case: no more subdirectories
-    if(listDirs.size() == 0) return;
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// MainWindow::fillRows:
+//
+// Creates one table row per track, last track first if reversed.
+//
+void MainWindow::fillRows(const QVector<int> &tracks, bool reversed) {
+    TRACE_SCOPE("MainWindow::fillRows", "ui");
+    m_table->setRowCount(0);
+    m_table->setRowCount(tracks.size());
 
-    // recursively descend through all subdirectories
-    for(int i=0; i<listDirs.size(); i++) {
-        QFileInfo fileInfo = listDirs.at(i);
-        traverseDirs( fileInfo.filePath() );
+    // copy data to table widget
+    int n = tracks.size();
+    for(int row=0; row<n; row++) {
+        int i = tracks[reversed ? n-1 - row : row];
+        QTableWidgetItem *item[COLS];
+        for(int j=0; j<COLS; j++) {
+            item[j] = new QTableWidgetItem;
+            item[j]->setText(m_library.field(i, j));
+            item[j]->setTextAlignment(Qt::AlignCenter);
+            m_table->setItem(row, j, item[j]);
+        }
+        item[TITLE]->setData(Qt::UserRole, i);
     }
-    return;
 }
 
 
@@ -563,6 +767,7 @@ void MainWindow::setSizes(QSplitter *splitter, int size1, int size2) {
 // Slot function for File|Load
 //
 void MainWindow::s_load() {
+    TRACE_SLOT("MainWindow::s_load");
     // open a file dialog box
     QFileDialog *fd = new QFileDialog;
 
@@ -574,95 +779,193 @@ void MainWindow::s_load() {
     // check if cancel was selected
     if(s == NULL) return;
 
-    // copy full pathname of selected directory into m_directory
-    m_directory = s;
+    loadLibrary(s);
+}
 
-    traverseDirs(m_directory);
-    saveDir(m_directory);
-    initLists();
-    initAlbums();
-    m_glWidget->loadImages(m_albumsList);
 
-    //initializes the album cover with default image musicnote.png
-    QImage temp;
-    temp.load("C:/Users/Amy/Documents/Spring 2015/CSC221/v2/musicnote.png");
-    m_cover = temp.scaled(100, 100, Qt::KeepAspectRatio);
-    m_albumLabel->setAlignment(Qt::AlignHCenter | Qt::AlignVCenter);
-    m_albumLabel->setPixmap(QPixmap::fromImage(m_cover));
 
-    s_mediaStateChanged(m_device->state());
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// MainWindow::loadLibrary:
+//
+// Scans dir in the background as the only library folder and
+// remembers it for the next start. The library shown stays until the
+// scan is done; loads of the folders it replaces are aborted.
+//
+void MainWindow::loadLibrary(const QString &dir) {
+    TRACE_SCOPE("MainWindow::loadLibrary", "load");
+    // copy full pathname of selected directory into m_directory
+    m_directory = dir;
+    setRoots(QStringList(dir));
+    saveRoots();
+    m_sessionPending = false;
+    m_importShard.clear();
+
+    loadRoot(m_roots.first(), false);
 }
 
 
 
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
-// MainWindow::s_panel1:
-//
-// Slot function to adjust data if an item in panel1 (genre) is selected.
-//
-void MainWindow::s_panel1(QListWidgetItem *item) {
-    // replaces the table with original items loaded
-    if(item->text() == "ALL") {
-        m_panel[1] ->clear();
-        m_panel[2] ->clear();
-        m_panel[0] ->clear();
-        m_table->setRowCount(0);
-        initLists();
+// MainWindow::s_importPlaylist:
+//
+// Slot function for File|Import Playlist. Entries already in the
+// library are found by path; only missing files are tag-parsed, off
+// the GUI thread (see s_playlistImported). The playlist becomes the
+// play queue and the table.
+//
+void MainWindow::s_importPlaylist() {
+    TRACE_SLOT("MainWindow::s_importPlaylist");
+    QString fileName = QFileDialog::getOpenFileName(this, "Import Playlist",
+            m_directory, "Playlists (*.m3u *.m3u8 *.pls)");
+    if(fileName.isEmpty()) return;
+
+    playlistReader reader;
+    if(!reader.open(fileName)) {
+        QMessageBox::warning(this, "Import Playlist",
+                             QString("Cannot open %1").arg(fileName));
         return;
     }
 
-    // clear lists
-    m_panel[1] ->clear();
-    m_panel[2] ->clear();
-    m_listArtist.clear();
-    m_listAlbum .clear();
-
-    // collect list of artists and albums
-    for(int i=0; i<m_listSongs.size();i++) {
-        if(m_listSongs[i][GENRE]==item->text()) {
-            m_listAlbum<<m_listSongs[i][ALBUM];
-            m_listArtist<<m_listSongs[i][ARTIST];
+    // files not in the library are read in the background
+    QStringList entries, unknown;
+    QString path;
+    while(reader.next(&path)) {
+        entries << path;
+        if(m_library.find(path) < 0)
+            unknown << path;
+    }
+
+    m_importAction->setEnabled(false);
+    m_importAbort = false;
+    m_importWatcher->setFuture(QtConcurrent::run(importInBackground, entries, unknown,
+                                                 &m_importAbort));
+    showStatus(QString("Importing %1 songs").arg(entries.size()));
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// MainWindow::s_playlistImported:
+//
+// Slot function for a playlist read in the background. Its new files
+// join the library right away, so that the playlist can become the
+// play queue and the table; they are also kept as a part of their own,
+// which a merge in the background adds to the panels and cover flow
+// and every later merge keeps.
+//
+void MainWindow::s_playlistImported() {
+    TRACE_SLOT("MainWindow::s_playlistImported");
+    QSharedPointer<playlistLoad> import = m_importWatcher->result();
+    m_importAction->setEnabled(true);
+    const libraryLoad &fresh = *import->fresh;
+
+    if(!fresh.store.isEmpty()) {
+        m_library.append(fresh.store);
+        m_libraryHash = sessionState::hashLibrary(m_library);
+
+        // a merge may be reading the last part, so this one is new;
+        // albums new to it take their cover from the file holding it
+        QSharedPointer<libraryLoad> shard(new libraryLoad);
+        if(!m_importShard.isNull())
+            *shard = *m_importShard;
+        shard->fromIndex = true;
+        shard->stale     = false;
+        int offset = shard->store.size();
+        int first  = shard->store.albumCount();
+        shard->store.append(fresh.store);
+        for(int a=first; a<shard->store.albumCount(); a++) {
+            int art = shard->store.albumInfo(a).art;
+            shard->covers << (art >= offset ? fresh.covers.value(fresh.store.albumOf(art - offset))
+                                            : QImage());
         }
+        m_importShard = shard;
+        startMerge();
     }
 
-    // sort remaining two panels for artists and albums
-    qStableSort(m_listArtist.begin(), m_listArtist.end(), caseInsensitive);
-    qStableSort(m_listAlbum .begin(), m_listAlbum .end(), caseInsensitive);
+    QVector<int> tracks;
+    for(int i=0; i<import->paths.size(); i++) {
+        int track = m_library.find(import->paths[i]);
+        if(track >= 0)
+            tracks << track;
+    }
+    showStatus(QString("Imported %1 songs (%2 new, %3 missing)")
+               .arg(tracks.size()).arg(fresh.store.size()).arg(import->missing));
 
-    // add items to panels; skip over non-unique entries
-    for(int i=0; i<m_listArtist.size(); i+=m_listArtist.count(m_listArtist[i]))
-        m_panel[1]->addItem(m_listArtist[i]);
-    for(int i=0; i<m_listAlbum.size(); i+=m_listAlbum.count(m_listAlbum[i]))
-        m_panel[2]->addItem(m_listAlbum[i]);
-    redrawLists(item, GENRE);
+    m_queue->setTracks(tracks);
+    m_sessionDirty = true;
+    fillTable(tracks);
+    s_mediaStateChanged(m_device->state());
 }
 
 
 
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
-// MainWindow::s_panel2:
+// MainWindow::s_exportPlaylist:
+//
+// Slot function for File|Export Playlist. Writes either the play
+// queue or the rows currently shown in the table.
+//
+void MainWindow::s_exportPlaylist() {
+    TRACE_SLOT("MainWindow::s_exportPlaylist");
+    QStringList sources;
+    sources << "Play Queue" << "Current View";
+    bool ok;
+    QString source = QInputDialog::getItem(this, "Export Playlist",
+            "Export:", sources, 0, false, &ok);
+    if(!ok) return;
+
+    QString fileName = QFileDialog::getSaveFileName(this, "Export Playlist",
+            m_directory, "M3U8 (*.m3u8);;M3U (*.m3u);;PLS (*.pls)");
+    if(fileName.isEmpty()) return;
+
+    QVector<int> tracks;
+    if(source == sources[0])
+        tracks = m_queue->tracks();
+    else {
+        for(int row=0; row<m_table->rowCount(); row++)
+            tracks << m_table->item(row, TITLE)->data(Qt::UserRole).toInt();
+    }
+
+    playlistWriter writer;
+    if(!writer.open(fileName)) {
+        QMessageBox::warning(this, "Export Playlist",
+                             QString("Cannot write %1").arg(fileName));
+        return;
+    }
+    for(int i=0; i<tracks.size(); i++) {
+        int t = tracks[i];
+        writer.add(m_library.path(t), m_library.seconds(t),
+                   QString("%1 - %2").arg(m_library.artist(t)).arg(m_library.title(t)));
+    }
+    writer.close();
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// MainWindow::s_panel1:
 //
-// Slot function to adjust data if an item in panel2 (artist) is selected.
+// Slot function to adjust data if an item in panel1 (genre) is selected.
 //
-void MainWindow::s_panel2(QListWidgetItem *item) {
-    // clear lists
-    m_panel[2]->clear();
-    m_listAlbum.clear();
-
-    // collect list of albums
-    for(int i=0; i<m_listSongs.size(); i++) {
-        if(m_listSongs[i][ARTIST] == item->text())
-            m_listAlbum << m_listSongs[i][ALBUM];
-    }
+void MainWindow::s_panel1(QListWidgetItem *item) {
+    TRACE_SLOT("MainWindow::s_panel1");
+    m_facet[0] = item->data(Qt::UserRole).toInt();
+    m_facet[1] = m_facet[2] = -1;
+    applyFilter();
+}
 
-    // sort remaining panel for albums
-    qStableSort(m_listAlbum.begin(), m_listAlbum.end(), caseInsensitive);
 
-    // add items to panel; skip over non-unique entries
-    for(int i=0; i<m_listAlbum.size(); i+=m_listAlbum.count(m_listAlbum[i]))
-        m_panel[2]->addItem(m_listAlbum[i]);
 
-    redrawLists(item, ARTIST);
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// MainWindow::s_panel2:
+//
+// Slot function to adjust data if an item in panel2 (artist) is selected.
+//
+void MainWindow::s_panel2(QListWidgetItem *item) {
+    TRACE_SLOT("MainWindow::s_panel2");
+    m_facet[1] = item->data(Qt::UserRole).toInt();
+    m_facet[2] = -1;
+    applyFilter();
 }
 
 
@@ -673,7 +976,9 @@ void MainWindow::s_panel2(QListWidgetItem *item) {
 // Slot function to adjust data if an item in panel3 (album) is selected.
 //
 void MainWindow::s_panel3(QListWidgetItem *item) {
-    redrawLists(item, ALBUM);
+    TRACE_SLOT("MainWindow::s_panel3");
+    m_facet[2] = item->data(Qt::UserRole).toInt();
+    applyFilter();
 }
 
 
@@ -684,6 +989,7 @@ void MainWindow::s_panel3(QListWidgetItem *item) {
 // Slot function for Help|About
 //
 void MainWindow::s_about() {
+    TRACE_SLOT("MainWindow::s_about");
     QMessageBox::about(this, "About qTunes",
             "<center> qTunes 1.0 </center> \
              <center> by George Wolberg, 2015 </center>");
@@ -692,85 +998,240 @@ void MainWindow::s_about() {
 
 
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
-// MainWindow::initAlbums():
+// MainWindow::s_showStats:
 //
-// Places all the album covers into a list of qimages.
+// Slot function for Help|Playback Stats
 //
-void MainWindow::initAlbums() {
-    // created a list of all the albums
-    QStringList albumSongOrder;
-    for(int i=0; i<m_listSongs.size(); i++)
-        albumSongOrder << m_listSongs[i][ALBUM];
-
-    // add each qimage to the list of qimages, filtering out repeated strings
-    for (int k=0; k<m_listAlbum.size(); k+=m_listAlbum.count(m_listAlbum[k])) {
-        // gets file data
-        int index = albumSongOrder.indexOf(m_listAlbum[k]);
-        QString item_title = QString("%1").arg(m_listSongs[index][PATH]);
-        QByteArray ba_temp = item_title.toLocal8Bit();
-        const char* filepath = ba_temp.data();
-
-        // gets the tag that contains the album image
-        TagLib::MPEG::File audioFile(filepath);
-        TagLib::ID3v2::Tag *tag = audioFile.ID3v2Tag(true);
-
-        // adds qimage created from the tag's data to the list
-        QImage coverArt = initImage(tag);
-        m_albumsList << coverArt;
+void MainWindow::s_showStats() {
+    TRACE_SLOT("MainWindow::s_showStats");
+    if(!m_statsPanel)
+        m_statsPanel = new statsPanel(m_stats, this);
+    m_statsPanel->show();
+    m_statsPanel->raise();
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// MainWindow::s_toggleOverlay:
+//
+// Slot function for Help|Frame Timing. Shows or hides the frame timing
+// of the cover flow and the visualizer.
+//
+void MainWindow::s_toggleOverlay(bool on) {
+    TRACE_SLOT("MainWindow::s_toggleOverlay");
+    m_glWidget->setOverlayVisible(on);
+    m_visualizer->setOverlayVisible(on);
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// MainWindow::s_showMemory:
+//
+// Slot function for Help|Memory Report
+//
+void MainWindow::s_showMemory() {
+    TRACE_SLOT("MainWindow::s_showMemory");
+    if(!m_memoryPanel) {
+        m_memoryPanel = new memoryPanel(this);
+        connect(m_memoryPanel, SIGNAL(refreshRequested()), this, SLOT(s_refreshMemory()));
     }
+    m_memoryPanel->show();
+    m_memoryPanel->raise();
 }
 
 
 
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
-// MainWindow::initImage:
+// MainWindow::s_refreshMemory:
 //
-// Returns a qimage loaded from the tag's data
-// or a default image if the tag does not contain the data.
+// Slot function that hands a fresh memory report to the panel.
 //
-QImage MainWindow::initImage(TagLib::ID3v2::Tag *tag) {
-    // looks for picture frames only
-    TagLib::ID3v2::FrameList tag_list = tag->frameList("APIC");
-    QImage tag_image;
+void MainWindow::s_refreshMemory() {
+    TRACE_SLOT("MainWindow::s_refreshMemory");
+    memoryReport report;
+    reportMemory(&report);
+    m_memoryPanel->setReport(report);
+}
+
 
-    // if picture frames do not exists, a default image is used for the album cover image
-    // else the first frame's data is coverted to a qimage
-    if(tag_list.isEmpty()) {
-        QString path = QDir::currentPath();
-        path.append("musicnote.png");
-        tag_image.load(path);
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// MainWindow::reportMemory:
+//
+// Estimates the memory of the library, the decoded covers, the cover
+// textures, the table and list items and the caches. Widget items are
+// estimated from their size, one value per role they hold and the
+// payload of their text.
+//
+void MainWindow::reportMemory(memoryReport *report) {
+    typedef memoryReport mr;
+    report->setTracks(m_library.size());
+    report->setAlbums(m_library.albumCount());
+
+    m_library.reportMemory(report);
+
+    // decoded covers
+    qint64 covers = 0;
+    for(int i=0; i<m_albumsList.size(); i++)
+        covers += mr::imageBytes(m_albumsList[i]);
+    report->add("images", "cover flow images", covers, m_albumsList.size());
+    report->add("images", "label cover", mr::imageBytes(m_cover), m_cover.isNull() ? 0 : 1);
+    const QPixmap *pixmap = m_albumLabel->pixmap();
+    if(pixmap && !pixmap->isNull())
+        report->add("images", "label pixmap",
+                    (qint64) pixmap->width() * pixmap->height() * pixmap->depth() / 8, 1);
+
+    // cover flow textures, including mipmaps
+    report->add("textures", "cover flow (est. VRAM)",
+                m_glWidget->textureBytes(), m_glWidget->textureCount());
+
+    // table items: display text and alignment, plus the track ID on TITLE
+    const qint64 role = sizeof(int) + sizeof(QVariant);
+    const qint64 item = sizeof(QTableWidgetItem) + sizeof(QArrayData) + sizeof(void *);
+    qint64 cells = 0;
+    int n = 0;
+    for(int row=0; row<m_table->rowCount(); row++) {
+        for(int col=0; col<m_table->columnCount(); col++) {
+            QTableWidgetItem *cell = m_table->item(row, col);
+            if(!cell) continue;
+            cells += item + role * (col == TITLE ? 3 : 2) + mr::stringBytes(cell->text());
+            n++;
+        }
     }
-    else {
-        TagLib::ID3v2::AttachedPictureFrame *tag_frame = static_cast<TagLib::ID3v2::AttachedPictureFrame *>(tag_list.front());
-        tag_image.loadFromData((const uchar *) tag_frame->picture().data(), tag_frame->picture().size());
+    report->add("table", "table items", cells, n);
+    report->add("table", "shown tracks", mr::vectorBytes(m_viewTracks), m_viewTracks.size());
+
+    // panel items: display text and value ID
+    for(int p=0; p<3; p++) {
+        qint64 bytes = 0;
+        for(int i=0; i<m_panel[p]->count(); i++)
+            bytes += sizeof(QListWidgetItem) + sizeof(void *) + 2 * role +
+                     mr::stringBytes(m_panel[p]->item(i)->text());
+        report->add("panels", m_panel[p]->objectName(), bytes, m_panel[p]->count());
+    }
+
+    report->add("caches", "filter results", m_results->bytes(), m_results->count());
+    report->add("caches", "label thumbnails", m_thumbs.totalCost(), m_thumbs.size());
+    report->add("caches", "query indexes", m_query->bytes());
+    report->add("caches", "sort keys", m_sorter->bytes());
+    report->add("caches", "waveform overviews", m_waveforms->memoryBytes(), m_waveforms->memoryCount());
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// MainWindow::initAlbums():
+//
+// Places all the album covers into a list of qimages.
+//
+void MainWindow::initAlbums() {
+    TRACE_SCOPE("MainWindow::initAlbums", "art");
+    // covers change with the library
+    m_albumsList.clear();
+    m_thumbs.clear();
+
+    m_albumsList = decodeCovers(m_library, m_listAlbum);
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// MainWindow::decodeCovers:
+//
+// Returns the chosen cover of each album at cover flow size, counting
+// decoded albums in done; stops short once abort is set. Only reads
+// library, so it runs in workers.
+//
+QList<QImage> MainWindow::decodeCovers(const trackStore &library, const QVector<int> &albums,
+                                       std::atomic<int> *done, const std::atomic<bool> *abort) {
+    QList<QImage> covers;
+    for (int k=0; k<albums.size() && !(abort && *abort); k++) {
+        int art = library.albumInfo(albums[k]).art;
+        QImage cover;
+        if(art < 0 || !coverArt::read(library, art, QSize(COVER_SIZE, COVER_SIZE), &cover))
+            cover = coverArt::defaultCover();
+        covers << cover;
+        if(done) done->store(k + 1, std::memory_order_relaxed);
     }
-    return tag_image;
+    return covers;
 }
 
 
+
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 // MainWindow::updateSong:
 //
 // Displays the album cover and song title of the currently played song.
 //
 void MainWindow::updateSong() {
+    TRACE_SCOPE("MainWindow::updateSong", "ui");
+    int track = m_queue->current();
+    if(track < 0 || track >= m_library.size()) return;
+
     // sets label to the current song's title
-    m_infoLabel->setText(m_listSongs[m_playlist->currentIndex()][TITLE] );
+    m_infoLabel->setText(m_library.title(track));
 
     // gets file data
-    QString item_title = QString("%1").arg(m_listSongs[m_playlist->currentIndex()][PATH]);
-    QByteArray ba_temp = item_title.toLocal8Bit();
-    const char* filepath = ba_temp.data();
-
-    // gets the tag that contains the album image
-    TagLib::MPEG::File audioFile(filepath);
-    TagLib::ID3v2::Tag *tag = audioFile.ID3v2Tag(true);
-    QImage coverArt = initImage(tag);
+    QString item_title = m_library.path(track);
+
+    // the album's cover at label size, decoded once per album
+    int album = m_library.albumOf(track);
+    metricsRegistry *metrics = metricsRegistry::instance();
+    static metricCounter *hit = metrics->counter("qtunes_cache_requests_total",
+            "Cache lookups by cache and outcome.", "cache=\"thumbnail\",result=\"hit\"");
+    static metricCounter *miss = metrics->counter("qtunes_cache_requests_total",
+            "Cache lookups by cache and outcome.", "cache=\"thumbnail\",result=\"miss\"");
+    QImage *thumb = m_thumbs.object(album);
+    (thumb ? hit : miss)->add();
+    if(!thumb) {
+        int art = m_library.albumInfo(album).art;
+        thumb = new QImage;
+        if(art < 0 || !coverArt::read(m_library, art, QSize(100, 100), thumb))
+            *thumb = coverArt::defaultCover().scaled(100, 100, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+        m_thumbs.insert(album, thumb, memoryReport::imageBytes(*thumb));
+    }
+    m_cover = *thumb;
 
-    // scales and positions the image on the label
-    m_cover = coverArt.scaled(100, 100, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+    // positions the image on the label
     m_albumLabel->setAlignment(Qt::AlignHCenter | Qt::AlignVCenter);
     m_albumLabel->setPixmap(QPixmap::fromImage(m_cover));
+
+    // show the cached overview right away; generate it otherwise
+    waveformOverview wave;
+    if(m_waveforms->lookup(item_title, &wave))
+        m_positionSlider->setOverview(wave);
+    else {
+        m_positionSlider->clearOverview();
+        m_waveforms->request(item_title, true);
+    }
+
+    // run ahead so the next tracks are ready when they start
+    for(int k=1; k<=WAVEFORM_LOOKAHEAD; k++) {
+        int next = m_queue->peek(k);
+        if(next >= 0 && next < m_library.size())
+            m_waveforms->request(m_library.path(next));
+    }
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// MainWindow::s_waveformReady:
+//
+// Slot function that shows a freshly generated overview if it
+// belongs to the current song.
+//
+void MainWindow::s_waveformReady(const QString &path) {
+    TRACE_SLOT("MainWindow::s_waveformReady");
+    int index = m_queue->current();
+    if(index < 0 || index >= m_library.size()) return;
+    if(m_library.path(index) != path) return;
+
+    waveformOverview wave;
+    if(m_waveforms->lookup(path, &wave))
+        m_positionSlider->setOverview(wave);
 }
 
 
@@ -782,28 +1243,19 @@ void MainWindow::updateSong() {
 // on its corresponding item in table widget.
 //
 void MainWindow::s_play() {
+    TRACE_SLOT("MainWindow::s_play");
     if(m_device->error()) return;
 
-    QTableWidgetItem* item = m_table->selectedItems().count() > 0 ? m_table->selectedItems()[0] : NULL;
-    if(item) {
-        for(int i=0; i<m_listSongs.size(); i++) {
-            // skip over songs whose title does not match
-            if(m_listSongs[i][TITLE] == item->text()) {
-                m_playlist->setCurrentIndex(i);
-                m_device->play();
-                updateSong();
-                i = m_listSongs.size();
-            }
-        }
-    }
+    QList<int> tracks = selectedTracks();
+    if(!tracks.isEmpty())
+        playTrack(tracks.first());
     else {
-        if(m_listSongs.size()) {
-            m_playlist->setCurrentIndex(0);
+        if(m_queue->size()) {
+            m_stats->markPlayRequested();
+            m_queue->setCurrentIndex(0);
             m_device->play();
-            updateSong();
         }
     }
-    updateSong();
 }
 
 
@@ -814,30 +1266,24 @@ void MainWindow::s_play() {
 // Slot function for playing a mp3 file using play button.
 //
 void MainWindow::s_play2() {
+    TRACE_SLOT("MainWindow::s_play2");
     if(m_device->error()) return;
 
     if(m_device->state()==QMediaPlayer::PlayingState)
         m_device->pause();
-    else if(m_device->state()==QMediaPlayer::PausedState)
+    else if(m_device->state()==QMediaPlayer::PausedState) {
+        m_stats->markPlayRequested();
         m_device->play();
+    }
     else {
-        QTableWidgetItem* item = m_table->selectedItems().count() > 0 ? m_table->selectedItems()[0] : NULL;
-        if(item) {
-            for(int i=0; i<m_listSongs.size(); i++) {
-                // skip over songs whose title does not match
-                if(m_listSongs[i][TITLE] == item->text()) {
-                    m_playlist->setCurrentIndex(i);
-                    m_device->play();
-                    updateSong();
-                    i = m_listSongs.size();
-                }
-            }
-        }
+        QList<int> tracks = selectedTracks();
+        if(!tracks.isEmpty())
+            playTrack(tracks.first());
         else {
-            if(m_listSongs.size()) {
-                m_playlist->setCurrentIndex(0);
+            if(m_queue->size()) {
+                m_stats->markPlayRequested();
+                m_queue->setCurrentIndex(0);
                 m_device->play();
-                updateSong();
             }
         }
     }
@@ -845,12 +1291,135 @@ void MainWindow::s_play2() {
 
 
 
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// MainWindow::playTrack():
+//
+// Makes a track current and plays it. A track that is not queued, such
+// as a library row while an imported playlist is the queue, replaces
+// the queue with the tracks in the table.
+//
+void MainWindow::playTrack(int track) {
+    m_stats->markPlayRequested();
+    if(!m_queue->setCurrentTrack(track)) {
+        m_queue->setTracks(m_viewTracks);
+        if(!m_queue->setCurrentTrack(track)) return;
+    }
+    m_device->play();
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// MainWindow::selectedTracks():
+//
+// Returns the track IDs of the selected table rows, top to bottom.
+//
+QList<int> MainWindow::selectedTracks() {
+    QList<int> tracks;
+    QModelIndexList rows = m_table->selectionModel()->selectedRows(TITLE);
+    qSort(rows);
+    for(int i=0; i<rows.size(); i++)
+        tracks << rows[i].data(Qt::UserRole).toInt();
+    return tracks;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// MainWindow::s_playNext():
+//
+// Slot function that queues the selected songs after the current one.
+//
+void MainWindow::s_playNext() {
+    TRACE_SLOT("MainWindow::s_playNext");
+    QList<int> tracks = selectedTracks();
+
+    // insert backwards so the selection keeps its order
+    for(int i=tracks.size()-1; i>=0; i--)
+        m_queue->playNext(tracks[i]);
+    m_sessionDirty = true;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// MainWindow::s_enqueue():
+//
+// Slot function that appends the selected songs to the queue.
+//
+void MainWindow::s_enqueue() {
+    TRACE_SLOT("MainWindow::s_enqueue");
+    QList<int> tracks = selectedTracks();
+    for(int i=0; i<tracks.size(); i++)
+        m_queue->append(tracks[i]);
+    m_sessionDirty = true;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// MainWindow::s_trackChanged():
+//
+// Slot function that loads the queue's current track into the player.
+//
+void MainWindow::s_trackChanged(int track) {
+    TRACE_SLOT("MainWindow::s_trackChanged");
+    if(track < 0 || track >= m_library.size()) return;
+
+    bool playing = m_device->state() == QMediaPlayer::PlayingState;
+    m_device->setMedia(QUrl::fromLocalFile(m_library.path(track)));
+    if(playing)
+        m_device->play();
+    updateSong();
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// MainWindow::s_mediaStatusChanged():
+//
+// Slot function that moves on to the next queued song at the end of
+// the current one.
+//
+void MainWindow::s_mediaStatusChanged(QMediaPlayer::MediaStatus status) {
+    TRACE_SLOT("MainWindow::s_mediaStatusChanged");
+
+    // a resumed track seeks once it has loaded
+    if((status == QMediaPlayer::LoadedMedia || status == QMediaPlayer::BufferedMedia)
+            && m_resumePosition >= 0) {
+        m_device->setPosition(m_resumePosition);
+        m_resumePosition = -1;
+    }
+    if(status != QMediaPlayer::EndOfMedia) return;
+
+    m_stats->markTrackSwitch();
+    if(m_queue->next())
+        m_device->play();
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// MainWindow::rebuildQueue():
+//
+// Queues the whole library in library order.
+//
+void MainWindow::rebuildQueue() {
+    QVector<int> tracks(m_library.size());
+    for(int i=0; i<tracks.size(); i++)
+        tracks[i] = i;
+    m_queue->setTracks(tracks);
+}
+
+
+
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 // MainWindow::s_stop():
 //
 // Slot function that stops the song being played.
 //
 void MainWindow::s_stop() {
+    TRACE_SLOT("MainWindow::s_stop");
     if(m_device->error()) return;
 
     // if playing or paused
@@ -866,9 +1435,10 @@ void MainWindow::s_stop() {
 // Slot function for playing the next mp3 file on the playlist.
 //
 void MainWindow::s_next() {
+    TRACE_SLOT("MainWindow::s_next");
     if(m_next->isEnabled() && m_device->state()!=QMediaPlayer::StoppedState) {
-        m_playlist->next();
-        updateSong();
+        m_stats->markTrackSwitch();
+        m_queue->next();
     }
 }
 
@@ -880,9 +1450,12 @@ void MainWindow::s_next() {
 // Slot function for playing the previous mp3 file on the playlist.
 //
 void MainWindow::s_prev() {
+    TRACE_SLOT("MainWindow::s_prev");
     if(m_previous->isEnabled() && m_device->state() != QMediaPlayer::StoppedState) {
-        m_playlist->previous();
-        updateSong();
+        m_stats->markTrackSwitch();
+        // at the start of the shuffle history: restart the current track
+        if(!m_queue->previous())
+            m_device->setPosition(0);
     }
 }
 
@@ -895,6 +1468,7 @@ void MainWindow::s_prev() {
 // Enable/disable stop button depending on current m_device state.
 //
 void MainWindow::s_mediaStateChanged(QMediaPlayer::State state) {
+    TRACE_SLOT("MainWindow::s_mediaStateChanged");
     if(state==QMediaPlayer::StoppedState) {
         // set buttons
         m_play->setIcon(style()->standardIcon(QStyle::SP_MediaPlay));
@@ -925,7 +1499,7 @@ void MainWindow::s_mediaStateChanged(QMediaPlayer::State state) {
 
     // if no songs in list, disable the play button as well
     // all other buttons are already disabled since media is stoped
-    if(!m_listSongs.size())
+    if(!m_library.size())
         m_play->setEnabled(false);
 }
 
@@ -937,10 +1511,9 @@ void MainWindow::s_mediaStateChanged(QMediaPlayer::State state) {
 // Slot function correponds the position of the song to the label and slider.
 //
 void MainWindow::s_updatePosition(qint64 position) {
-    m_positionSlider->setValue(position);
-
-    QTime duration(0, position / 60000, qRound((position % 60000) / 1000.0));
-    m_positionLabel->setText(duration.toString(tr("mm:ss")));
+    TRACE_SLOT("MainWindow::s_updatePosition");
+    m_pendingPosition = position;
+    scheduleUpdate(UPDATE_POSITION);
 }
 
 
@@ -952,9 +1525,73 @@ void MainWindow::s_updatePosition(qint64 position) {
 // Allows user to position the point at which the song is being played.
 //
 void MainWindow::s_updateDuration(qint64 duration) {
-    m_positionSlider->setRange(0, duration);
-    m_positionSlider->setEnabled(duration > 0);
-    m_positionSlider->setPageStep(duration / 10);
+    TRACE_SLOT("MainWindow::s_updateDuration");
+    m_pendingDuration = duration;
+    scheduleUpdate(UPDATE_DURATION);
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// MainWindow::showStatus:
+//
+// Shows a status bar message with the next frame.
+//
+void MainWindow::showStatus(const QString &text) {
+    m_pendingStatus = text;
+    scheduleUpdate(UPDATE_STATUS);
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// MainWindow::scheduleUpdate:
+//
+// Marks a value as changed. Only the latest value of each kind is
+// kept and all of them are applied together by s_flushUpdates.
+//
+void MainWindow::scheduleUpdate(int what) {
+    m_pendingMask |= what;
+    if(!m_frameTimer->isActive())
+        m_frameTimer->start();
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// MainWindow::s_flushUpdates:
+//
+// Slot function that applies coalesced values once per frame.
+// Slider signals are blocked while it is updated here, so playback
+// progress never comes back into s_setPosition as a seek.
+//
+void MainWindow::s_flushUpdates() {
+    TRACE_SLOT("MainWindow::s_flushUpdates");
+    int mask = m_pendingMask;
+    m_pendingMask = 0;
+
+    if(mask & (UPDATE_DURATION | UPDATE_POSITION)) {
+        QSignalBlocker blocker(m_positionSlider);
+
+        if(mask & UPDATE_DURATION) {
+            m_positionSlider->setRange(0, m_pendingDuration);
+            m_positionSlider->setEnabled(m_pendingDuration > 0);
+            m_positionSlider->setPageStep(m_pendingDuration / 10);
+        }
+
+        // leave the slider alone while the user drags it
+        if((mask & UPDATE_POSITION) && !m_positionSlider->isSliderDown())
+            m_positionSlider->setValue(m_pendingPosition);
+    }
+
+    if(mask & UPDATE_POSITION) {
+        qint64 position = m_pendingPosition;
+        QTime duration(0, position / 60000, qRound((position % 60000) / 1000.0));
+        m_positionLabel->setText(duration.toString(tr("mm:ss")));
+    }
+
+    if(mask & UPDATE_STATUS)
+        statusBar()->showMessage(m_pendingStatus, 5000);
 }
 
 
@@ -963,10 +1600,14 @@ void MainWindow::s_updateDuration(qint64 duration) {
 // MainWindow:s_setPosition:
 //
 // Slot function for setting the point at which the song is being played.
+// Only user changes get here; see s_flushUpdates.
 //
 void MainWindow::s_setPosition(int position) {
-    if (qAbs(m_device->position() - position) > 99)
+    TRACE_SLOT("MainWindow::s_setPosition");
+    if (qAbs(m_device->position() - position) > 99) {
         m_device->setPosition(position);
+        m_sessionDirty = true;
+    }
 }
 
 
@@ -974,41 +1615,27 @@ void MainWindow::s_setPosition(int position) {
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 // MainWindow::s_search:
 //
-// Slot function for searching through table widget.
+// Slot function for searching through table widget. Title, artist,
+// and album searches become a one-term query; "Query" takes the text
+// as a full query (see queryEngine).
 //
 void MainWindow::s_search(int in) {
-    // matches in (integer selected from m_search) with corresponding field value
-    int index = 0;
-    bool search = true;
-    if(in == 1)
-        index = 0;
-    else if (in == 2)
-        index = 3;
-    else if (in == 3)
-        index = 4;
-    else
-        search = false;
+    TRACE_SLOT("MainWindow::s_search");
+    static const char *fields[] = {"", "title", "artist", "album"};
 
-    m_searchText = m_typeSearch->text().toLower();
-    m_table->setRowCount(0);
-
-    // copy data to table widget
-    for (int i=0, row=0; i<m_listSongs.size(); i++) {
-        // skip rows whose field doesn't match text
-        if (search&&!(((m_listSongs[i][index]).toLower()).contains(m_searchText))) continue;
-
-        m_table->insertRow(row);
-        QTableWidgetItem *item[COLS];
-        for (int j=0; j<COLS; j++) {
-            item[j] = new QTableWidgetItem;
-            item[j]->setText(m_listSongs[i][j]);
-            item[j]->setTextAlignment(Qt::AlignCenter);
-            // put item[j] into m_table in proper row and column j
-            m_table->setItem(row, j, item[j]);
-        }
-        // increment table row index (row <= i)
-        row++;
+    QString text = m_typeSearch->text();
+    if(in >= 1 && in <= 3) {
+        text.replace('\\', "\\\\").replace('"', "\\\"");
+        m_searchText = QString("%1 : \"%2\"").arg(fields[in]).arg(text);
     }
+    else if(in == 4)
+        m_searchText = text;
+    else
+        m_searchText.clear();
+
+    // a new search starts from all genres, artists, and albums
+    m_facet[0] = m_facet[1] = m_facet[2] = -1;
+    applyFilter();
 }
 
 
@@ -1016,20 +1643,24 @@ void MainWindow::s_search(int in) {
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 // MainWindow::s_sortTable:
 //
-// Slot function for sorting items in table widget.
+// Slot function for sorting items in table widget. Sorting the same
+// column again only reverses the rows; another column is sorted by
+// its typed keys starting ascending.
 //
 void MainWindow::s_sortTable(int colNum) {
-    // sorts items in descending order
-    if (m_ascendSorted) {
-        m_table->sortByColumn(colNum, Qt::DescendingOrder);
-        m_ascendSorted = false;
-    }
-
-    // sorts items in ascending order
+    TRACE_SLOT("MainWindow::s_sortTable");
+    if (colNum == m_sortColumn)
+        m_ascendSorted = !m_ascendSorted;
     else {
-        m_table->sortByColumn(colNum, Qt::AscendingOrder);
+        m_viewTracks   = m_sorter->sort(m_viewTracks, colNum);
+        m_sortColumn   = colNum;
         m_ascendSorted = true;
     }
+
+    fillRows(m_viewTracks, !m_ascendSorted);
+    m_table->horizontalHeader()->setSortIndicatorShown(true);
+    m_table->horizontalHeader()->setSortIndicator(colNum,
+            m_ascendSorted ? Qt::AscendingOrder : Qt::DescendingOrder);
 }
 
 
@@ -1040,6 +1671,7 @@ void MainWindow::s_sortTable(int colNum) {
 // Slot function to animate coverflow to the left.
 //
 void MainWindow::s_animateLeft() {
+    TRACE_SLOT("MainWindow::s_animateLeft");
     m_glWidget->startAnimate(true);
 }
 
@@ -1051,6 +1683,7 @@ void MainWindow::s_animateLeft() {
 // Slot function to animate coverflow to the right.
 //
 void MainWindow::s_animateRight() {
+    TRACE_SLOT("MainWindow::s_animateRight");
     m_glWidget->startAnimate(false);
 }
 
@@ -1074,13 +1707,101 @@ void MainWindow::keyPressEvent(QKeyEvent* event)
 
 
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
-// MainWindow::saveDir:
+// defaultReaders:
+//
+// Concurrent tag reads for a library folder that has no setting: a few
+// on local drives, two on network mounts, whose latency hides better
+// behind parallel reads but which should not be flooded.
+//
+static int defaultReaders(const QString &path) {
+    static const char *network[] = {"nfs", "nfs4", "cifs", "smbfs", "smb3",
+                                     "fuse.sshfs", "afpfs", "webdav"};
+    QByteArray type = QStorageInfo(path).fileSystemType();
+    for(unsigned i=0; i<sizeof(network)/sizeof(network[0]); i++)
+        if(type == network[i]) return 2;
+    return qBound(1, QThread::idealThreadCount(), 4);
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// MainWindow::setRoots:
+//
+// Makes paths the library folders. Folders kept keep what they have
+// loaded; each gets its reader limit from the settings. Loads of the
+// folders dropped are aborted.
+//
+void MainWindow::setRoots(const QStringList &paths) {
+    QSettings setting(QSettings::NativeFormat, QSettings::UserScope, "CS221", "qTune");
+    QVariantMap readers = setting.value("readers").toMap();
+
+    QList<QSharedPointer<libraryRoot>> roots;
+    for(int i=0; i<paths.size(); i++) {
+        QSharedPointer<libraryRoot> root;
+        for(int j=0; j<m_roots.size() && root.isNull(); j++)
+            if(m_roots[j]->path == paths[i])
+                root = m_roots[j];
+        if(root.isNull()) {
+            root = QSharedPointer<libraryRoot>(new libraryRoot);
+            root->path    = paths[i];
+            root->readers = qMax(1, readers.value(paths[i], defaultReaders(paths[i])).toInt());
+            root->abort   = false;
+            root->loading = false;
+        }
+        roots << root;
+    }
+    m_roots = roots;
+
+    // loads of folders no longer in the library are of no use
+    for(auto it = m_rootJobs.begin(); it != m_rootJobs.end(); ++it)
+        if(!m_roots.contains(it.value()))
+            it.value()->abort = true;
+
+    // one thread per folder, so a slow one never holds up the others
+    m_rootPool.setMaxThreadCount(qMax(1, m_roots.size()));
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// MainWindow::saveRoots:
 //
-// Save loaded directory.
+// Save library folders and their reader limits; the limits can be
+// edited in the settings.
 //
-void MainWindow::saveDir(QString path) {
+void MainWindow::saveRoots() {
     QSettings setting(QSettings::NativeFormat, QSettings::UserScope, "CS221", "qTune");
-    setting.setValue("dirs",path);
+    QVariantMap readers;
+    for(int i=0; i<m_roots.size(); i++)
+        readers.insert(m_roots[i]->path, m_roots[i]->readers);
+    setting.setValue("dirs", rootPaths());
+    setting.setValue("readers", readers);
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// MainWindow::rootPaths:
+//
+// Returns the library folders in order.
+//
+QStringList MainWindow::rootPaths() const {
+    QStringList paths;
+    for(int i=0; i<m_roots.size(); i++)
+        paths << m_roots[i]->path;
+    return paths;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// MainWindow::rootsKey:
+//
+// Identifies the set of library folders, for session snapshots and to
+// drop merges made for a set that has since changed.
+//
+QString MainWindow::rootsKey() const {
+    return rootPaths().join('\n');
 }
 
 
@@ -1088,17 +1809,32 @@ void MainWindow::saveDir(QString path) {
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 // MainWindow::loadDirs:
 //
-// Pulls previous directory and opens the prompt window.
+// Pulls previous folders and restores them if the user said to always
+// do so; otherwise asks with a prompt that leaves the window usable.
+// Older settings hold a single folder, which reads as a list of one.
 //
 void MainWindow::loadDirs() {
     QSettings setting(QSettings::NativeFormat, QSettings::UserScope, "CS221", "qTune");
-    QString p = setting.value("dirs","").toString();
-    QString dir = QDir::toNativeSeparators(p);
-    if(dir.isEmpty()) return;
-    m_directory = dir;
-    openPrompt *prompt = new openPrompt;
+    QStringList paths = setting.value("dirs").toStringList();
+    paths.removeAll(QString());
+    if(paths.isEmpty()) return;
+    setRoots(paths);
+    m_directory = QDir::toNativeSeparators(paths.last());
+
+    // remembered answer: "always", "never", or ask
+    QString restore = setting.value("restoreLibrary").toString();
+    if(restore == "always") {
+        restoreLibrary(true);
+        return;
+    }
+    if(restore == "never") return;
+
+    openPrompt *prompt = new openPrompt(this);
     connect(prompt, SIGNAL(load()), this, SLOT(s_loadPrev()));
-    prompt->exec();
+    connect(prompt, SIGNAL(remember(bool)), this, SLOT(s_rememberRestore(bool)));
+
+    // shown once the window is, so it opens on top of it
+    QMetaObject::invokeMethod(prompt, "show", Qt::QueuedConnection);
 }
 
 
@@ -1109,10 +1845,490 @@ void MainWindow::loadDirs() {
 // Slot function to load previous directories.
 //
 void MainWindow::s_loadPrev() {
-    traverseDirs(m_directory);
+    TRACE_SLOT("MainWindow::s_loadPrev");
+    restoreLibrary(true);
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// MainWindow::s_rememberRestore:
+//
+// Slot function that keeps the prompt's answer for later starts.
+//
+void MainWindow::s_rememberRestore(bool load) {
+    TRACE_SLOT("MainWindow::s_rememberRestore");
+    QSettings setting(QSettings::NativeFormat, QSettings::UserScope, "CS221", "qTune");
+    setting.setValue("restoreLibrary", load ? "always" : "never");
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// MainWindow::s_addRoot:
+//
+// Slot function for File|Add Music Folder. The folder is loaded in
+// the background next to the others; folders inside one another are
+// refused, as their tracks would be listed twice.
+//
+void MainWindow::s_addRoot() {
+    TRACE_SLOT("MainWindow::s_addRoot");
+    QString s = QFileDialog::getExistingDirectory(this, "Add Folder", m_directory,
+             QFileDialog::ShowDirsOnly | QFileDialog::DontResolveSymlinks);
+    if(s.isEmpty()) return;
+
+    QString path = QDir::cleanPath(s);
+    QStringList paths = rootPaths();
+    for(int i=0; i<paths.size(); i++) {
+        QString root = QDir::cleanPath(paths[i]);
+        if(path == root || path.startsWith(root + '/') || root.startsWith(path + '/')) {
+            showStatus(QString("%1 overlaps the library folder %2").arg(path).arg(root));
+            return;
+        }
+    }
+
+    m_directory = s;
+    setRoots(paths << path);
+    saveRoots();
+    loadRoot(m_roots.last(), true);
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// loadRootInBackground:
+//
+// Worker of loadRoot. Restores the folder from its index if allowed
+// and possible, else scans it with its reader limit and writes a new
+// index; then decodes the covers of its albums. Progress goes to the
+// root's counters. An aborted load returns early and is not used.
+//
+static QSharedPointer<libraryLoad> loadRootInBackground(QSharedPointer<libraryRoot> root,
+                                                        bool useIndex) {
+    TRACE_SCOPE("loadRootInBackground", "load");
+    TRACE_DETAIL(root->path);
+
+    QSharedPointer<libraryLoad> load(new libraryLoad);
+    load->root      = root->path;
+    load->fromIndex = false;
+    load->stale     = false;
+
+    QString index = libraryIndex::pathFor(root->path);
+    if(useIndex)
+        load->fromIndex = libraryIndex::load(index, root->path, &load->store, &load->stale,
+                                             &root->done, &root->total);
+    if(!load->fromIndex) {
+        root->done  = 0;
+        root->total = 0;
+        root->phase = LOAD_SCAN;
+
+        libraryScanner scanner(&load->store);
+        scanner.setProgress(&root->done);
+        scanner.setAbort(&root->abort);
+        scanner.setReaders(root->readers);
+        scanner.scan(root->path);
+        // a partial scan must not be indexed as the whole folder
+        if(root->abort) return load;
+        load->report = QString("%1: %2").arg(root->path).arg(scanner.report());
+        libraryIndex::save(index, root->path, scanner.directories(), load->store);
+    }
+
+    QVector<int> albums(load->store.albumCount());
+    for(int i=0; i<albums.size(); i++)
+        albums[i] = i;
+    root->done  = 0;
+    root->total = albums.size();
+    root->phase = LOAD_COVERS;
+    load->covers = MainWindow::decodeCovers(load->store, albums, &root->done, &root->abort);
+    return load;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// importInBackground:
+//
+// Worker of s_importPlaylist. Reads the tags of the entries that were
+// not in the library, each once, and decodes the covers of their
+// albums; entries that are not on disk are dropped and counted.
+//
+static QSharedPointer<playlistLoad> importInBackground(QStringList entries, QStringList unknown,
+                                                       const std::atomic<bool> *abort) {
+    TRACE_SCOPE("importInBackground", "load");
+    TRACE_DETAIL(QString("%1 new files").arg(unknown.size()));
+
+    QSharedPointer<playlistLoad> import(new playlistLoad);
+    import->fresh = QSharedPointer<libraryLoad>(new libraryLoad);
+    import->fresh->fromIndex = false;
+    import->fresh->stale     = false;
+    import->missing          = 0;
+
+    trackStore &store = import->fresh->store;
+    libraryScanner scanner(&store);
+    QSet<QString> gone;
+    for(int i=0; i<unknown.size() && !*abort; i++) {
+        if(store.find(unknown[i]) >= 0) continue;
+        if(QFile::exists(unknown[i]))
+            scanner.addFile(unknown[i]);
+        else
+            gone.insert(unknown[i]);
+    }
+    for(int i=0; i<entries.size(); i++) {
+        if(gone.contains(entries[i]))
+            import->missing++;
+        else
+            import->paths << entries[i];
+    }
+
+    QVector<int> albums(store.albumCount());
+    for(int i=0; i<albums.size(); i++)
+        albums[i] = i;
+    import->fresh->covers = MainWindow::decodeCovers(store, albums, NULL, abort);
+    return import;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// mergeInBackground:
+//
+// Worker of startMerge. Appends the loaded folders in order into one
+// store, whose key is roots, and takes each album's cover from the
+// folder holding its cover track, in cover flow order. The store is
+// hashed here for the session snapshot.
+//
+static QSharedPointer<libraryLoad> mergeInBackground(QList<QSharedPointer<libraryLoad>> shards,
+                                                     QString roots) {
+    TRACE_SCOPE("mergeInBackground", "load");
+    TRACE_DETAIL(QString("%1 folders").arg(shards.size()));
+
+    QSharedPointer<libraryLoad> merged(new libraryLoad);
+    merged->root      = roots;
+    merged->fromIndex = true;
+    merged->stale     = false;
+
+    QVector<int> offsets;
+    for(int s=0; s<shards.size(); s++) {
+        offsets << merged->store.size();
+        if(shards.size() == 1)
+            merged->store = shards[s]->store;
+        else
+            merged->store.append(shards[s]->store);
+        merged->fromIndex = merged->fromIndex && shards[s]->fromIndex;
+    }
+
+    QVector<int> albums = merged->store.albumOrder();
+    for(int k=0; k<albums.size(); k++) {
+        int art = merged->store.albumInfo(albums[k]).art;
+        QImage cover;
+        if(art >= 0) {
+            int s = shards.size() - 1;
+            while(offsets[s] > art)
+                s--;
+            const libraryLoad &shard = *shards[s];
+            cover = shard.covers.value(shard.store.albumOf(art - offsets[s]));
+        }
+        merged->covers << (cover.isNull() ? coverArt::defaultCover() : cover);
+    }
+    merged->hash = sessionState::hashLibrary(merged->store);
+    return merged;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// MainWindow::restoreLibrary:
+//
+// Loads every library folder in the background, from the indexes if
+// useIndex is set.
+//
+void MainWindow::restoreLibrary(bool useIndex) {
+    for(int i=0; i<m_roots.size(); i++)
+        loadRoot(m_roots[i], useIndex);
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// MainWindow::loadRoot:
+//
+// Loads one folder on its own thread of m_rootPool. The window stays
+// usable and shows progress; the folder joins the library once done.
+//
+void MainWindow::loadRoot(const QSharedPointer<libraryRoot> &root, bool useIndex) {
+    if(root->loading) return;
+
+    root->loading = true;
+    root->phase   = useIndex ? LOAD_INDEX : LOAD_SCAN;
+    root->done    = 0;
+    root->total   = 0;
+
+    QFutureWatcher<QSharedPointer<libraryLoad>> *watcher =
+            new QFutureWatcher<QSharedPointer<libraryLoad>>(this);
+    m_rootJobs.insert(watcher, root);
+    connect(watcher, SIGNAL(finished()), this, SLOT(s_rootLoaded()));
+    watcher->setFuture(QtConcurrent::run(&m_rootPool, loadRootInBackground, root, useIndex));
+
+    m_loadBar->show();
+    m_loadTimer->start();
+    s_loadProgress();
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// MainWindow::startMerge:
+//
+// Merges the folders loaded so far, then the imported tracks, in the
+// background. A folder that finishes meanwhile is merged in by another
+// run right after.
+//
+void MainWindow::startMerge() {
+    if(m_mergeWatcher->isRunning()) {
+        m_mergeAgain = true;
+        return;
+    }
+    m_mergeAgain = false;
+
+    QList<QSharedPointer<libraryLoad>> shards;
+    for(int i=0; i<m_roots.size(); i++)
+        if(!m_roots[i]->shard.isNull())
+            shards << m_roots[i]->shard;
+    if(!m_importShard.isNull())
+        shards << m_importShard;
+    m_mergeImport = m_importShard;
+    m_mergeWatcher->setFuture(QtConcurrent::run(mergeInBackground, shards, rootsKey()));
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// MainWindow::s_loadProgress:
+//
+// Slot function that shows how far the folders being loaded have got.
+// The bar is a busy indicator while any total is unknown.
+//
+void MainWindow::s_loadProgress() {
+    int done = 0, total = 0;
+    bool known = true;
+    QStringList parts;
+    for(int i=0; i<m_roots.size(); i++) {
+        const libraryRoot &root = *m_roots[i];
+        if(!root.loading) continue;
+
+        int d = root.done, t = root.total;
+        QString name = QFileInfo(root.path).fileName();
+        if(name.isEmpty())
+            name = root.path;
+
+        QString text;
+        switch(root.phase) {
+        case LOAD_INDEX:  text = "restoring %1"; break;
+        case LOAD_SCAN:   text = "scanning %1";  break;
+        default:          text = "covers of %1"; break;
+        }
+        text = text.arg(name);
+        if(t)
+            text += QString(" (%1 of %2)").arg(d).arg(t);
+        else if(d)
+            text += QString(" (%1 files)").arg(d);
+        parts << text;
+
+        done  += d;
+        total += t;
+        known  = known && t;
+    }
+
+    if(parts.isEmpty()) {
+        m_loadTimer->stop();
+        m_loadBar->hide();
+        return;
+    }
+    m_loadBar->setRange(0, known ? total : 0);
+    m_loadBar->setValue(done);
+    showStatus("Library: " + parts.join(", "));
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// MainWindow::s_rootLoaded:
+//
+// Slot function for a folder loaded in the background. It joins the
+// library right away; if it changed since it was indexed, a rescan of
+// that folder alone follows.
+//
+void MainWindow::s_rootLoaded() {
+    TRACE_SLOT("MainWindow::s_rootLoaded");
+    QFutureWatcher<QSharedPointer<libraryLoad>> *watcher =
+            static_cast<QFutureWatcher<QSharedPointer<libraryLoad>> *>(sender());
+    QSharedPointer<libraryRoot> root = m_rootJobs.take(watcher);
+    QSharedPointer<libraryLoad> load = watcher->result();
+    watcher->deleteLater();
+    root->loading = false;
+
+    // File|Load replaced the folders in the meantime
+    if(m_roots.contains(root)) {
+        TRACE_DETAIL(root->path);
+        if(!load->report.isEmpty())
+            m_scanReports << load->report;
+
+        root->shard = load;
+        if(load->stale) {
+            showStatus(QString("%1 changed on disk, rescanning").arg(root->path));
+            loadRoot(root, false);
+        }
+        startMerge();
+    }
+    s_loadProgress();
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// MainWindow::s_libraryLoaded:
+//
+// Slot function that shows the merged library. The first one shown
+// resumes the saved session; later ones keep what is shown and queued.
+// The saved session is put back again once every folder is loaded, as
+// its IDs only hold for the whole library.
+//
+void MainWindow::s_libraryLoaded() {
+    TRACE_SLOT("MainWindow::s_libraryLoaded");
+    QSharedPointer<libraryLoad> load = m_mergeWatcher->result();
+    bool imported = m_mergeImport == m_importShard;
+    if(m_mergeAgain || !imported)
+        startMerge();
+
+    // the folders or imported tracks changed in the meantime
+    if(load->root != rootsKey() || !imported) return;
+
+    bool first = m_library.isEmpty() && !m_sessionPending;
+    if(first) {
+        m_trackResumed   = false;
+        m_sessionPending = m_pendingSession.decode(sessionState::read(sessionState::defaultPath()))
+                           && m_pendingSession.root == rootsKey();
+    }
+    sessionState session = m_sessionPending ? m_pendingSession : captureSession();
+
+    // a queue other than the whole library, such as an imported
+    // playlist, is put back by path as the merge renumbers tracks
+    QStringList queued;
+    if(!first && !m_sessionPending) {
+        const QVector<int> &tracks = m_queue->tracks();
+        bool whole = tracks.size() == m_library.size();
+        for(int i=0; i<tracks.size() && whole; i++)
+            whole = tracks[i] == i;
+        for(int i=0; i<tracks.size() && !whole; i++)
+            queued << m_library.path(tracks[i]);
+    }
+
+    m_library     = load->store;
+    m_libraryHash = load->hash;
+    rebuildQueue();
     initLists();
-    initAlbums();
+    m_thumbs.clear();
+    m_albumsList = load->covers;
     m_glWidget->loadImages(m_albumsList);
+
+    if(m_sessionPending) {
+        if(restoreSession(session, !m_trackResumed))
+            m_trackResumed = true;
+
+        bool loaded = true;
+        for(int i=0; i<m_roots.size(); i++)
+            loaded = loaded && !m_roots[i]->shard.isNull();
+        if(loaded || session.matches(rootsKey(), m_libraryHash))
+            m_sessionPending = false;
+    }
+    else if(!first) {
+        restoreSession(session, false);
+        if(!session.matches(rootsKey(), m_libraryHash))
+            restoreQueue(queued);
+    }
+
+    // time from start until the library could be used
+    if(m_startup.isValid() && !m_libraryReady) {
+        double seconds = m_startup.nsecsElapsed() / 1e9;
+        metricsRegistry::instance()->gauge("qtunes_startup_library_ready_seconds",
+                "Seconds from start until the last library was shown.")->set(seconds);
+        TRACE_DETAIL(QString("library ready %1 ms after start").arg(qRound(seconds * 1000)));
+        m_libraryReady = true;
+    }
+
+    // IDs and the library hash have changed
+    m_sessionDirty = true;
+
+    // with the reports of the folders scanned, once no load progress
+    // would replace them
+    bool loading = false;
+    for(int i=0; i<m_roots.size(); i++)
+        loading = loading || m_roots[i]->loading;
+    QString status = QString(load->fromIndex ? "Restored %1 songs" : "Loaded %1 songs")
+                     .arg(m_library.size());
+    if(!loading && !m_scanReports.isEmpty()) {
+        status += "; " + m_scanReports.join("; ");
+        m_scanReports.clear();
+    }
+    showStatus(status);
+    emit libraryShown();
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// MainWindow::restoreQueue:
+//
+// Queues the tracks at paths that are in the library, keeping the
+// current track. The queue stays as it is if none of them are.
+//
+void MainWindow::restoreQueue(const QStringList &paths) {
+    QVector<int> tracks;
+    for(int i=0; i<paths.size(); i++) {
+        int track = m_library.find(paths[i]);
+        if(track >= 0)
+            tracks << track;
+    }
+    if(tracks.isEmpty()) return;
+
+    QSignalBlocker blocker(m_queue);
+    int current = m_queue->current();
+    m_queue->setTracks(tracks);
+    if(current >= 0)
+        m_queue->setCurrentTrack(current);
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// MainWindow::event:
+//
+// Notes the first paint of the window; the frame is interactive once
+// the event loop gets back to us after it.
+//
+bool MainWindow::event(QEvent *e) {
+    if(e->type() == QEvent::Paint && !m_firstFrame && m_startup.isValid()) {
+        m_firstFrame = true;
+        QTimer::singleShot(0, this, SLOT(s_firstFrame()));
+    }
+    return QMainWindow::event(e);
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// MainWindow::s_firstFrame:
+//
+// Slot function that reports the time to the first interactive frame.
+//
+void MainWindow::s_firstFrame() {
+    TRACE_SLOT("MainWindow::s_firstFrame");
+    if(!m_startup.isValid()) return;
+
+    double seconds = m_startup.nsecsElapsed() / 1e9;
+    metricsRegistry::instance()->gauge("qtunes_startup_first_frame_seconds",
+            "Seconds from start until the window first took input.")->set(seconds);
+    TRACE_DETAIL(QString("%1 ms after start").arg(qRound(seconds * 1000)));
 }
 
 
@@ -1124,6 +2340,7 @@ void MainWindow::s_loadPrev() {
 // Slot function for muting the song being played.
 //
 void MainWindow::s_toggleMute() {
+    TRACE_SLOT("MainWindow::s_toggleMute");
     m_device->setMuted(!m_device->isMuted());
 
     if(m_device->isMuted()) {
@@ -1143,7 +2360,8 @@ void MainWindow::s_toggleMute() {
 // Slot function for shuffling the order of the mp3 files being played.
 //
 void MainWindow::s_shuffle() {
-    m_playlist->setPlaybackMode(m_shuffle->isChecked() ? QMediaPlaylist::Random : QMediaPlaylist::Loop);
+    TRACE_SLOT("MainWindow::s_shuffle");
+    m_queue->setMode(m_shuffle->isChecked() ? playQueue::PlayShuffle : playQueue::PlayLoop);
     // both repeat and shuffle can't be checked at the same time so uncheck the other
     m_repeat->setChecked(false);
 }
@@ -1156,7 +2374,153 @@ void MainWindow::s_shuffle() {
 // Slot function for repeating the song being played.
 //
 void MainWindow::s_repeat() {
-    m_playlist->setPlaybackMode(m_repeat->isChecked() ? QMediaPlaylist::CurrentItemInLoop : QMediaPlaylist::Loop);
+    TRACE_SLOT("MainWindow::s_repeat");
+    m_queue->setMode(m_repeat->isChecked() ? playQueue::PlayRepeatOne : playQueue::PlayLoop);
     // both repeat and shuffle can't be checked at the same time so uncheck the other
     m_shuffle->setChecked(false);
 }
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// MainWindow::captureSession:
+//
+// Returns a snapshot of playback, queue and view.
+//
+sessionState MainWindow::captureSession() {
+    sessionState session;
+    session.setLibrary(rootsKey(), m_libraryHash);
+
+    int track = m_queue->current();
+    if(track >= 0 && track < m_library.size())
+        session.trackPath = m_library.path(track);
+    session.position = m_resumePosition >= 0 ? m_resumePosition : m_device->position();
+    session.playing  = m_device->state() == QMediaPlayer::PlayingState;
+    session.volume   = m_volumeSlider->value();
+    session.muted    = m_device->isMuted();
+    session.playMode = m_queue->mode();
+    session.queue    = m_queue->saveState();
+
+    session.searchField = m_search->currentIndex();
+    session.searchInput = m_typeSearch->text();
+    session.searchText  = m_searchText;
+    for(int p=0; p<3; p++)
+        session.facet[p] = m_facet[p];
+    session.sortColumn = m_sortColumn;
+    session.ascending  = m_ascendSorted;
+    session.coverPosition  = m_glWidget->position();
+    session.coverDirection = m_glWidget->direction();
+    return session;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// MainWindow::restoreSession:
+//
+// Puts back a snapshot over a freshly loaded library. IDs are only
+// used if the library is the snapshot's; otherwise the track is found
+// by path and the queue is the library. With resume set the track is
+// loaded, seeked and paused or played as it was, so its buffers are
+// filled before the user presses Play; without it the media playing
+// now is left alone. Returns true if it loaded the track.
+//
+bool MainWindow::restoreSession(const sessionState &session, bool resume) {
+    TRACE_SCOPE("MainWindow::restoreSession", "load");
+    bool same = session.matches(rootsKey(), m_libraryHash);
+
+    // search, panel picks and sort order
+    if(session.searchField >= 0 && session.searchField < m_search->count())
+        m_search->setCurrentIndex(session.searchField);
+    m_typeSearch->setText(session.searchInput);
+    m_searchText = session.searchText;
+    static const int fields[2] = {GENRE, ARTIST};
+    int counts[3] = {m_library.valueCount(fields[0]), m_library.valueCount(fields[1]),
+                     m_library.albumCount()};
+    for(int p=0; p<3; p++)
+        m_facet[p] = same && session.facet[p] >= 0 && session.facet[p] < counts[p] ?
+                     session.facet[p] : -1;
+    if(session.sortColumn >= 0 && session.sortColumn < COLS) {
+        m_sortColumn   = session.sortColumn;
+        m_ascendSorted = session.ascending;
+        m_table->horizontalHeader()->setSortIndicatorShown(true);
+        m_table->horizontalHeader()->setSortIndicator(m_sortColumn,
+                m_ascendSorted ? Qt::AscendingOrder : Qt::DescendingOrder);
+    }
+    applyFilter();
+
+    // queue, made current without reloading the media
+    int track = session.trackPath.isEmpty() ? -1 : m_library.find(session.trackPath);
+    {
+        QSignalBlocker blocker(m_queue);
+        if(!same || !m_queue->restoreState(session.queue, m_library.size()))
+            m_queue->setMode((playQueue::PlayMode) session.playMode);
+        if(track >= 0 && m_queue->current() != track)
+            m_queue->setCurrentTrack(track);
+    }
+    m_shuffle->setChecked(m_queue->mode() == playQueue::PlayShuffle);
+    m_repeat ->setChecked(m_queue->mode() == playQueue::PlayRepeatOne);
+
+    if(same)
+        m_glWidget->setPosition(session.coverPosition, session.coverDirection);
+
+    if(!resume) return false;
+
+    m_volumeSlider->setValue(session.volume);
+    if(session.muted != m_device->isMuted())
+        s_toggleMute();
+    if(track < 0) return false;
+
+    s_trackChanged(track);
+    m_resumePosition = session.position;
+    if(session.playing) {
+        m_stats->markPlayRequested();
+        m_device->play();
+    }
+    else
+        m_device->pause();
+    return true;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// MainWindow::s_sessionChanged:
+//
+// Slot function that marks the session snapshot for the next save.
+//
+void MainWindow::s_sessionChanged() {
+    m_sessionDirty = true;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// MainWindow::s_saveSession:
+//
+// Slot function that writes the session snapshot if it changed, so an
+// idle or merely playing window encodes nothing. Not before the
+// library is shown in full, which would overwrite the snapshot about
+// to be resumed with an empty or partial one.
+//
+void MainWindow::s_saveSession() {
+    TRACE_SLOT("MainWindow::s_saveSession");
+    if(!m_sessionDirty || m_library.isEmpty() || m_sessionPending) return;
+
+    if(sessionState::write(sessionState::defaultPath(), captureSession().encode()))
+        m_sessionDirty = false;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// MainWindow::closeEvent:
+//
+// Saves the session, with the position reached, before the window
+// closes.
+//
+void MainWindow::closeEvent(QCloseEvent *e) {
+    m_sessionDirty = true;
+    s_saveSession();
+    QMainWindow::closeEvent(e);
+}
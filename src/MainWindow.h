@@ -14,10 +14,26 @@
 #include <QtMultimedia>
 #include <QDebug>
 #include <id3v2tag.h>
+#include <mpegfile.h>
 #include "glWidget.h"
 #include "openPrompt.h"
+#include "waveformSlider.h"
+#include "trackStore.h"
+#include "sessionState.h"
+#include <atomic>
 
+class playbackStats;
+class playQueue;
+class statsPanel;
+class memoryPanel;
+class memoryReport;
 class glVisualizer;
+class trackSorter;
+class queryEngine;
+class resultCache;
+struct libraryLoad;
+struct libraryRoot;
+struct playlistLoad;
 
 ///////////////////////////////////////////////////////////////////////////////
 ///
@@ -35,15 +51,25 @@ class MainWindow : public QMainWindow {
     Q_OBJECT
 
 public:
-    //! Constructor.
-    MainWindow(QString);
+    //! Constructor; startup, if given, times the first interactive frame.
+    MainWindow(QString, const QElapsedTimer *startup = NULL);
 
     //! Destructor.
     ~MainWindow();
 
+    //! Scans dir as the only library folder, as File|Load does after its
+    //! dialog; libraryShown() is emitted once it is shown.
+    void loadLibrary(const QString &dir);
+
+signals:
+    //! Emitted whenever a newly loaded or merged library is shown.
+    void libraryShown();
+
+
     public slots:
     // slots
     void s_load();
+    void s_addRoot();
     void s_panel1(QListWidgetItem*);
     void s_panel2(QListWidgetItem*);
     void s_panel3(QListWidgetItem*);
@@ -64,18 +90,44 @@ public:
     void s_animateRight();
     void s_sortTable(int);
     void s_loadPrev();
+    void s_rememberRestore(bool);
+    void s_rootLoaded();
+    void s_libraryLoaded();
+    void s_loadProgress();
+    void s_firstFrame();
+    void s_saveSession();
+    void s_sessionChanged();
 
     void s_mediaStateChanged(QMediaPlayer::State);
     void s_toggleMute();
 
     void s_shuffle();
     void s_repeat();
+    void s_waveformReady(const QString &);
+    void s_showStats();
+    void s_toggleOverlay(bool);
+    void s_showMemory();
+    void s_refreshMemory();
+    void s_playNext();
+    void s_enqueue();
+    void s_trackChanged(int);
+    void s_mediaStatusChanged(QMediaPlayer::MediaStatus);
+    void s_importPlaylist();
+    void s_playlistImported();
+    void s_exportPlaylist();
+    void s_flushUpdates();
 
     // other functions
     void updateSong();
-    QImage initImage(TagLib::ID3v2::Tag *);
+
+    // cover decoding; safe off the GUI thread
+    static QList<QImage> decodeCovers(const trackStore &, const QVector<int> &,
+                                      std::atomic<int> *done = NULL,
+                                      const std::atomic<bool> *abort = NULL);
 
 protected:
+    bool event(QEvent *);
+    void closeEvent(QCloseEvent *);
     void keyPressEvent(QKeyEvent *);
 
 private:
@@ -84,17 +136,42 @@ private:
     void createWidgets();
     void createLayouts();
     void initLists();
-    void redrawLists(QListWidgetItem *, int);
-    void traverseDirs(QString);
+    void fillPanel(int, int, const QVector<int> &, const QVector<int> &);
+    void applyFilter();
+    void fillTable(const QVector<int> &);
+    void fillRows(const QVector<int> &, bool);
     void setSizes(QSplitter *, int, int);
     void initAlbums();
     void loadDirs();
-    void saveDir(QString path);
+    void setRoots(const QStringList &paths);
+    void saveRoots();
+    QStringList rootPaths() const;
+    QString rootsKey() const;
+    void restoreLibrary(bool useIndex);
+    void loadRoot(const QSharedPointer<libraryRoot> &, bool useIndex);
+    void startMerge();
+    sessionState captureSession();
+    bool restoreSession(const sessionState &, bool resume);
+    void rebuildQueue();
+    void restoreQueue(const QStringList &);
+    void playTrack(int);
+    void scheduleUpdate(int);
+    void showStatus(const QString &);
+    QList<int> selectedTracks();
+    void reportMemory(memoryReport *);
 
     // actions
     QAction		*m_loadAction;
+    QAction		*m_addRootAction;
+    QAction		*m_importAction;
+    QAction		*m_exportAction;
     QAction		*m_quitAction;
     QAction		*m_aboutAction;
+    QAction		*m_statsAction;
+    QAction		*m_overlayAction;
+    QAction		*m_memoryAction;
+    QAction		*m_playNextAction;
+    QAction		*m_enqueueAction;
     QAction     *m_leftMoveAction;
     QAction     *m_rightMoveAction;
 
@@ -116,16 +193,30 @@ private:
     QTabWidget      *m_tabWidget;
 
     // string lists
-    QString		   m_directory;
+    QString		   m_directory;     // last folder picked, for dialogs
     QString        m_searchText;
-    QStringList	   m_listGenre;
-    QStringList	   m_listArtist;
-    QStringList	   m_listAlbum;
-    QList<QStringList> m_listSongs;
+
+    // all genre and artist value IDs and album IDs, in collation order
+    QVector<int>   m_listGenre;
+    QVector<int>   m_listArtist;
+    QVector<int>   m_listAlbum;
+
+    // search query and the value ID picked in each panel (-1 for all)
+    queryEngine    *m_query;
+    int            m_facet[3];
+    resultCache    *m_results;
+
+    // music library, and the tracks imported from outside its folders
+    trackStore     m_library;
+    QByteArray     m_libraryHash;       // sessionState::hashLibrary(m_library)
+    QSharedPointer<libraryLoad> m_importShard;
 
     // player variables
     QMediaPlayer     *m_device;
-    QMediaPlaylist   *m_playlist;
+    playQueue        *m_queue;
+    playbackStats    *m_stats;
+    statsPanel       *m_statsPanel;
+    memoryPanel      *m_memoryPanel;
 
     QToolButton      *m_play;
     QToolButton      *m_stop;
@@ -138,7 +229,7 @@ private:
 
     QComboBox        *m_search;
     QSlider          *m_volumeSlider;
-    QSlider          *m_positionSlider;
+    waveformSlider   *m_positionSlider;
     QLabel           *m_positionLabel;
     QLabel           *m_infoLabel;
     QLabel           *m_albumLabel;
@@ -146,6 +237,7 @@ private:
     // images
     QImage           m_cover;
     QList<QImage>    m_albumsList;
+    QCache<int, QImage> m_thumbs;       // label covers by album ID
 
     // cover flow
     glWidget         *m_glWidget;
@@ -157,9 +249,50 @@ private:
     QPushButton      *m_toggleColor;
     QTimer           *m_visualizerTimer;
 
+    // seek bar overviews
+    waveformCache    *m_waveforms;
+
     // table widget
+    trackSorter      *m_sorter;
+    QVector<int>     m_viewTracks;      // tracks in the table, ascending if sorted
+    int              m_sortColumn;      // -1 if unsorted
     bool             m_ascendSorted;
 
+    // library folders, each restored or scanned in the background on
+    // a thread of its own, and the job merging those loaded so far
+    QList<QSharedPointer<libraryRoot>> m_roots;
+    QHash<QObject *, QSharedPointer<libraryRoot>> m_rootJobs;  // by watcher
+    QThreadPool      m_rootPool;
+    QFutureWatcher<QSharedPointer<libraryLoad>> *m_mergeWatcher;
+    bool             m_mergeAgain;      // roots loaded while merging
+    QStringList      m_scanReports;     // of folders scanned, until shown
+    QFutureWatcher<QSharedPointer<playlistLoad>> *m_importWatcher;
+    std::atomic<bool> m_importAbort;    // set to end an import early
+    QSharedPointer<libraryLoad> m_mergeImport;  // imported tracks merged
+    QProgressBar     *m_loadBar;
+    QTimer           *m_loadTimer;
+
+    // time since process start, for the first frame and library
+    QElapsedTimer    m_startup;
+    bool             m_firstFrame;
+    bool             m_libraryReady;
+
+    // session snapshot, written when it changes; the saved one stays
+    // pending until every folder has been loaded
+    QTimer           *m_sessionTimer;
+    bool             m_sessionDirty;    // changed since the last write
+    sessionState     m_pendingSession;
+    bool             m_sessionPending;
+    bool             m_trackResumed;
+    qint64           m_resumePosition;  // applied once the media loads, or -1
+
+    // updates coalesced to the display refresh
+    QTimer           *m_frameTimer;
+    int              m_pendingMask;
+    qint64           m_pendingPosition;
+    qint64           m_pendingDuration;
+    QString          m_pendingStatus;
+
 };
 
 #endif // MAINWINDOW_H
@@ -0,0 +1,73 @@
+#include "allocStats.h"
+#include <cstdlib>
+#include <new>
+
+// per thread, and constant-initialized so that taking it never
+// allocates itself
+static thread_local unsigned long long t_allocs = 0;
+
+#ifdef QTUNES_ALLOC_STATS
+#ifdef __GLIBC__
+
+// Qt containers allocate with malloc, so count there; operator new
+// ends up here too
+extern "C" void *__libc_malloc(size_t);
+extern "C" void *__libc_calloc(size_t, size_t);
+extern "C" void *__libc_realloc(void *, size_t);
+
+extern "C" void *malloc(size_t size) {
+    t_allocs++;
+    return __libc_malloc(size);
+}
+
+extern "C" void *calloc(size_t n, size_t size) {
+    t_allocs++;
+    return __libc_calloc(n, size);
+}
+
+extern "C" void *realloc(void *p, size_t size) {
+    t_allocs++;
+    return __libc_realloc(p, size);
+}
+
+#else
+
+// elsewhere only operator new can be replaced portably
+void *operator new(size_t size) {
+    t_allocs++;
+    if(void *p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept {
+    std::free(p);
+}
+
+#endif
+#endif
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// allocCount:
+//
+// Returns the number of allocations made by this thread so far.
+//
+quint64 allocCount() {
+    return t_allocs;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// allocCountEnabled:
+//
+// Returns true if allocations are being counted.
+//
+bool allocCountEnabled() {
+#ifdef QTUNES_ALLOC_STATS
+    return true;
+#else
+    return false;
+#endif
+}
@@ -0,0 +1,12 @@
+#ifndef ALLOCSTATS_H
+#define ALLOCSTATS_H
+
+#include <QtCore>
+
+// heap allocations made by the calling thread so far, so work running
+// on other threads does not show up in a measurement; counting is
+// compiled in with CONFIG+=alloc_stats and allocCount() is 0 otherwise
+quint64 allocCount();
+bool    allocCountEnabled();
+
+#endif // ALLOCSTATS_H
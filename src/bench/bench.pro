@@ -0,0 +1,27 @@
+######################################################################
+# Data-path benchmarks on a synthetic library; see benchMain.cpp.
+#
+#   qmake bench.pro && make
+#   ./bench --tracks 100000 --label `git describe --always` --out result.json
+######################################################################
+QT += core gui concurrent
+QT -= widgets
+
+CONFIG += console
+CONFIG -= app_bundle
+TEMPLATE = app
+TARGET = bench
+INCLUDEPATH += .. -I /opt/local/include/taglib
+LIBS += -L/opt/local/lib
+LIBS += -ltag
+
+# Input
+HEADERS += libraryGenerator.h benchReport.h \
+           ../id3Reader.h ../scanArena.h ../trackStore.h ../libraryScanner.h ../coverArt.h ../allocStats.h ../memoryReport.h \
+           ../trackSorter.h ../trackBitmap.h ../queryEngine.h ../traceRecorder.h ../metricsRegistry.h
+SOURCES += benchMain.cpp libraryGenerator.cpp benchReport.cpp \
+           ../id3Reader.cpp ../scanArena.cpp ../trackStore.cpp ../libraryScanner.cpp ../coverArt.cpp ../allocStats.cpp ../memoryReport.cpp \
+           ../trackSorter.cpp ../trackBitmap.cpp ../queryEngine.cpp ../traceRecorder.cpp ../metricsRegistry.cpp
+
+alloc_stats: DEFINES += QTUNES_ALLOC_STATS
+no_trace: DEFINES += QTUNES_NO_TRACE
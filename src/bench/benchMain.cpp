@@ -0,0 +1,227 @@
+#include <QtCore>
+#include <algorithm>
+#include <functional>
+#include "libraryGenerator.h"
+#include "trackStore.h"
+#include "libraryScanner.h"
+#include "trackSorter.h"
+#include "queryEngine.h"
+#include "coverArt.h"
+#include "benchReport.h"
+
+// table column names for the sort benchmarks
+static const char *COLUMN_NAMES[COLS] = {"title", "track", "time", "artist", "album", "genre"};
+
+// substrings searched by the search benchmark
+static const char *SEARCH_TERMS[] = {"ka", "mor", "zen", "el", "qua", "sil", "rho", "dan"};
+const int SEARCH_TERM_COUNT = sizeof(SEARCH_TERMS) / sizeof(SEARCH_TERMS[0]);
+
+// library sizes --tracks is clamped to
+const int MIN_TRACKS = 1000;
+const int MAX_TRACKS = 1000000;
+
+static benchReport report("bench");
+
+// keeps results alive so the work is not optimised away
+static volatile qint64 sink;
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// measure:
+//
+// Times body once per run and records the result under name.
+//
+static void measure(const QString &name, qint64 items, int runs,
+                    const std::function<void(int)> &body) {
+    benchResult r;
+    r.name     = name;
+    r.items    = items;
+    r.timeouts = 0;
+    for(int i=0; i<runs; i++) {
+        QElapsedTimer timer;
+        timer.start();
+        body(i);
+        r.ms << timer.nsecsElapsed() / 1e6;
+    }
+    report.add(r);
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// showFilter:
+//
+// What applyFilter() computes for a result: the artist counts, the
+// album counts and the table's track list.
+//
+static void showFilter(queryEngine *query, const trackBitmap &result) {
+    sink += query->facetCounts(ARTIST, result).size();
+    sink += query->albumCounts(result).size();
+    sink += result.toVector().size();
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// main:
+//
+// Generates (or reuses) a library, runs the data-path benchmarks on it
+// and writes the results as JSON.
+//
+int main(int argc, char **argv) {
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("qtunes-bench");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Benchmarks the qtunes library code on a synthetic library.");
+    parser.addHelpOption();
+    QCommandLineOption tracksOpt("tracks",     QString("Tracks in the library (%1-%2).")
+                                 .arg(MIN_TRACKS).arg(MAX_TRACKS), "n", "10000");
+    QCommandLineOption libraryOpt("library",   "Library folder; reused if it matches.", "path");
+    QCommandLineOption seedOpt("seed",         "Generator seed.", "n", "1");
+    QCommandLineOption artSizeOpt("art-size",  "Cover size in pixels.", "px", "300");
+    QCommandLineOption artRatioOpt("art-ratio", "Share of albums with a cover.", "r", "0.8");
+    QCommandLineOption runsOpt("runs",         "Runs of whole-library benchmarks.", "n", "5");
+    QCommandLineOption itersOpt("iterations",  "Runs of per-event benchmarks.", "n", "200");
+    QCommandLineOption coversOpt("covers",     "Covers decoded by initAlbums (0 = all).", "n", "0");
+    QCommandLineOption labelOpt("label",       "Label stored with the results, e.g. a commit.", "text");
+    QCommandLineOption outOpt("out",           "Write JSON here instead of stdout.", "file");
+    QCommandLineOption baselineOpt("baseline", "Compare with an earlier JSON report.", "file");
+    parser.addOptions(QList<QCommandLineOption>() << tracksOpt << libraryOpt << seedOpt
+                      << artSizeOpt << artRatioOpt << runsOpt << itersOpt << coversOpt
+                      << labelOpt << outOpt << baselineOpt);
+    parser.process(app);
+
+    int tracks = qBound(MIN_TRACKS, parser.value(tracksOpt).toInt(), MAX_TRACKS);
+    int runs   = qMax(1, parser.value(runsOpt).toInt());
+    int iters  = qMax(1, parser.value(itersOpt).toInt());
+    int covers = parser.value(coversOpt).toInt();
+    QString root = parser.isSet(libraryOpt) ? parser.value(libraryOpt)
+                 : QDir::temp().filePath(QString("qtunes-bench-%1").arg(tracks));
+
+    // library
+    libraryGenerator generator(parser.value(seedOpt).toUInt());
+    generator.setArtSize(parser.value(artSizeOpt).toInt());
+    generator.setArtRatio(parser.value(artRatioOpt).toDouble());
+
+    QElapsedTimer timer;
+    timer.start();
+    QString error;
+    if(!generator.generate(root, tracks, &error)) {
+        fprintf(stderr, "qtunes-bench: %s\n", qPrintable(error));
+        return 1;
+    }
+    double generated = timer.elapsed() / 1000.0;
+    fprintf(stderr, "library %s: %d tracks, %s in %.1f s\n", qPrintable(root), tracks,
+            generator.reused() ? "reused" : "generated", generated);
+
+    // traverseDirs: the first scan warms the page cache and is kept
+    trackStore store;
+    libraryScanner(&store).scan(root);
+    measure("traverseDirs", store.size(), runs, [&](int) {
+        trackStore fresh;
+        libraryScanner(&fresh).scan(root);
+        sink += fresh.size();
+    });
+    qint64 scanRss = benchReport::peakRss();
+
+    // initLists: panel values and the first, unfiltered view
+    measure("initLists", store.size(), runs, [&](int) {
+        sink += store.distinctValues(GENRE).size();
+        sink += store.distinctValues(ARTIST).size();
+        sink += store.albumOrder().size();
+
+        queryEngine query(&store);
+        trackBitmap all;
+        query.evaluate(QString(), &all, NULL);
+        sink += query.facetCounts(GENRE, all).size();
+        showFilter(&query, all);
+    });
+
+    // panel clicks on a warm engine; picks follow tracks spread over the library
+    queryEngine query(&store);
+    trackBitmap all;
+    query.evaluate(QString(), &all, NULL);
+    showFilter(&query, all);
+
+    measure("s_panel1", 1, iters, [&](int i) {
+        int track = (qint64) i * 7919 % store.size();
+        showFilter(&query, all & query.postings(GENRE, store.valueId(track, GENRE)));
+    });
+    measure("s_panel2", 1, iters, [&](int i) {
+        int track = (qint64) i * 7919 % store.size();
+        trackBitmap genre = all & query.postings(GENRE, store.valueId(track, GENRE));
+        showFilter(&query, genre & query.postings(ARTIST, store.valueId(track, ARTIST)));
+    });
+
+    // s_search: one-field substring searches and a combined query
+    measure("s_search", 1, iters, [&](int i) {
+        trackBitmap result;
+        query.evaluate(QString("title : \"%1\"").arg(SEARCH_TERMS[i % SEARCH_TERM_COUNT]),
+                       &result, NULL);
+        showFilter(&query, result);
+    });
+    measure("query", 1, iters, [&](int i) {
+        trackBitmap result;
+        query.evaluate(QString("(genre = Rock or genre = Jazz) and time > 3:00 and not artist : %1")
+                       .arg(SEARCH_TERMS[i % SEARCH_TERM_COUNT]), &result, NULL);
+        showFilter(&query, result);
+    });
+
+    // s_sortTable: each column of the whole library with cold keys,
+    // then a genre's tracks with warm keys
+    QVector<int> every = all.toVector();
+    for(int f=0; f<COLS; f++) {
+        measure(QString("s_sortTable/%1").arg(COLUMN_NAMES[f]), every.size(), runs, [&](int) {
+            trackSorter sorter(&store);
+            sink += sorter.sort(every, f).size();
+        });
+    }
+    trackSorter sorter(&store);
+    sorter.order(ARTIST);
+    measure("s_sortTable/subset", 1, iters, [&](int i) {
+        int track = (qint64) i * 7919 % store.size();
+        QVector<int> genre = (all & query.postings(GENRE, store.valueId(track, GENRE))).toVector();
+        sink += sorter.sort(genre, ARTIST).size();
+    });
+
+    // initAlbums: one cover per album at cover flow size
+    QVector<int> albums = store.albumOrder();
+    int decoded = covers > 0 ? qMin(covers, albums.size()) : albums.size();
+    measure("initAlbums", decoded, runs, [&](int) {
+        QVector<int> order = store.albumOrder();
+        QImage image;
+        for(int k=0; k<decoded; k++) {
+            int art = store.albumInfo(order[k]).art;
+            if(art >= 0 && coverArt::read(store, art, QSize(256, 256), &image))
+                sink += image.width();
+        }
+    });
+
+    // report
+    QJsonObject library;
+    library["path"]      = root;
+    library["tracks"]    = store.size();
+    library["albums"]    = store.albumCount();
+    library["artists"]   = store.valueCount(ARTIST);
+    library["genres"]    = store.valueCount(GENRE);
+    library["seed"]      = (qint64) parser.value(seedOpt).toUInt();
+    library["art_size"]  = parser.value(artSizeOpt).toInt();
+    library["art_ratio"] = parser.value(artRatioOpt).toDouble();
+    library["reused"]    = generator.reused();
+    library["generate_s"] = generated;
+
+    report.setInfo("label",   parser.value(labelOpt));
+    report.setInfo("library", library);
+    report.setInfo("peak_rss_kb_after_scan", scanRss);
+
+    QJsonObject baseline;
+    if(parser.isSet(baselineOpt) && !benchReport::readBaseline(parser.value(baselineOpt), &baseline))
+        fprintf(stderr, "qtunes-bench: cannot read %s\n", qPrintable(parser.value(baselineOpt)));
+    fprintf(stderr, "\n%s", qPrintable(report.table(baseline)));
+
+    if(!report.write(parser.value(outOpt))) {
+        fprintf(stderr, "qtunes-bench: cannot write %s\n", qPrintable(parser.value(outOpt)));
+        return 1;
+    }
+    return 0;
+}
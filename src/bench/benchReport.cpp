@@ -0,0 +1,213 @@
+#include "benchReport.h"
+#include <algorithm>
+
+#ifdef Q_OS_UNIX
+#include <sys/resource.h>
+#endif
+
+// bump when result fields change meaning
+const int SCHEMA_VERSION = 1;
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// percentile:
+//
+// Nearest-rank percentile p (0..100) of sorted timings.
+//
+static double percentile(const QVector<double> &sorted, double p) {
+    if(sorted.isEmpty()) return 0;
+    int rank = qCeil(p / 100 * sorted.size());
+    return sorted[qBound(0, rank - 1, sorted.size() - 1)];
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// benchReport::benchReport:
+//
+// Constructor. tool names the program in the report.
+//
+benchReport::benchReport(const QString &tool)
+    : m_tool(tool) {
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// benchReport::add:
+//
+// Adds a result and prints its median as progress.
+//
+void benchReport::add(const benchResult &r) {
+    m_results << r;
+
+    QVector<double> sorted = r.ms;
+    std::sort(sorted.begin(), sorted.end());
+    fprintf(stderr, "%-24s %10.3f ms median  (%d runs", qPrintable(r.name),
+            percentile(sorted, 50), sorted.size());
+    if(r.timeouts)
+        fprintf(stderr, ", %d timed out", r.timeouts);
+    fprintf(stderr, ")\n");
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// benchReport::setInfo:
+//
+// Adds a top-level field describing the run.
+//
+void benchReport::setInfo(const QString &key, const QJsonValue &value) {
+    m_info[key] = value;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// benchReport::summary:
+//
+// Summary statistics of one benchmark.
+//
+QJsonObject benchReport::summary(const benchResult &r) {
+    QVector<double> sorted = r.ms;
+    std::sort(sorted.begin(), sorted.end());
+
+    double sum = 0;
+    for(int i=0; i<sorted.size(); i++)
+        sum += sorted[i];
+    double median = percentile(sorted, 50);
+
+    QJsonObject o;
+    o["name"]        = r.name;
+    o["runs"]        = sorted.size();
+    o["timeouts"]    = r.timeouts;
+    o["items"]       = r.items;
+    o["min_ms"]      = sorted.isEmpty() ? 0 : sorted.first();
+    o["mean_ms"]     = sorted.isEmpty() ? 0 : sum / sorted.size();
+    o["p50_ms"]      = median;
+    o["p90_ms"]      = percentile(sorted, 90);
+    o["p99_ms"]      = percentile(sorted, 99);
+    o["max_ms"]      = sorted.isEmpty() ? 0 : sorted.last();
+    o["items_per_s"] = median > 0 ? r.items / (median / 1000) : 0;
+    return o;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// benchReport::toJson:
+//
+// The whole report.
+//
+QJsonObject benchReport::toJson() const {
+    QJsonArray list;
+    for(int i=0; i<m_results.size(); i++)
+        list << summary(m_results[i]);
+
+    QJsonObject report = m_info;
+    report["schema"]      = SCHEMA_VERSION;
+    report["tool"]        = m_tool;
+    report["timestamp"]   = QDateTime::currentDateTimeUtc().toString(Qt::ISODate);
+    report["qt"]          = QString(qVersion());
+    report["cpus"]        = QThread::idealThreadCount();
+    report["results"]     = list;
+    report["peak_rss_kb"] = peakRss();
+    return report;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// benchReport::table:
+//
+// Formats the results as a text table. With a baseline report, each
+// row also shows the baseline median and the change against it.
+//
+QString benchReport::table(const QJsonObject &baseline) const {
+    QHash<QString, double> base;
+    QJsonArray previous = baseline["results"].toArray();
+    for(int i=0; i<previous.size(); i++) {
+        QJsonObject o = previous[i].toObject();
+        base.insert(o["name"].toString(), o["p50_ms"].toDouble());
+    }
+
+    QString text = QString("%1 %2 %3 %4 %5").arg(QString("benchmark"), -28)
+                   .arg(QString("runs"), 6).arg(QString("p50 ms"), 10)
+                   .arg(QString("p90 ms"), 10).arg(QString("p99 ms"), 10);
+    if(!base.isEmpty())
+        text += QString(" %1 %2").arg(QString("base p50"), 10).arg(QString("change"), 9);
+    text += '\n';
+
+    for(int i=0; i<m_results.size(); i++) {
+        QJsonObject o = summary(m_results[i]);
+        double median = o["p50_ms"].toDouble();
+        text += QString("%1 %2 %3 %4 %5").arg(o["name"].toString(), -28)
+                .arg(o["runs"].toInt(), 6)
+                .arg(median, 10, 'f', 3)
+                .arg(o["p90_ms"].toDouble(), 10, 'f', 3)
+                .arg(o["p99_ms"].toDouble(), 10, 'f', 3);
+
+        if(base.contains(o["name"].toString())) {
+            double before = base.value(o["name"].toString());
+            QString change = before > 0
+                    ? QString("%1%").arg((median - before) / before * 100, 0, 'f', 1)
+                    : QString("-");
+            if(before > 0 && median >= before) change.prepend('+');
+            text += QString(" %1 %2").arg(before, 10, 'f', 3).arg(change, 9);
+        }
+        text += '\n';
+    }
+    return text;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// benchReport::write:
+//
+// Writes the JSON report.
+//
+bool benchReport::write(const QString &path) const {
+    QByteArray json = QJsonDocument(toJson()).toJson();
+    if(path.isEmpty())
+        return fwrite(json.constData(), 1, json.size(), stdout) == (size_t) json.size();
+
+    QSaveFile out(path);
+    return out.open(QIODevice::WriteOnly) && out.write(json) == json.size() && out.commit();
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// benchReport::readBaseline:
+//
+// Loads a report written by write().
+//
+bool benchReport::readBaseline(const QString &path, QJsonObject *baseline) {
+    QFile file(path);
+    if(!file.open(QIODevice::ReadOnly)) return false;
+
+    QJsonDocument doc = QJsonDocument::fromJson(file.readAll());
+    if(!doc.isObject()) return false;
+    *baseline = doc.object();
+    return true;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// benchReport::peakRss:
+//
+// Peak resident set size of the process in KiB, or -1 if unknown.
+//
+qint64 benchReport::peakRss() {
+#ifdef Q_OS_UNIX
+    struct rusage usage;
+    if(getrusage(RUSAGE_SELF, &usage) == 0)
+#ifdef Q_OS_MAC
+        return usage.ru_maxrss / 1024;
+#else
+        return usage.ru_maxrss;
+#endif
+#endif
+    return -1;
+}
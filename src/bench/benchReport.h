@@ -0,0 +1,52 @@
+#ifndef BENCHREPORT_H
+#define BENCHREPORT_H
+
+#include <QtCore>
+
+// timings of one benchmark
+struct benchResult {
+    QString         name;
+    qint64          items;      // work done per run: tracks, albums or events
+    QVector<double> ms;
+    int             timeouts;   // runs that did not finish; not in ms
+};
+
+///////////////////////////////////////////////////////////////////////////////
+///
+/// \class benchReport
+/// \brief Collects benchmark results and writes them as JSON or a table.
+///
+/// The JSON holds min, mean, p50/p90/p99 and max per benchmark plus
+/// the run's context (label, Qt version, CPUs, peak RSS and whatever
+/// the tool adds with setInfo()). table() prints the same results next
+/// to a baseline report so runs on two commits can be compared.
+///
+///////////////////////////////////////////////////////////////////////////////
+
+class benchReport
+{
+public:
+    benchReport(const QString &tool);
+
+    // adds a result and prints its median to stderr
+    void            add(const benchResult &r);
+    void            setInfo(const QString &key, const QJsonValue &value);
+
+    QJsonObject     toJson() const;
+    QString         table(const QJsonObject &baseline = QJsonObject()) const;
+
+    // writes JSON to path, or to stdout if path is empty
+    bool            write(const QString &path) const;
+
+    static bool     readBaseline(const QString &path, QJsonObject *baseline);
+    static qint64   peakRss();
+
+private:
+    static QJsonObject summary(const benchResult &r);
+
+    QString             m_tool;
+    QVector<benchResult> m_results;
+    QJsonObject         m_info;
+};
+
+#endif // BENCHREPORT_H
@@ -0,0 +1,288 @@
+#include <QtWidgets>
+#include <QtOpenGL>
+#include <functional>
+#include "glWidget.h"
+#include "glvisualizer.h"
+#include "benchReport.h"
+
+#ifndef GL_TIME_ELAPSED
+#define GL_TIME_ELAPSED     0x88BF
+#endif
+#ifndef GL_QUERY_RESULT
+#define GL_QUERY_RESULT     0x8866
+#endif
+
+// skip cover flow cases whose textures would take more than this
+const qint64 TEXTURE_BUDGET = Q_INT64_C(512) << 20;
+
+// frames between jumps of the visualizer bars (500 ms at 25 ms a frame)
+const int JUMP_FRAMES = 20;
+
+///////////////////////////////////////////////////////////////////////////////
+///
+/// \class gpuTimer
+/// \brief GL_TIME_ELAPSED queries where the driver has ARB_timer_query.
+///
+///////////////////////////////////////////////////////////////////////////////
+
+class gpuTimer
+{
+public:
+    gpuTimer() : m_query(0) {
+        QGLContext *context = const_cast<QGLContext *>(QGLContext::currentContext());
+        QByteArray extensions = (const char *) glGetString(GL_EXTENSIONS);
+        if(!context || !extensions.contains("GL_ARB_timer_query")) {
+            m_begin = NULL;
+            return;
+        }
+
+        m_gen    = (genQueries)    context->getProcAddress("glGenQueries");
+        m_begin  = (beginQuery)    context->getProcAddress("glBeginQuery");
+        m_end    = (endQuery)      context->getProcAddress("glEndQuery");
+        m_result = (queryResult64) context->getProcAddress("glGetQueryObjectui64v");
+        if(!m_gen || !m_begin || !m_end || !m_result)
+            m_begin = NULL;
+        else
+            m_gen(1, &m_query);
+    }
+
+    bool    isValid() const     { return m_begin != NULL; }
+    void    begin()             { if(m_begin) m_begin(GL_TIME_ELAPSED, m_query); }
+    void    end()               { if(m_begin) m_end(GL_TIME_ELAPSED); }
+
+    // ms of GPU time between begin() and end(); waits for the result
+    double  elapsed() {
+        quint64 ns = 0;
+        if(m_begin) m_result(m_query, GL_QUERY_RESULT, &ns);
+        return ns / 1e6;
+    }
+
+private:
+    typedef void (*genQueries)(GLsizei, GLuint *);
+    typedef void (*beginQuery)(GLenum, GLuint);
+    typedef void (*endQuery)(GLenum);
+    typedef void (*queryResult64)(GLuint, GLenum, quint64 *);
+
+    genQueries      m_gen;
+    beginQuery      m_begin;
+    endQuery        m_end;
+    queryResult64   m_result;
+    GLuint          m_query;
+};
+
+// exposes the GL entry points of the cover flow to the benchmark
+class coverFlowProbe : public glWidget
+{
+public:
+    void    init()                  { initializeGL(); }
+    void    reshape(int w, int h)   { resizeGL(w, h); }
+    void    paint()                 { paintGL(); }
+};
+
+// the same for the visualizer
+class visualizerProbe : public glVisualizer
+{
+public:
+    void    init()                  { initializeGL(); }
+    void    reshape(int w, int h)   { resizeGL(w, h); }
+    void    paint()                 { paintGL(); }
+};
+
+static benchReport report("glbench");
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// sizes:
+//
+// Parses a comma-separated list of positive numbers.
+//
+static QList<int> sizes(const QString &text) {
+    QList<int> list;
+    QStringList parts = text.split(',', QString::SkipEmptyParts);
+    for(int i=0; i<parts.size(); i++)
+        if(parts[i].toInt() > 0)
+            list << parts[i].toInt();
+    return list;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// covers:
+//
+// n distinct gradient covers of size x size.
+//
+static QList<QImage> covers(int n, int size) {
+    QList<QImage> list;
+    for(int k=0; k<n; k++) {
+        QImage image(size, size, QImage::Format_RGB32);
+        QColor color = QColor::fromHsv(k * 37 % 360, 200, 220);
+        for(int y=0; y<size; y++) {
+            QRgb *line = (QRgb *) image.scanLine(y);
+            for(int x=0; x<size; x++)
+                line[x] = QColor(color).darker(100 + (x + y) * 100 / (2 * size)).rgb();
+        }
+        list << image;
+    }
+    return list;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// render:
+//
+// Draws frames into an offscreen framebuffer with widget's context
+// current, timing each frame on the CPU up to glFinish and, when the
+// driver supports it, on the GPU. step() advances the animation.
+//
+static void render(QGLWidget *widget, const QString &name, int frames, const QSize &size,
+                   const std::function<void()> &init, const std::function<void()> &paint,
+                   const std::function<void(int)> &step) {
+    widget->makeCurrent();
+    QGLFramebufferObject fbo(size);
+    fbo.bind();
+    init();
+
+    benchResult cpu;
+    cpu.name     = name;
+    cpu.items    = 1;
+    cpu.timeouts = 0;
+    benchResult gpu = cpu;
+    gpu.name = name + "/gpu";
+
+    gpuTimer timer;
+    for(int f=0; f<frames; f++) {
+        step(f);
+
+        QElapsedTimer clock;
+        clock.start();
+        timer.begin();
+        paint();
+        timer.end();
+        glFinish();
+        cpu.ms << clock.nsecsElapsed() / 1e6;
+        if(timer.isValid())
+            gpu.ms << timer.elapsed();
+    }
+
+    fbo.release();
+    report.add(cpu);
+    if(timer.isValid())
+        report.add(gpu);
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// main:
+//
+// Renders the cover flow and the visualizer offscreen over a sweep of
+// album counts, visible covers, texture sizes and bar counts.
+//
+int main(int argc, char **argv) {
+    if(qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    if(qEnvironmentVariableIsEmpty("LIBGL_ALWAYS_SOFTWARE"))
+        qputenv("LIBGL_ALWAYS_SOFTWARE", "1");
+
+    QApplication app(argc, argv);
+    QCoreApplication::setApplicationName("qtunes-glbench");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Measures cover flow and visualizer frame times offscreen.");
+    parser.addHelpOption();
+    QCommandLineOption albumsOpt("albums",     "Album counts to load.", "list", "10,100,1000");
+    QCommandLineOption visibleOpt("visible",   "Visible cover counts.", "list", "6,10,20");
+    QCommandLineOption textureOpt("texture",   "Cover texture sizes.", "list", "128,256,512");
+    QCommandLineOption barsOpt("bars",         "Visualizer bar counts.", "list", "50,100,400");
+    QCommandLineOption framesOpt("frames",     "Frames per case.", "n", "120");
+    QCommandLineOption sizeOpt("size",         "Framebuffer size.", "WxH", "800x300");
+    QCommandLineOption labelOpt("label",       "Label stored with the results, e.g. a commit.", "text");
+    QCommandLineOption outOpt("out",           "Write JSON here instead of stdout.", "file");
+    QCommandLineOption baselineOpt("baseline", "Compare with an earlier JSON report.", "file");
+    parser.addOptions(QList<QCommandLineOption>() << albumsOpt << visibleOpt << textureOpt
+                      << barsOpt << framesOpt << sizeOpt << labelOpt << outOpt << baselineOpt);
+    parser.process(app);
+
+    int frames = qMax(1, parser.value(framesOpt).toInt());
+    QStringList wh = parser.value(sizeOpt).split('x');
+    QSize size(wh.value(0).toInt(), wh.value(1).toInt());
+    if(size.isEmpty())
+        size = QSize(800, 300);
+
+    // the widgets are never shown; they only provide their contexts
+    coverFlowProbe  flow;
+    visualizerProbe bars;
+    flow.makeCurrent();
+    if(!flow.isValid() || !bars.isValid() || !QGLFramebufferObject::hasOpenGLFramebufferObjects()) {
+        fprintf(stderr, "qtunes-glbench: no usable OpenGL context on %s\n",
+                qPrintable(QGuiApplication::platformName()));
+        return 1;
+    }
+    QString renderer = (const char *) glGetString(GL_RENDERER);
+    QString version  = (const char *) glGetString(GL_VERSION);
+    fprintf(stderr, "renderer %s, OpenGL %s\n", qPrintable(renderer), qPrintable(version));
+
+    // cover flow: one pass through the animation every 40 frames
+    QList<int> albumCounts = sizes(parser.value(albumsOpt));
+    QList<int> textures    = sizes(parser.value(textureOpt));
+    QList<int> visible     = sizes(parser.value(visibleOpt));
+    for(int a=0; a<albumCounts.size(); a++) {
+        for(int t=0; t<textures.size(); t++) {
+            qint64 bytes = (qint64) albumCounts[a] * textures[t] * textures[t] * 4;
+            if(bytes > TEXTURE_BUDGET) {
+                fprintf(stderr, "skipping %d covers of %d px: %lld MB of textures\n",
+                        albumCounts[a], textures[t], bytes >> 20);
+                continue;
+            }
+            flow.loadImages(covers(albumCounts[a], textures[t]));
+
+            for(int v=0; v<visible.size(); v++) {
+                flow.setVisibleCount(visible[v]);
+                QString name = QString("coverflow/albums=%1/visible=%2/texture=%3")
+                               .arg(albumCounts[a]).arg(visible[v]).arg(textures[t]);
+                render(&flow, name, frames, size,
+                       [&]() { flow.init(); flow.reshape(size.width(), size.height()); },
+                       [&]() { flow.paint(); },
+                       [&](int) {
+                    // s_animate only steps the state of a hidden widget
+                    flow.startAnimate(true);
+                    flow.s_animate();
+                });
+            }
+        }
+    }
+    flow.loadImages(QList<QImage>());
+
+    // visualizer: bars jump every JUMP_FRAMES frames and drop in between
+    QList<int> barCounts = sizes(parser.value(barsOpt));
+    for(int b=0; b<barCounts.size(); b++) {
+        bars.setBarCount(barCounts[b]);
+        render(&bars, QString("visualizer/bars=%1").arg(barCounts[b]), frames, size,
+               [&]() { bars.init(); bars.reshape(size.width(), size.height()); },
+               [&]() { bars.paint(); },
+               [&](int f) {
+            if(f % JUMP_FRAMES == 0)
+                QMetaObject::invokeMethod(&bars, "s_resetBarHeights", Qt::DirectConnection);
+        });
+    }
+
+    // report
+    report.setInfo("label",    parser.value(labelOpt));
+    report.setInfo("platform", QGuiApplication::platformName());
+    report.setInfo("renderer", renderer);
+    report.setInfo("gl",       version);
+    report.setInfo("frames",   frames);
+    report.setInfo("size",     QString("%1x%2").arg(size.width()).arg(size.height()));
+
+    QJsonObject baseline;
+    if(parser.isSet(baselineOpt) && !benchReport::readBaseline(parser.value(baselineOpt), &baseline))
+        fprintf(stderr, "qtunes-glbench: cannot read %s\n", qPrintable(parser.value(baselineOpt)));
+    fprintf(stderr, "\n%s", qPrintable(report.table(baseline)));
+
+    if(!report.write(parser.value(outOpt))) {
+        fprintf(stderr, "qtunes-glbench: cannot write %s\n", qPrintable(parser.value(outOpt)));
+        return 1;
+    }
+    return 0;
+}
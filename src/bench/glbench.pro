@@ -0,0 +1,20 @@
+######################################################################
+# Offscreen frame times of the cover flow and the visualizer; see
+# glBenchMain.cpp. Runs on Mesa's software rasterizer by default:
+#
+#   qmake glbench.pro && make
+#   ./glbench --albums 100 --texture 256 --out gl.json
+######################################################################
+QT += widgets
+QT += core gui opengl
+
+CONFIG += console
+CONFIG -= app_bundle
+TEMPLATE = app
+TARGET = glbench
+INCLUDEPATH += ..
+unix:!mac: LIBS += -lGLU
+
+# Input
+HEADERS += benchReport.h ../glWidget.h ../glvisualizer.h ../frameOverlay.h ../traceRecorder.h ../metricsRegistry.h
+SOURCES += glBenchMain.cpp benchReport.cpp ../glWidget.cpp ../glvisualizer.cpp ../frameOverlay.cpp ../traceRecorder.cpp ../metricsRegistry.cpp
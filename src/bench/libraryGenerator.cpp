@@ -0,0 +1,331 @@
+#include "libraryGenerator.h"
+#include <QImage>
+
+// bump when the stub layout changes so old libraries are rewritten
+const int GENERATOR_VERSION = 1;
+
+// name of the manifest in the library root
+static const char *MANIFEST = ".bench-library";
+
+// bytes of zero padding after the frames, as taggers leave
+const int TAG_PADDING = 512;
+
+// syllables for names; a few are not ASCII to exercise UTF-8 paths
+static const char *SYLLABLES[] = {
+    "ka", "lo", "mi", "ra", "ne", "so", "tu", "vi", "dan", "mor",
+    "el", "ix", "qua", "zen", "bel", "rho", "ta", "wen", "gor", "sil",
+    "s\xc3\xa9", "\xc3\xbcn", "\xc3\xb8r", "\xc3\xa5l"
+};
+const int SYLLABLE_COUNT = sizeof(SYLLABLES) / sizeof(SYLLABLES[0]);
+
+static const char *GENRES[] = {
+    "Rock", "Pop", "Jazz", "Blues", "Classical", "Country", "Electronic",
+    "Folk", "Hip-Hop", "Metal", "Punk", "Reggae", "Soul", "Funk", "Ambient",
+    "Techno", "House", "Latin", "Gospel", "Soundtrack", "Indie", "Disco",
+    "Grunge", "Trance"
+};
+const int GENRE_COUNT = sizeof(GENRES) / sizeof(GENRES[0]);
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// libraryGenerator::libraryGenerator:
+//
+// Constructor. Covers are 300 pixels on 80% of the albums by default.
+//
+libraryGenerator::libraryGenerator(quint32 seed)
+    : m_seed(seed ? seed : 1), m_state(m_seed), m_artSize(300), m_artRatio(0.8),
+      m_reused(false), m_files(0), m_bytes(0) {
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// libraryGenerator::next:
+//
+// xorshift32; the same on every platform and Qt version.
+//
+quint32 libraryGenerator::next() {
+    m_state ^= m_state << 13;
+    m_state ^= m_state >> 17;
+    m_state ^= m_state << 5;
+    return m_state;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// libraryGenerator::word:
+//
+// A capitalised word of two or three syllables.
+//
+QString libraryGenerator::word() {
+    QByteArray utf8;
+    int n = 2 + uniform(2);
+    for(int i=0; i<n; i++)
+        utf8 += SYLLABLES[uniform(SYLLABLE_COUNT)];
+
+    QString s = QString::fromUtf8(utf8);
+    s[0] = s[0].toUpper();
+    return s;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// libraryGenerator::words:
+//
+// Between min and max words separated by spaces.
+//
+QString libraryGenerator::words(int min, int max) {
+    QString s = word();
+    int n = min + uniform(max - min + 1);
+    for(int i=1; i<n; i++)
+        s += ' ' + word();
+    return s;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// libraryGenerator::manifest:
+//
+// Describes what generate() writes for these settings.
+//
+QByteArray libraryGenerator::manifest(int tracks) const {
+    return QString("version=%1 seed=%2 tracks=%3 art=%4 ratio=%5\n")
+           .arg(GENERATOR_VERSION).arg(m_seed).arg(tracks)
+           .arg(m_artSize).arg(m_artRatio).toUtf8();
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// libraryGenerator::generate:
+//
+// Writes the library. Albums hold 8 to 16 tracks; artists make one
+// to five albums in one genre; one album in ten is a compilation of
+// various artists.
+//
+bool libraryGenerator::generate(const QString &root, int tracks, QString *error) {
+    m_state  = m_seed;
+    m_reused = false;
+    m_files  = 0;
+    m_bytes  = 0;
+
+    QDir dir(root);
+    QFile stamp(dir.filePath(MANIFEST));
+    if(stamp.open(QIODevice::ReadOnly) && stamp.readAll() == manifest(tracks)) {
+        m_reused = true;
+        m_files  = tracks;
+        return true;
+    }
+    stamp.close();
+
+    // start from an empty root so stale files don't skew the scan, but
+    // never clear a folder this class did not write
+    bool empty = dir.entryList(QDir::AllEntries | QDir::NoDotAndDotDot | QDir::Hidden).isEmpty();
+    if(dir.exists() && !empty && !stamp.exists()) {
+        *error = QString("%1 is not empty and not a generated library").arg(root);
+        return false;
+    }
+    if(dir.exists() && !empty && !dir.removeRecursively()) {
+        *error = QString("cannot clear %1").arg(root);
+        return false;
+    }
+    if(!QDir().mkpath(root)) {
+        *error = QString("cannot create %1").arg(root);
+        return false;
+    }
+
+    while(m_files < tracks) {
+        QString artist = words(1, 3);
+        QString genre  = GENRES[uniform(GENRE_COUNT)];
+        int     albums = 1 + uniform(5);
+
+        for(int a=0; a<albums && m_files<tracks; a++) {
+            QString album  = words(1, 4);
+            int     layout = uniform(10);
+            bool    various = layout == 9;
+            int     count  = qMin(8 + uniform(9), tracks - m_files);
+
+            QString folder;
+            if(layout < 6)      folder = artist + '/' + album;
+            else if(layout < 8) folder = genre + '/' + artist + '/' + album;
+            else if(layout < 9) folder = artist + " - " + album;
+            else                folder = "Compilations/" + album;
+            QString path = dir.filePath(folder);
+            if(!QDir().mkpath(path)) {
+                *error = QString("cannot create %1").arg(path);
+                return false;
+            }
+
+            QByteArray art;
+            if(uniform(1000) < m_artRatio * 1000)
+                art = pictureFrame(cover(next()));
+
+            for(int t=1; t<=count; t++) {
+                QString title = words(1, 4);
+                QByteArray frames;
+                frames += textFrame("TIT2", title);
+                frames += textFrame("TPE1", various ? words(1, 3) : artist);
+                if(various)
+                    frames += textFrame("TPE2", "Various Artists");
+                frames += textFrame("TALB", album);
+                frames += textFrame("TCON", genre);
+                frames += textFrame("TRCK", QString("%1/%2").arg(t).arg(count));
+                frames += art;
+
+                // random names can meet; keep every track
+                QString file = QString("%1/%2 %3.mp3").arg(path)
+                               .arg(t, 2, 10, QChar('0')).arg(title);
+                for(int n=2; QFile::exists(file); n++)
+                    file = QString("%1/%2 %3 (%4).mp3").arg(path)
+                           .arg(t, 2, 10, QChar('0')).arg(title).arg(n);
+                if(!writeTrack(file, frames, 90 + uniform(510))) {
+                    *error = QString("cannot write %1").arg(file);
+                    return false;
+                }
+            }
+        }
+    }
+
+    if(!stamp.open(QIODevice::WriteOnly) || stamp.write(manifest(tracks)) < 0) {
+        *error = QString("cannot write %1").arg(stamp.fileName());
+        return false;
+    }
+    return true;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// libraryGenerator::cover:
+//
+// A JPEG cover: a diagonal gradient between two colours from hue.
+//
+QByteArray libraryGenerator::cover(quint32 hue) {
+    QColor from = QColor::fromHsv(hue % 360, 200, 230);
+    QColor to   = QColor::fromHsv((hue / 360) % 360, 160, 80);
+
+    int size = m_artSize;
+    QImage image(size, size, QImage::Format_RGB32);
+    for(int y=0; y<size; y++) {
+        QRgb *line = (QRgb *) image.scanLine(y);
+        for(int x=0; x<size; x++) {
+            int t = (x + y) * 255 / qMax(1, 2 * size - 2);
+            line[x] = qRgb((from.red()   * (255-t) + to.red()   * t) / 255,
+                           (from.green() * (255-t) + to.green() * t) / 255,
+                           (from.blue()  * (255-t) + to.blue()  * t) / 255);
+        }
+    }
+
+    QByteArray jpeg;
+    QBuffer buffer(&jpeg);
+    buffer.open(QIODevice::WriteOnly);
+    image.save(&buffer, "JPEG", 85);
+    return jpeg;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// syncsafe:
+//
+// Writes n as an ID3v2.4 syncsafe integer.
+//
+static void syncsafe(char *out, int n) {
+    out[0] = (n >> 21) & 0x7F;
+    out[1] = (n >> 14) & 0x7F;
+    out[2] = (n >>  7) & 0x7F;
+    out[3] =  n        & 0x7F;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// frame:
+//
+// An ID3v2.4 frame with the given body.
+//
+static QByteArray frame(const char *id, const QByteArray &body) {
+    char header[10] = {0};
+    memcpy(header, id, 4);
+    syncsafe(header + 4, body.size());
+    return QByteArray(header, 10) + body;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// libraryGenerator::textFrame:
+//
+// A UTF-8 text frame.
+//
+QByteArray libraryGenerator::textFrame(const char *id, const QString &text) const {
+    return frame(id, '\x03' + text.toUtf8());
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// libraryGenerator::pictureFrame:
+//
+// An APIC front cover.
+//
+QByteArray libraryGenerator::pictureFrame(const QByteArray &jpeg) const {
+    QByteArray body;
+    body += '\x00';                         // Latin-1 description
+    body += QByteArray("image/jpeg", 11);   // with its terminator
+    body += '\x03';                         // front cover
+    body += '\x00';                         // empty description
+    body += jpeg;
+    return frame("APIC", body);
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// libraryGenerator::mpegFrame:
+//
+// One MPEG-1 Layer III frame (128 kbps, 44.1 kHz, joint stereo) whose
+// Info header counts the frames of a track of the given length.
+//
+QByteArray libraryGenerator::mpegFrame(int seconds) const {
+    QByteArray f(417, '\0');
+    f[0] = '\xFF'; f[1] = '\xFB'; f[2] = '\x90'; f[3] = '\x64';
+
+    quint32 frames = (seconds * 44100 + 1151) / 1152;
+    memcpy(f.data() + 36, "Info", 4);
+    f[43] = 1;                              // frame count present
+    f[44] = (frames >> 24) & 0xFF;
+    f[45] = (frames >> 16) & 0xFF;
+    f[46] = (frames >>  8) & 0xFF;
+    f[47] =  frames        & 0xFF;
+    return f;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// libraryGenerator::writeTrack:
+//
+// Writes tag header, frames, padding and the MPEG frame.
+//
+bool libraryGenerator::writeTrack(const QString &path, const QByteArray &frames, int seconds) {
+    char header[10] = {'I', 'D', '3', 4, 0, 0};
+    syncsafe(header + 6, frames.size() + TAG_PADDING);
+
+    QByteArray data;
+    data.reserve(10 + frames.size() + TAG_PADDING + 417);
+    data += QByteArray(header, 10);
+    data += frames;
+    data += QByteArray(TAG_PADDING, '\0');
+    data += mpegFrame(seconds);
+
+    QFile file(path);
+    if(!file.open(QIODevice::WriteOnly) || file.write(data) != data.size())
+        return false;
+
+    m_files++;
+    m_bytes += data.size();
+    return true;
+}
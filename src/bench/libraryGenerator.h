@@ -0,0 +1,63 @@
+#ifndef LIBRARYGENERATOR_H
+#define LIBRARYGENERATOR_H
+
+#include <QtCore>
+
+///////////////////////////////////////////////////////////////////////////////
+///
+/// \class libraryGenerator
+/// \brief Writes a synthetic music library of MP3 stubs for benchmarks.
+///
+/// Each stub is an ID3v2.4 tag (title, artist, album artist on
+/// compilations, album, genre, track, and on most albums a JPEG cover)
+/// followed by one MPEG frame whose Info header gives the duration;
+/// there is no audio. Folders mix depths like real libraries:
+///
+///     Artist/Album/, Genre/Artist/Album/, Artist - Album/,
+///     Compilations/Album/
+///
+/// Output depends only on the seed and the settings, so libraries made
+/// on different commits are identical. A manifest in the root lets a
+/// matching library be reused instead of written again.
+///
+///////////////////////////////////////////////////////////////////////////////
+
+class libraryGenerator
+{
+public:
+    libraryGenerator(quint32 seed = 1);
+
+    void        setArtSize(int px)          { m_artSize  = px; }
+    void        setArtRatio(double ratio)   { m_artRatio = ratio; }
+
+    // writes tracks files under root unless the manifest already matches
+    bool        generate(const QString &root, int tracks, QString *error);
+
+    bool        reused() const              { return m_reused; }
+    int         files() const               { return m_files; }
+    qint64      bytesWritten() const        { return m_bytes; }
+
+private:
+    quint32     next();
+    int         uniform(int n)              { return next() % n; }
+    QString     word();
+    QString     words(int min, int max);
+
+    QByteArray  manifest(int tracks) const;
+    QByteArray  cover(quint32 hue);
+    QByteArray  textFrame(const char *id, const QString &text) const;
+    QByteArray  pictureFrame(const QByteArray &jpeg) const;
+    QByteArray  mpegFrame(int seconds) const;
+    bool        writeTrack(const QString &path, const QByteArray &frames, int seconds);
+
+    quint32     m_seed;
+    quint32     m_state;
+    int         m_artSize;
+    double      m_artRatio;
+
+    bool        m_reused;
+    int         m_files;
+    qint64      m_bytes;
+};
+
+#endif // LIBRARYGENERATOR_H
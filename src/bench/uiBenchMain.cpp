@@ -0,0 +1,336 @@
+#include <QtWidgets>
+#include <QtTest>
+#include <QGLWidget>
+#include <functional>
+#include "MainWindow.h"
+#include "libraryGenerator.h"
+#include "benchReport.h"
+
+// quiet time after which the window counts as settled
+const int SETTLE_MS = 100;
+
+// longest wait for a settled window
+const int SETTLE_MAX_MS = 10000;
+
+// search typed by the search benchmarks
+static const char *SEARCH_TEXT = "mor";
+
+///////////////////////////////////////////////////////////////////////////////
+///
+/// \class benchApplication
+/// \brief QApplication that notes when widget paints finish.
+///
+/// A frame is finished when a widget's UpdateRequest or Paint event
+/// returns; the backing store has been painted by then. Paints of
+/// child widgets nest inside their window's, so the last one noted
+/// after the event loop returns ends the frame.
+///
+///////////////////////////////////////////////////////////////////////////////
+
+class benchApplication : public QApplication
+{
+public:
+    benchApplication(int &argc, char **argv)
+        : QApplication(argc, argv), m_frames(0), m_lastFrame(0) {
+        m_clock.start();
+    }
+
+    bool notify(QObject *receiver, QEvent *event) {
+        bool done = QApplication::notify(receiver, event);
+        QEvent::Type type = event->type();
+        if(receiver->isWidgetType() && (type == QEvent::UpdateRequest || type == QEvent::Paint)) {
+            m_frames++;
+            m_lastFrame = m_clock.nsecsElapsed();
+        }
+        return done;
+    }
+
+    qint64  now() const     { return m_clock.nsecsElapsed(); }
+    qint64  frames() const  { return m_frames; }
+
+    // ms from start until the first frame after frames was read, or
+    // -1 if none finished within timeout ms
+    double  waitForFrame(qint64 start, qint64 frames, int timeout) {
+        while(m_frames == frames) {
+            if(now() - start > timeout * Q_INT64_C(1000000)) return -1;
+            processEvents(QEventLoop::AllEvents | QEventLoop::WaitForMoreEvents, 10);
+        }
+        processEvents();
+        return (m_lastFrame - start) / 1e6;
+    }
+
+    // runs the event loop until nothing has painted for SETTLE_MS
+    void    settle() {
+        qint64 start = now();
+        qint64 quiet = now();
+        qint64 frames = m_frames;
+        while(now() - quiet < SETTLE_MS * Q_INT64_C(1000000) &&
+              now() - start < SETTLE_MAX_MS * Q_INT64_C(1000000)) {
+            processEvents(QEventLoop::AllEvents, 10);
+            QThread::msleep(1);
+            if(m_frames != frames) {
+                frames = m_frames;
+                quiet  = now();
+            }
+        }
+    }
+
+private:
+    QElapsedTimer   m_clock;
+    qint64          m_frames;
+    qint64          m_lastFrame;
+};
+
+static benchApplication *app;
+static int timeoutMs;
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// interact:
+//
+// Times one interaction: prepare() runs untimed on a settled window,
+// act() injects the input, and the time to the next finished frame is
+// added to r.
+//
+static void interact(benchResult *r, const std::function<void()> &prepare,
+                     const std::function<void()> &act) {
+    if(prepare) prepare();
+    app->settle();
+
+    qint64 frames = app->frames();
+    qint64 start  = app->now();
+    act();
+    double ms = app->waitForFrame(start, frames, timeoutMs);
+    if(ms < 0) r->timeouts++;
+    else       r->ms << ms;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// clickItem:
+//
+// Clicks row of a list widget, scrolling it into view first.
+//
+static void clickItem(QListWidget *list, int row) {
+    QListWidgetItem *item = list->item(row);
+    if(!item) return;
+    list->scrollToItem(item);
+    QTest::mouseClick(list->viewport(), Qt::LeftButton, 0,
+                      list->visualItemRect(item).center());
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// pickRow:
+//
+// The i-th pick among the rows of a list after "ALL", spread out so
+// that consecutive picks are far apart.
+//
+static int pickRow(QListWidget *list, int i) {
+    int n = list->count() - 1;
+    return n > 0 ? 1 + (qint64) i * 7919 % n : 0;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// search:
+//
+// Picks a search field as the combo box does when one is chosen.
+//
+static void search(QComboBox *field, int index) {
+    field->setCurrentIndex(index);
+    QMetaObject::invokeMethod(field, "activated", Qt::DirectConnection, Q_ARG(int, index));
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// newResult:
+//
+// An empty result for one kind of interaction.
+//
+static benchResult newResult(const QString &name) {
+    benchResult r;
+    r.name     = name;
+    r.items    = 1;
+    r.timeouts = 0;
+    return r;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// main:
+//
+// Starts the player offscreen on a generated library, drives scripted
+// interactions and reports the time from each input to its frame.
+//
+int main(int argc, char **argv) {
+    if(qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+
+    // keep the player's saved folder away from the user's settings
+    QTemporaryDir config;
+    qputenv("XDG_CONFIG_HOME", QFile::encodeName(config.path()));
+
+    benchApplication application(argc, argv);
+    app = &application;
+    QCoreApplication::setApplicationName("qtunes-uibench");
+    QSettings::setPath(QSettings::NativeFormat, QSettings::UserScope, config.path());
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Measures input-to-frame latency of the qtunes window.");
+    parser.addHelpOption();
+    QCommandLineOption tracksOpt("tracks",     "Tracks in the library.", "n", "10000");
+    QCommandLineOption libraryOpt("library",   "Library folder; reused if it matches.", "path");
+    QCommandLineOption seedOpt("seed",         "Generator seed.", "n", "1");
+    QCommandLineOption runsOpt("runs",         "Folder loads to time.", "n", "3");
+    QCommandLineOption itersOpt("iterations",  "Repeats of every other interaction.", "n", "20");
+    QCommandLineOption timeoutOpt("timeout",   "Longest wait for a frame in ms.", "ms", "5000");
+    QCommandLineOption labelOpt("label",       "Label stored with the results, e.g. a commit.", "text");
+    QCommandLineOption outOpt("out",           "Write JSON here instead of stdout.", "file");
+    QCommandLineOption baselineOpt("baseline", "Compare with an earlier JSON report.", "file");
+    parser.addOptions(QList<QCommandLineOption>() << tracksOpt << libraryOpt << seedOpt
+                      << runsOpt << itersOpt << timeoutOpt << labelOpt << outOpt << baselineOpt);
+    parser.process(application);
+
+    int tracks = qMax(1, parser.value(tracksOpt).toInt());
+    int runs   = qMax(1, parser.value(runsOpt).toInt());
+    int iters  = qMax(1, parser.value(itersOpt).toInt());
+    timeoutMs  = qMax(1, parser.value(timeoutOpt).toInt());
+    QString root = parser.isSet(libraryOpt) ? parser.value(libraryOpt)
+                 : QDir::temp().filePath(QString("qtunes-bench-%1").arg(tracks));
+
+    libraryGenerator generator(parser.value(seedOpt).toUInt());
+    QString error;
+    if(!generator.generate(root, tracks, &error)) {
+        fprintf(stderr, "qtunes-uibench: %s\n", qPrintable(error));
+        return 1;
+    }
+
+    // a fixed size so that layouts match between runs
+    MainWindow window(argv[0]);
+    window.resize(1280, 800);
+    window.show();
+    if(!QTest::qWaitForWindowExposed(&window)) {
+        fprintf(stderr, "qtunes-uibench: window not exposed on %s\n",
+                qPrintable(QGuiApplication::platformName()));
+        return 1;
+    }
+
+    QListWidget  *genres  = window.findChild<QListWidget  *>("genrePanel");
+    QListWidget  *artists = window.findChild<QListWidget  *>("artistPanel");
+    QListWidget  *albums  = window.findChild<QListWidget  *>("albumPanel");
+    QTableWidget *table   = window.findChild<QTableWidget *>("songTable");
+    QLineEdit    *text    = window.findChild<QLineEdit    *>("searchText");
+    QComboBox    *field   = window.findChild<QComboBox    *>("searchField");
+    QToolButton  *next    = window.findChild<QToolButton  *>("nextCover");
+    QGLWidget    *flow    = window.findChild<QGLWidget    *>("coverFlow");
+    if(!genres || !artists || !albums || !table || !text || !field || !next) {
+        fprintf(stderr, "qtunes-uibench: widgets not found\n");
+        return 1;
+    }
+
+    benchReport report("uibench");
+
+    // every interaction starts from the whole library
+    auto reset = [&]() {
+        text->clear();
+        search(field, 0);
+    };
+
+    // the folder is scanned in the background, so a load ends with the
+    // first frame after the library is shown
+    benchResult load = newResult("load folder");
+    for(int i=0; i<runs; i++) {
+        QSignalSpy shown(&window, SIGNAL(libraryShown()));
+        app->settle();
+        qint64 start = app->now();
+        window.loadLibrary(root);
+        double ms = shown.wait(timeoutMs) ? app->waitForFrame(start, app->frames(), timeoutMs) : -1;
+        if(ms < 0) load.timeouts++;
+        else       load.ms << ms;
+    }
+    report.add(load);
+
+    benchResult genre = newResult("click genre");
+    for(int i=0; i<iters; i++)
+        interact(&genre, reset, [&]() { clickItem(genres, pickRow(genres, i)); });
+    report.add(genre);
+
+    benchResult artist = newResult("click artist");
+    for(int i=0; i<iters; i++)
+        interact(&artist, [&]() { reset(); clickItem(genres, pickRow(genres, i)); },
+                 [&]() { clickItem(artists, pickRow(artists, i)); });
+    report.add(artist);
+
+    benchResult album = newResult("click album");
+    for(int i=0; i<iters; i++)
+        interact(&album, [&]() { reset(); clickItem(artists, pickRow(artists, i)); },
+                 [&]() { clickItem(albums, pickRow(albums, i)); });
+    report.add(album);
+
+    benchResult type = newResult("type search key");
+    for(int i=0; i<iters; i++) {
+        char key = SEARCH_TEXT[i % strlen(SEARCH_TEXT)];
+        interact(&type, [&]() { if(i % strlen(SEARCH_TEXT) == 0) reset(); text->setFocus(); },
+                 [&]() { QTest::keyClick(text, key); });
+    }
+    report.add(type);
+
+    benchResult find = newResult("run search");
+    for(int i=0; i<iters; i++)
+        interact(&find, [&]() { reset(); text->setText(SEARCH_TEXT); },
+                 [&]() { search(field, 1 + i % 3); });
+    report.add(find);
+
+    benchResult sort = newResult("sort column");
+    for(int i=0; i<iters; i++) {
+        QHeaderView *header = table->horizontalHeader();
+        int column = i % table->columnCount();
+        QPoint at(header->sectionViewportPosition(column) + header->sectionSize(column) / 2,
+                  header->height() / 2);
+        interact(&sort, reset, [&]() { QTest::mouseDClick(header->viewport(), Qt::LeftButton, 0, at); });
+    }
+    report.add(sort);
+
+    benchResult play = newResult("play row");
+    for(int i=0; i<iters; i++) {
+        int row = table->rowCount() ? (qint64) i * 7919 % table->rowCount() : 0;
+        interact(&play, [&]() { reset(); table->scrollToItem(table->item(row, 0)); },
+                 [&]() {
+            QRect rect = table->visualItemRect(table->item(row, 0));
+            QTest::mouseDClick(table->viewport(), Qt::LeftButton, 0, rect.center());
+        });
+    }
+    report.add(play);
+
+    // cover flow needs a GL context, which not every offscreen setup has
+    if(flow && flow->isValid()) {
+        benchResult cover = newResult("cover flow next");
+        for(int i=0; i<iters; i++)
+            interact(&cover, NULL, [&]() { QTest::mouseClick(next, Qt::LeftButton); });
+        report.add(cover);
+    }
+    else
+        fprintf(stderr, "qtunes-uibench: no GL context, cover flow skipped\n");
+
+    // report
+    report.setInfo("label",    parser.value(labelOpt));
+    report.setInfo("platform", QGuiApplication::platformName());
+    report.setInfo("tracks",   tracks);
+    report.setInfo("library",  root);
+
+    QJsonObject baseline;
+    if(parser.isSet(baselineOpt) && !benchReport::readBaseline(parser.value(baselineOpt), &baseline))
+        fprintf(stderr, "qtunes-uibench: cannot read %s\n", qPrintable(parser.value(baselineOpt)));
+    fprintf(stderr, "\n%s", qPrintable(report.table(baseline)));
+
+    if(!report.write(parser.value(outOpt))) {
+        fprintf(stderr, "qtunes-uibench: cannot write %s\n", qPrintable(parser.value(outOpt)));
+        return 1;
+    }
+    return 0;
+}
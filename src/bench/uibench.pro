@@ -0,0 +1,34 @@
+######################################################################
+# Input-to-frame latency of the player window, run offscreen; see
+# uiBenchMain.cpp.
+#
+#   qmake uibench.pro && make
+#   ./uibench --tracks 20000 --baseline before.json
+######################################################################
+QT += widgets
+QT += multimedia
+QT += core gui opengl
+QT += concurrent
+QT += testlib
+
+CONFIG += console
+CONFIG -= app_bundle
+TEMPLATE = app
+TARGET = uibench
+INCLUDEPATH += .. -I /opt/local/include/taglib
+LIBS += -L/opt/local/lib
+LIBS += -ltag
+
+# Input: the player without its main()
+HEADERS += libraryGenerator.h benchReport.h \
+           ../MainWindow.h ../glWidget.h ../glvisualizer.h ../frameOverlay.h ../openPrompt.h \
+           ../waveformCache.h ../waveformSlider.h \
+           ../playbackStats.h ../statsPanel.h ../memoryPanel.h ../playQueue.h ../sessionState.h ../playlistIO.h \
+           ../id3Reader.h ../scanArena.h ../trackStore.h ../libraryScanner.h ../libraryIndex.h ../coverArt.h ../allocStats.h ../memoryReport.h \
+           ../trackSorter.h ../trackBitmap.h ../queryEngine.h ../resultCache.h ../traceRecorder.h ../metricsRegistry.h
+SOURCES += uiBenchMain.cpp libraryGenerator.cpp benchReport.cpp \
+           ../MainWindow.cpp ../glWidget.cpp ../glvisualizer.cpp ../frameOverlay.cpp ../openPrompt.cpp \
+           ../waveformCache.cpp ../waveformSlider.cpp \
+           ../playbackStats.cpp ../statsPanel.cpp ../memoryPanel.cpp ../playQueue.cpp ../sessionState.cpp ../playlistIO.cpp \
+           ../id3Reader.cpp ../scanArena.cpp ../trackStore.cpp ../libraryScanner.cpp ../libraryIndex.cpp ../coverArt.cpp ../allocStats.cpp ../memoryReport.cpp \
+           ../trackSorter.cpp ../trackBitmap.cpp ../queryEngine.cpp ../resultCache.cpp ../traceRecorder.cpp ../metricsRegistry.cpp
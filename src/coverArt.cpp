@@ -0,0 +1,106 @@
+#include "coverArt.h"
+#include "trackStore.h"
+#include "traceRecorder.h"
+
+#include <mpegfile.h>
+#include <id3v2tag.h>
+#include <id3v2frame.h>
+#include <attachedPictureFrame.h>
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// coverArt::read:
+//
+// Decodes the cover of a track into image, scaled to fit in box.
+// The recorded byte range is memory-mapped and decoded in place, with
+// the scaling done by the decoder; tags are only parsed when the range
+// is unknown. Returns false if the track has no cover.
+//
+bool coverArt::read(const trackStore &library, int track, const QSize &box, QImage *image) {
+    TRACE_SCOPE("coverArt::read", "art");
+    TRACE_DETAIL(library.path(track));
+
+    // no picture in the file
+    qint64 size = library.artSize(track);
+    if(!size) return false;
+
+    qint64 offset = library.artOffset(track);
+    if(offset >= 0) {
+        QFile file(library.path(track));
+        uchar *data = file.open(QIODevice::ReadOnly) ? file.map(offset, size) : NULL;
+        if(data) {
+            // wraps the mapping without copying it
+            QByteArray bytes = QByteArray::fromRawData((const char *) data, size);
+            QBuffer buffer(&bytes);
+            buffer.open(QIODevice::ReadOnly);
+
+            bool ok = decode(&buffer, library.artMime(track), box, image);
+            file.unmap(data);
+            if(ok) return true;
+        }
+    }
+
+    // fall back to parsing the tag
+    QByteArray ba_temp = library.path(track).toLocal8Bit();
+    TagLib::MPEG::File audioFile(ba_temp.data());
+    *image = fromTag(audioFile.ID3v2Tag(true)).scaled(box, Qt::KeepAspectRatio,
+                                                      Qt::SmoothTransformation);
+    return !image->isNull();
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// coverArt::decode:
+//
+// Decodes an encoded picture from device. Large pictures are scaled
+// during decode (JPEG uses DCT scaling), and image is reused if it
+// already has the right size and format.
+//
+bool coverArt::decode(QIODevice *device, const QString &mime, const QSize &box,
+                      QImage *image) {
+    QImageReader reader(device, mime.section('/', 1).toLower().toLatin1());
+    reader.setDecideFormatFromContent(true);
+
+    QSize size = reader.size();
+    if(size.isValid() && (size.width() > box.width() || size.height() > box.height()))
+        reader.setScaledSize(size.scaled(box, Qt::KeepAspectRatio));
+
+    return reader.read(image);
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// coverArt::fromTag:
+//
+// Returns the first attached picture of tag, or the default cover.
+//
+QImage coverArt::fromTag(TagLib::ID3v2::Tag *tag) {
+    TRACE_SCOPE("coverArt::fromTag", "art");
+    // looks for picture frames only
+    TagLib::ID3v2::FrameList tag_list = tag->frameList("APIC");
+    QImage tag_image;
+
+    // if picture frames do not exists, a default image is used for the album cover image
+    // else the first frame's data is coverted to a qimage
+    if(tag_list.isEmpty())
+        tag_image = defaultCover();
+    else {
+        TagLib::ID3v2::AttachedPictureFrame *tag_frame = static_cast<TagLib::ID3v2::AttachedPictureFrame *>(tag_list.front());
+        tag_image.loadFromData((const uchar *) tag_frame->picture().data(), tag_frame->picture().size());
+    }
+    return tag_image;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// coverArt::defaultCover:
+//
+// Returns the image used for songs without a cover.
+//
+QImage coverArt::defaultCover() {
+    QString path = QDir::currentPath();
+    path.append("musicnote.png");
+    return QImage(path);
+}
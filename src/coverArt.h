@@ -0,0 +1,39 @@
+#ifndef COVERART_H
+#define COVERART_H
+
+#include <QtGui>
+
+class trackStore;
+namespace TagLib { namespace ID3v2 { class Tag; } }
+
+///////////////////////////////////////////////////////////////////////////////
+///
+/// \class coverArt
+/// \brief Decodes the cover pictures of library tracks.
+///
+/// Pictures are read from the byte range the scanner recorded and
+/// decoded at the size they are shown at; the tags are only parsed
+/// when that range is unknown. Only reads its arguments, so it is safe
+/// off the GUI thread, and is shared by the player and the benchmarks.
+///
+///////////////////////////////////////////////////////////////////////////////
+
+class coverArt
+{
+public:
+    // decodes the cover of track into image, scaled to fit in box;
+    // false if the track has none
+    static bool     read(const trackStore &store, int track, const QSize &box, QImage *image);
+
+    // decodes an encoded picture of type mime from device
+    static bool     decode(QIODevice *device, const QString &mime, const QSize &box,
+                           QImage *image);
+
+    // first picture of an ID3v2 tag, or the default cover
+    static QImage   fromTag(TagLib::ID3v2::Tag *tag);
+
+    // the image used for songs without a cover
+    static QImage   defaultCover();
+};
+
+#endif // COVERART_H
@@ -0,0 +1,221 @@
+#include "frameOverlay.h"
+#include <QtOpenGL>
+
+// frames kept for the graph
+const int HISTORY = 120;
+
+// a longer pause between frames starts a new burst, e.g. the next
+// cover flow animation, and is neither graphed nor counted as drops
+const double IDLE_GAP_MS = 250;
+
+// text refresh interval
+const qint64 TEXT_NS = 250 * 1000 * 1000;
+
+// graph size in pixels and the frame time at its top, in targets
+const int   GRAPH_W = 2 * HISTORY;
+const int   GRAPH_H = 48;
+const float GRAPH_TOP = 3.0f;
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// frameOverlay::frameOverlay:
+//
+// Constructor. The overlay starts hidden.
+//
+frameOverlay::frameOverlay(QGLWidget *widget)
+    : m_widget(widget), m_visible(false), m_animation(0), m_textureBytes(0),
+      m_frameStart(-1), m_lastFrame(-1), m_target(1000.0 / 60),
+      m_head(0), m_count(0), m_frames(0), m_dropped(0), m_textTime(0) {
+    m_intervals.fill(0, HISTORY);
+    m_work.fill(0, HISTORY);
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// frameOverlay::setVisible:
+//
+// Shows or hides the overlay. Showing it starts a fresh measurement.
+//
+void frameOverlay::setVisible(bool on) {
+    if(on == m_visible) return;
+    m_visible = on;
+
+    if(on) {
+        m_clock.start();
+        m_frameStart = m_lastFrame = -1;
+        m_head = m_count = 0;
+        m_frames = m_dropped = 0;
+        m_textTime = 0;
+        m_target = qMax(refreshInterval(), (double) m_animation);
+    }
+    m_widget->update();
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// frameOverlay::refreshInterval:
+//
+// ms per refresh of the screen the widget is on.
+//
+double frameOverlay::refreshInterval() const {
+    QWindow *window = m_widget->window()->windowHandle();
+    QScreen *screen = window ? window->screen() : QGuiApplication::primaryScreen();
+    double hz = screen ? screen->refreshRate() : 0;
+    return hz > 1 ? 1000.0 / hz : 1000.0 / 60;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// frameOverlay::beginFrame:
+//
+// Notes the start of a frame and records the interval since the
+// previous one. An interval spanning k targets dropped k-1 frames.
+//
+void frameOverlay::beginFrame() {
+    if(!m_visible) return;
+
+    qint64 now = m_clock.nsecsElapsed();
+    m_frameStart = now;
+    m_intervals[m_head] = 0;
+    if(m_lastFrame >= 0) {
+        double ms = (now - m_lastFrame) / 1e6;
+        if(ms < IDLE_GAP_MS) {
+            m_intervals[m_head] = ms;
+            m_frames++;
+            int missed = qRound(ms / m_target) - 1;
+            if(missed > 0)
+                m_dropped += missed;
+        }
+    }
+    m_lastFrame = now;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// frameOverlay::endFrame:
+//
+// Records the time the widget spent on its own drawing.
+//
+void frameOverlay::endFrame() {
+    if(!m_visible || m_frameStart < 0) return;
+
+    m_work[m_head] = (m_clock.nsecsElapsed() - m_frameStart) / 1e6;
+    m_head = (m_head + 1) % HISTORY;
+    m_count = qMin(m_count + 1, HISTORY);
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// frameOverlay::updateText:
+//
+// Formats the averages of the history.
+//
+void frameOverlay::updateText(qint64 now) {
+    m_textTime = now;
+
+    double interval = 0, work = 0, worst = 0;
+    int n = 0;
+    for(int i=0; i<m_count; i++) {
+        if(m_intervals[i] > 0) {
+            interval += m_intervals[i];
+            worst = qMax(worst, (double) m_intervals[i]);
+            n++;
+        }
+        work += m_work[i];
+    }
+    interval = n ? interval / n : 0;
+    work = m_count ? work / m_count : 0;
+
+    m_text[0] = QString("%1 ms  %2 fps  work %3 ms  worst %4 ms")
+            .arg(interval, 0, 'f', 1).arg(interval > 0 ? 1000 / interval : 0, 0, 'f', 0)
+            .arg(work, 0, 'f', 1).arg(worst, 0, 'f', 1);
+    m_text[1] = QString("dropped %1 of %2 at %3 ms  textures %4 MB")
+            .arg(m_dropped).arg(m_frames + m_dropped).arg(m_target, 0, 'f', 1)
+            .arg(m_textureBytes / 1048576.0, 0, 'f', 1);
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// frameOverlay::draw:
+//
+// Draws the graph and text in the top left corner in window
+// coordinates. Frame intervals are white, drawing time is yellow, and
+// the green and red lines mark one and two targets. GL state is
+// restored afterwards.
+//
+void frameOverlay::draw() {
+    if(!m_visible) return;
+
+    qint64 now = m_clock.nsecsElapsed();
+    if(m_text[0].isEmpty() || now - m_textTime > TEXT_NS)
+        updateText(now);
+
+    glMatrixMode(GL_PROJECTION);
+    glPushMatrix();
+    glLoadIdentity();
+    glOrtho(0, m_widget->width(), m_widget->height(), 0, -1, 1);
+    glMatrixMode(GL_MODELVIEW);
+    glPushMatrix();
+    glLoadIdentity();
+
+    glPushAttrib(GL_ENABLE_BIT | GL_CURRENT_BIT | GL_POLYGON_BIT |
+                 GL_COLOR_BUFFER_BIT | GL_LINE_BIT);
+    glDisable(GL_TEXTURE_2D);
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_LINE_SMOOTH);
+    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    // backdrop for graph and two lines of text
+    const int x0 = 4, y0 = 4, bottom = y0 + GRAPH_H;
+    glColor4f(0, 0, 0, 0.6f);
+    glRectf(x0, y0, x0 + GRAPH_W, bottom + 30);
+
+    // one and two targets
+    float scale = GRAPH_H / (GRAPH_TOP * m_target);
+    glBegin(GL_LINES);
+    glColor4f(0, 0.8f, 0, 0.8f);
+    glVertex2f(x0, bottom - m_target * scale);
+    glVertex2f(x0 + GRAPH_W, bottom - m_target * scale);
+    glColor4f(0.9f, 0, 0, 0.8f);
+    glVertex2f(x0, bottom - 2 * m_target * scale);
+    glVertex2f(x0 + GRAPH_W, bottom - 2 * m_target * scale);
+    glEnd();
+
+    // oldest frame on the left
+    const QVector<float> *series[2] = { &m_intervals, &m_work };
+    for(int s=0; s<2; s++) {
+        if(s == 0) glColor3f(1, 1, 1);
+        else       glColor3f(1, 0.85f, 0);
+
+        glBegin(GL_LINE_STRIP);
+        for(int i=0; i<m_count; i++) {
+            int k = (m_head - m_count + i + HISTORY) % HISTORY;
+            float y = qMin((*series[s])[k] * scale, (float) GRAPH_H);
+            glVertex2f(x0 + 2 * (HISTORY - m_count + i), bottom - y);
+        }
+        glEnd();
+    }
+
+    glPopAttrib();
+    glMatrixMode(GL_PROJECTION);
+    glPopMatrix();
+    glMatrixMode(GL_MODELVIEW);
+    glPopMatrix();
+
+    // text last; renderText keeps the GL state it finds, and draws in
+    // the current colour, which is put back afterwards
+    QFont font("Monospace", 8);
+    font.setStyleHint(QFont::TypeWriter);
+    glPushAttrib(GL_CURRENT_BIT);
+    glColor3f(1, 1, 1);
+    m_widget->renderText(x0 + 4, bottom + 13, m_text[0], font);
+    m_widget->renderText(x0 + 4, bottom + 26, m_text[1], font);
+    glPopAttrib();
+}
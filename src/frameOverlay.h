@@ -0,0 +1,65 @@
+#ifndef FRAMEOVERLAY_H
+#define FRAMEOVERLAY_H
+
+#include <QtCore>
+
+class QGLWidget;
+
+///////////////////////////////////////////////////////////////////////////////
+///
+/// \class frameOverlay
+/// \brief Frame timing drawn over a GL widget.
+///
+/// The widget calls beginFrame() first thing in paintGL(), endFrame()
+/// when its own drawing is done and draw() last. The overlay shows the
+/// time between frames, the time the widget spent drawing, a rolling
+/// graph of both, frames dropped against the display refresh and the
+/// texture memory the widget holds. Nothing is measured while it is
+/// hidden. Its own drawing falls outside the measured work, and the
+/// text is reformatted only a few times a second.
+///
+///////////////////////////////////////////////////////////////////////////////
+
+class frameOverlay
+{
+public:
+    frameOverlay(QGLWidget *widget);
+
+    void        setVisible(bool on);
+    bool        isVisible() const               { return m_visible; }
+
+    // shortest interval the widget's animation redraws at, in ms
+    void        setAnimationInterval(int ms)    { m_animation = ms; }
+    void        setTextureBytes(qint64 bytes)   { m_textureBytes = bytes; }
+
+    void        beginFrame();
+    void        endFrame();
+    void        draw();
+
+private:
+    double      refreshInterval() const;
+    void        updateText(qint64 now);
+
+    QGLWidget       *m_widget;
+    bool            m_visible;
+    int             m_animation;
+    qint64          m_textureBytes;
+
+    QElapsedTimer   m_clock;
+    qint64          m_frameStart;       // ns, -1 before the first frame
+    qint64          m_lastFrame;
+    double          m_target;           // expected ms between frames
+
+    // rolling history, newest at m_head - 1
+    QVector<float>  m_intervals;
+    QVector<float>  m_work;
+    int             m_head;
+    int             m_count;
+    qint64          m_frames;
+    qint64          m_dropped;
+
+    QString         m_text[2];
+    qint64          m_textTime;
+};
+
+#endif // FRAMEOVERLAY_H
@@ -1,16 +1,21 @@
 #include<QGLWidget>
 #include <QtOpenGL>
 #include "glWidget.h"
+#include "traceRecorder.h"
+#include "metricsRegistry.h"
 #include <iostream>
 
 using namespace std;
 
+// ms between animation steps
+const int ANIMATION_MS = 10;
+
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 // glWidget::glWidget:
 //
 // Constructor. Initialize used variables
 //
-glWidget::glWidget() {
+glWidget::glWidget() : m_overlay(this) {
     //size of squares
     //alter if square size is changed
     m_size = 2;
@@ -22,10 +27,12 @@ glWidget::glWidget() {
     m_current = 0;  //current album
     m_listLength = 10; //number of albums displayed
     m_loaded = false; //images loaded?
+    m_textureBytes = 0;
     setAutoBufferSwap(true);
     
     //connect timer to animation
     connect(m_timer, SIGNAL(timeout()), this, SLOT(s_animate()));
+    m_overlay.setAnimationInterval(ANIMATION_MS);
 }
 
 
@@ -73,6 +80,12 @@ void glWidget::resizeGL(int w, int h) {
 //draws frames
 //
 void glWidget::paintGL() {
+    static metricHistogram *paintTime = metricsRegistry::instance()->histogram(
+            "qtunes_paint_seconds", "Time spent drawing one frame.", "widget=\"coverflow\"",
+            metricHistogram::frameBounds());
+    QElapsedTimer timer;
+    timer.start();
+    m_overlay.beginFrame();
     glClear(GL_COLOR_BUFFER_BIT);
     glLoadIdentity();
     int alb;
@@ -135,6 +148,10 @@ void glWidget::paintGL() {
         }
         glPopMatrix();
     }
+
+    m_overlay.endFrame();
+    paintTime->observe(timer.nsecsElapsed() / 1e9);
+    m_overlay.draw();
 }
 
 
@@ -226,9 +243,19 @@ void glWidget::square(int index, bool flip) {
 // Adds images to the list of qimages.
 //
 void glWidget::loadImages(QList<QImage> imgs) {
+    TRACE_SCOPE("glWidget::loadImages", "gl");
+    TRACE_DETAIL(QString("%1 textures").arg(imgs.size()));
     m_loaded =true;
+    makeCurrent();
+
+    // drop textures of a previous load
+    for(int i=0; i<m_texture.size(); i++)
+        deleteTexture(m_texture[i]);
+    m_texture.clear();
+
     glEnable(GL_TEXTURE_2D);
 
+    m_textureBytes = 0;
     for(int i=0; i<imgs.size(); i++) {
         //        m_imagelist << imgs[i];
         // storage for one texture
@@ -236,6 +263,8 @@ void glWidget::loadImages(QList<QImage> imgs) {
 
         // loads and binds the texture from a qimage
         m_texture << bindTexture(imgs[i]);
+        // RGBA plus a third for the mipmaps bindTexture builds
+        m_textureBytes += (qint64) imgs[i].width() * imgs[i].height() * 4 * 4 / 3;
         glBindTexture  (GL_TEXTURE_2D,   m_texture[i]);
         // sets texture parameters
         glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
@@ -246,6 +275,7 @@ void glWidget::loadImages(QList<QImage> imgs) {
     }
     glDisable(GL_TEXTURE_2D);
     m_listLength = imgs.size();
+    m_overlay.setTextureBytes(m_textureBytes);
     m_current=0;
     updateGL();
 }
@@ -258,6 +288,7 @@ void glWidget::loadImages(QList<QImage> imgs) {
 // Slot function keep animation happening
 //
 void glWidget::s_animate() {
+    TRACE_SLOT("glWidget::s_animate");
     //controlls speed of the animation
     m_change += .05;
     updateGL();
@@ -307,6 +338,33 @@ void glWidget::startAnimate(bool left) {
         }
 
         //start animation
-        m_timer->start(10);
+        m_timer->start(ANIMATION_MS);
     }
 }
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// glWidget::setVisibleCount:
+//
+// Sets the number of albums shown (rounded up to even, one is clipped).
+//
+void glWidget::setVisibleCount(int n) {
+    m_albNum = qMax(2, n + (n & 1));
+    updateGL();
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// glWidget::setPosition:
+//
+// Moves the flow to a position saved from position() and direction(),
+// without animating. Ignored while animating or if out of range.
+//
+void glWidget::setPosition(int current, int dir) {
+    if(m_timer->isActive() || current < -m_albNum || current >= m_listLength) return;
+    m_current = current;
+    m_dir     = dir < 0 ? -1 : 1;
+    updateGL();
+}
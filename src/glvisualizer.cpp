@@ -1,4 +1,6 @@
 #include "glvisualizer.h"
+#include "traceRecorder.h"
+#include "metricsRegistry.h"
 #include <QTimer>
 #include <ctime>
 
@@ -29,7 +31,7 @@ const short NUM_COLORS = 7;
 //
 // Constructor.
 //
-glVisualizer::glVisualizer()
+glVisualizer::glVisualizer() : m_overlay(this)
 {
     m_barDropTimer = new QTimer();
     m_barJumpTimer = new QTimer();
@@ -37,9 +39,7 @@ glVisualizer::glVisualizer()
     m_color = VisualizerColorGreen;
 
     // initially set all bars to min height
-    for(int i = 0; i < NUM_BARS; ++i) {
-        m_barHeights[i] = MIN_HEIGHT;
-    }
+    m_barHeights.fill(MIN_HEIGHT, NUM_BARS);
 
     // connect timer to redraw bars
     connect(m_barDropTimer, SIGNAL(timeout()),
@@ -50,6 +50,7 @@ glVisualizer::glVisualizer()
 
     // redraw bars every 25ms (they will start to drop)
     m_barDropTimer->start(25);
+    m_overlay.setAnimationInterval(25);
 
     setColor((VisualizerColor)(m_color % 5));
 
@@ -86,6 +87,12 @@ void glVisualizer::initializeGL() {
 // Repaints the bars.  Decreases bar heights every time this is called.
 //
 void glVisualizer::paintGL() {
+    static metricHistogram *paintTime = metricsRegistry::instance()->histogram(
+            "qtunes_paint_seconds", "Time spent drawing one frame.", "widget=\"visualizer\"",
+            metricHistogram::frameBounds());
+    QElapsedTimer timer;
+    timer.start();
+    m_overlay.beginFrame();
     glClear(GL_COLOR_BUFFER_BIT);
 
     // the left point of the first bar (x-coordinate)
@@ -93,11 +100,11 @@ void glVisualizer::paintGL() {
 
     // width of each bar is the canvas's length divided by the number of bars
     const float canvasWidth = 2.0f;
-    float barWidth = (canvasWidth - (2*DISTANCE_FROM_SIDES))/NUM_BARS;
+    float barWidth = (canvasWidth - (2*DISTANCE_FROM_SIDES))/m_barHeights.size();
 
     // in paintGL()
-    // draw [NUM_BARS] bars
-    for(int i = 0; i < NUM_BARS; ++i) {
+    // draw all bars
+    for(int i = 0; i < m_barHeights.size(); ++i) {
         // every time paintGL() is called, bar heights decrease by DROP_RATE
         m_barHeights[i] -= DROP_RATE;
         // shouldn't go below min height
@@ -117,6 +124,10 @@ void glVisualizer::paintGL() {
         // set new left point for the next bar
         leftPoint += barWidth;
     }
+
+    m_overlay.endFrame();
+    paintTime->observe(timer.nsecsElapsed() / 1e9);
+    m_overlay.draw();
 }
 
 
@@ -125,9 +136,11 @@ void glVisualizer::paintGL() {
 // glVisualizer::s_redrawDroppingBars():
 //
 // Slot called by timer to redraw bars and perform dropping effect.
+// update() lets Qt merge this with other pending paints.
 //
 void glVisualizer::s_redrawDroppingBars() {
-    repaint();
+    TRACE_SLOT("glVisualizer::s_redrawDroppingBars");
+    update();
 }
 
 
@@ -139,11 +152,12 @@ void glVisualizer::s_redrawDroppingBars() {
 // Only applies new height if it is greater than current height.
 //
 void glVisualizer::s_resetBarHeights() {
+    TRACE_SLOT("glVisualizer::s_resetBarHeights");
     // (maximum height for each bar) * 100 to avoid unnecessary casting
     int barMaxHeight = 150;
     int barMinHeight = 50;
 
-    for(int i = 0; i < NUM_BARS; ++i) {
+    for(int i = 0; i < m_barHeights.size(); ++i) {
             // new height is higher than the current height and less than the maximum height
             float newHeight = (rand() % (barMaxHeight - barMinHeight) + barMinHeight) / 100.0f;
             // if random height is larger than current bar height, set new height
@@ -181,6 +195,18 @@ bool glVisualizer::animationIsActive() {
 
 
 
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// glVisualizer::setBarCount(int):
+//
+// Sets the number of bars. All bars start again at minimum height.
+//
+void glVisualizer::setBarCount(int n) {
+    m_barHeights.fill(MIN_HEIGHT, qMax(1, n));
+    update();
+}
+
+
+
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 // glVisualizer::setColor(glVisualizer::VisualizerColor):
 //
@@ -242,6 +268,7 @@ void glVisualizer::setColor(glVisualizer::VisualizerColor vc) {
 // Slot to be connected to the click signal of a button in an external class.
 //
 void glVisualizer::s_toggleVisualizerColor() {
+    TRACE_SLOT("glVisualizer::s_toggleVisualizerColor");
     /* increment color and loop around if color limit is exceeded */
     short newColor = (m_color + 1) % NUM_COLORS;
     m_color = (VisualizerColor)newColor;
@@ -2,6 +2,7 @@
 #define GLVISUALIZER_H
 
 #include <QGLWidget>
+#include "frameOverlay.h"
 
 class glVisualizer : public QGLWidget
 {
@@ -24,20 +25,27 @@ public:
     void setAnimationActive(bool);
     /* Returns whether animation should be active or not. */
     bool animationIsActive();
+    /* Sets the number of bars; all start at minimum height. */
+    void setBarCount(int);
+    /* Shows frame timing over the bars. */
+    void setOverlayVisible(bool on) { m_overlay.setVisible(on); }
+    bool overlayVisible() const { return m_overlay.isVisible(); }
 protected:
     void initializeGL();
     void paintGL();
     void resizeGL(int w,int h);
 private:
-    /* Number of bars in visualizer. */
+    /* Default number of bars in visualizer. */
     static const short NUM_BARS = 100;
     /* Array of bar heights. */
-    float m_barHeights[NUM_BARS];
+    QVector<float> m_barHeights;
 
     /* Timer for jump animation. */
     QTimer* m_barJumpTimer;
     /* Timer for drop animation. */
     QTimer* m_barDropTimer;
+    /* Frame timing, hidden by default. */
+    frameOverlay m_overlay;
 
     /* 2d-array of color values */
     float m_colorArr[3][3];
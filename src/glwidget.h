@@ -11,6 +11,8 @@
     #include "glu.h"
 #endif
 
+#include "frameOverlay.h"
+
 class glWidget : public QGLWidget
 {
     Q_OBJECT
@@ -23,6 +25,20 @@ public:
     ~glWidget();
     void        startAnimate(bool left);
     void        loadImages(QList<QImage> imgs);
+    void        setVisibleCount(int n);
+
+    // album at the centre and the direction of the last move (1 = left)
+    int         position() const            { return m_current; }
+    int         direction() const           { return m_dir; }
+    void        setPosition(int current, int dir);
+
+    // frame timing drawn over the covers
+    void        setOverlayVisible(bool on)  { m_overlay.setVisible(on); }
+    bool        overlayVisible() const      { return m_overlay.isVisible(); }
+
+    // cover textures and their estimated video memory
+    int         textureCount() const        { return m_texture.size(); }
+    qint64      textureBytes() const        { return m_textureBytes; }
 
 public slots:
     void        s_animate();
@@ -37,6 +53,8 @@ private:
     double              m_change;
     QTimer              *m_timer;
     QList<GLuint>       m_texture;
+    qint64              m_textureBytes;
+    frameOverlay        m_overlay;
 
     void        square(int index, bool flip);
 
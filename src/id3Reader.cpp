@@ -0,0 +1,526 @@
+#include "id3Reader.h"
+#include <cstring>
+#include <tstring.h>
+#include <id3v1genres.h>
+
+// bytes fetched per read; one block usually covers all text frames
+const int CHUNK = 4096;
+
+// bytes of a text frame that are decoded
+const int MAX_TEXT = 1024;
+
+// room for MAX_TEXT bytes once converted to UTF-8
+const int MAX_UTF8 = MAX_TEXT * 3;
+
+// bytes scanned after the tag for the first MPEG frame sync
+const int SYNC_WINDOW = 4096;
+
+// bytes of the first frame holding Xing/Info + LAME or VBRI headers
+const int FRAME_HEADERS = 192;
+
+// MPEG bitrates in kbps: [MPEG1 L1, L2, L3, MPEG2/2.5 L1, L2/L3][index]
+static const int BITRATES[5][16] = {
+    {0, 32, 64, 96,128,160,192,224,256,288,320,352,384,416,448, 0},
+    {0, 32, 48, 56, 64, 80, 96,112,128,160,192,224,256,320,384, 0},
+    {0, 32, 40, 48, 56, 64, 80, 96,112,128,160,192,224,256,320, 0},
+    {0, 32, 48, 56, 64, 80, 96,112,128,144,160,176,192,224,256, 0},
+    {0,  8, 16, 24, 32, 40, 48, 56, 64, 80, 96,112,128,144,160, 0}
+};
+
+// sample rates: [MPEG2.5, reserved, MPEG2, MPEG1][index]
+static const int SAMPLERATES[4][3] = {
+    {11025, 12000,  8000},
+    {    0,     0,     0},
+    {22050, 24000, 16000},
+    {44100, 48000, 32000}
+};
+
+static quint32 be32(const uchar *p) {
+    return ((quint32) p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+static quint32 syncsafe(const uchar *p) {
+    return ((p[0] & 0x7F) << 21) | ((p[1] & 0x7F) << 14) | ((p[2] & 0x7F) << 7) | (p[3] & 0x7F);
+}
+
+// ID3v1 genre names as UTF-8
+static QList<QByteArray> makeGenreNames() {
+    QList<QByteArray> list;
+    for(int i=0; i<256; i++)
+        list << QByteArray(TagLib::ID3v1::genre(i).toCString(true));
+    return list;
+}
+
+static const QList<QByteArray> &genreNames() {
+    static const QList<QByteArray> names = makeGenreNames();
+    return names;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// id3Reader::id3Reader:
+//
+// Constructor.
+//
+id3Reader::id3Reader()
+    : m_rec(NULL), m_arena(NULL), m_size(0), m_bytes(0), m_hasV1(false),
+      m_chunk(CHUNK, 0), m_chunkLen(0), m_chunkPos(0) {
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// id3Reader::clear:
+//
+// Resets the record and the block cache before a read.
+//
+void id3Reader::clear() {
+    m_rec->title .size = 0;
+    m_rec->artist.size = 0;
+    m_rec->album .size = 0;
+    m_rec->albumArtist.size = 0;
+    m_rec->genre .size = 0;
+    m_rec->mime  .size = 0;
+    m_rec->track     = -1;
+    m_rec->seconds   = -1;
+    m_rec->artOffset = -1;
+    m_rec->artSize   = 0;
+
+    m_size     = 0;
+    m_bytes    = 0;
+    m_hasV1    = false;
+    m_chunkLen = 0;
+    m_chunkPos = 0;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// id3Reader::read:
+//
+// Reads tags and duration of an MP3 file. Returns false if the file
+// must be handled by TagLib instead.
+//
+bool id3Reader::read(const QString &path, scanRecord *rec, scanArena *arena) {
+    m_rec   = rec;
+    m_arena = arena;
+    clear();
+    if(!path.endsWith(".mp3", Qt::CaseInsensitive)) return false;
+
+    m_file.setFileName(path);
+    if(!m_file.open(QIODevice::ReadOnly | QIODevice::Unbuffered)) return false;
+    m_size = m_file.size();
+
+    qint64 audioStart = 0;
+    bool ok = readId3v2(&audioStart);
+    if(ok) {
+        readId3v1();
+        ok = readMpeg(audioStart, m_size - (m_hasV1 ? 128 : 0));
+    }
+
+    m_file.close();
+    return ok;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// id3Reader::fetch:
+//
+// Returns len bytes at pos, reading a new block only if they are not
+// in the last one. The pointer is valid until the next fetch.
+//
+const char *id3Reader::fetch(qint64 pos, int len) {
+    if(pos < 0 || len < 0 || pos + len > m_size) return NULL;
+
+    if(pos >= m_chunkPos && pos + len <= m_chunkPos + m_chunkLen)
+        return m_chunk.constData() + (pos - m_chunkPos);
+
+    // the block buffer is reused from file to file
+    if(len > m_chunk.size())
+        m_chunk.resize(len);
+
+    m_chunkLen = 0;
+    if(!m_file.seek(pos)) return NULL;
+    qint64 n = m_file.read(m_chunk.data(), qMin<qint64>(qMax(len, CHUNK), m_size - pos));
+    if(n < 0) return NULL;
+    m_chunkLen = n;
+    m_chunkPos = pos;
+    m_bytes   += n;
+
+    if(m_chunkLen < len) return NULL;
+    return m_chunk.constData();
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// id3Reader::readId3v2:
+//
+// Walks the frame headers of a leading ID3v2.2/2.3/2.4 tag and sets
+// audioStart past the tag. Bodies are only read for frames we keep.
+// Unsynchronised or compressed tags are left to TagLib.
+//
+bool id3Reader::readId3v2(qint64 *audioStart) {
+    *audioStart = 0;
+
+    const uchar *h = (const uchar *) fetch(0, 10);
+    if(!h || memcmp(h, "ID3", 3) != 0) return true;
+
+    int     version = h[3];
+    int     flags   = h[5];
+    qint64  tagEnd  = 10 + syncsafe(h + 6);
+    *audioStart = tagEnd + ((version == 4 && (flags & 0x10)) ? 10 : 0);
+
+    if(version < 2 || version > 4) return false;
+    if(flags & 0x80) return false;
+    if(version == 2 && (flags & 0x40)) return false;
+
+    // skip the extended header
+    qint64 pos = 10;
+    if(version >= 3 && (flags & 0x40)) {
+        const uchar *e = (const uchar *) fetch(pos, 4);
+        if(!e) return false;
+        pos += version == 3 ? 4 + be32(e) : syncsafe(e);
+    }
+
+    int headerSize = version == 2 ? 6 : 10;
+    while(pos + headerSize <= tagEnd) {
+        const uchar *f = (const uchar *) fetch(pos, headerSize);
+        if(!f) return false;
+
+        // padding
+        if(f[0] == 0) break;
+
+        // the header may be evicted by readFrame; keep the ID
+        char id[5] = {0};
+        memcpy(id, f, version == 2 ? 3 : 4);
+        qint64 size;
+        bool   packed = false;
+        int    skip   = 0;
+        if(version == 2)
+            size = (f[3] << 16) | (f[4] << 8) | f[5];
+        else if(version == 3) {
+            size   = be32(f + 4);
+            packed = f[9] & 0xC0;
+            skip   = (f[9] & 0x20) ? 1 : 0;
+        }
+        else {
+            size   = syncsafe(f + 4);
+            packed = f[9] & 0x0E;
+            skip   = ((f[9] & 0x40) ? 1 : 0) + ((f[9] & 0x01) ? 4 : 0);
+        }
+        pos += headerSize;
+        if(size <= 0 || pos + size > tagEnd) break;
+
+        if(!readFrame(id, packed ? -1 : pos + skip, size - skip, version))
+            return false;
+        pos += size;
+    }
+    return true;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// id3Reader::readFrame:
+//
+// Reads one frame body if it is one we keep. pos is -1 for frames
+// stored compressed, encrypted or unsynchronised; those are fine to
+// skip unless we need them. The first frame of each kind wins.
+//
+bool id3Reader::readFrame(const char *id, qint64 pos, int size, int version) {
+    scanString *field = NULL;
+    bool trackField = false, genreField = false, picture = false;
+
+    if(!strcmp(id, "TIT2") || !strcmp(id, "TT2"))      field = &m_rec->title;
+    else if(!strcmp(id, "TPE1") || !strcmp(id, "TP1")) field = &m_rec->artist;
+    else if(!strcmp(id, "TALB") || !strcmp(id, "TAL")) field = &m_rec->album;
+    else if(!strcmp(id, "TPE2") || !strcmp(id, "TP2")) field = &m_rec->albumArtist;
+    else if(!strcmp(id, "TCON") || !strcmp(id, "TCO")) genreField = true;
+    else if(!strcmp(id, "TRCK") || !strcmp(id, "TRK")) trackField = true;
+    else if(!strcmp(id, "APIC") || !strcmp(id, "PIC")) picture = true;
+    else return true;
+
+    if(picture) {
+        if(m_rec->artSize) return true;
+        if(pos < 0) return false;
+        return readPicture(pos, size, version);
+    }
+
+    if(field && !field->isEmpty()) return true;
+    if(genreField && !m_rec->genre.isEmpty()) return true;
+    if(trackField && m_rec->track >= 0) return true;
+    if(pos < 0) return false;
+    if(size < 2) return true;
+
+    int len = qMin(size, MAX_TEXT);
+    const char *d = fetch(pos, len);
+    if(!d) return false;
+
+    char text[MAX_UTF8];
+    int n = decodeText(d + 1, len - 1, (uchar) d[0], text);
+
+    if(field)
+        m_arena->assign(field, text, n);
+    else if(genreField)
+        setGenre(text, n);
+    else {
+        // "3/12" is track 3; like TagLib, 0 means no number
+        int number = 0;
+        for(int i=0; i<n && text[i] >= '0' && text[i] <= '9'; i++)
+            number = number*10 + text[i] - '0';
+        if(number > 0)
+            m_rec->track = number;
+    }
+    return true;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// id3Reader::readPicture:
+//
+// Parses the APIC/PIC header (encoding, MIME or format, type and
+// description) and records where the picture bytes start.
+//
+bool id3Reader::readPicture(qint64 pos, int size, int version) {
+    int len = qMin(size, 512);
+    const uchar *d = (const uchar *) fetch(pos, len);
+    if(!d || len < 4) return false;
+
+    int encoding = d[0];
+    int p;
+    char mime[64];
+    int  mimeLen;
+    if(version == 2) {
+        char format[4] = {0};
+        for(int i=0; i<3; i++)
+            format[i] = tolower(d[1+i]);
+        mimeLen = qsnprintf(mime, sizeof(mime), "image/%s",
+                            strcmp(format, "jpg") ? format : "jpeg");
+        p = 4;
+    }
+    else {
+        p = 1;
+        while(p < len && d[p]) p++;
+        mimeLen = qMin(p - 1, (int) sizeof(mime));
+        memcpy(mime, d + 1, mimeLen);
+        p++;
+    }
+
+    // picture type, then the description
+    p++;
+    if(encoding == 1 || encoding == 2) {
+        while(p + 1 < len && (d[p] || d[p+1])) p += 2;
+        p += 2;
+    }
+    else {
+        while(p < len && d[p]) p++;
+        p++;
+    }
+    if(p > len) return false;
+
+    m_arena->assign(&m_rec->mime, mime, mimeLen);
+    m_rec->artOffset = pos + p;
+    m_rec->artSize   = size - p;
+    return true;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// id3Reader::readId3v1:
+//
+// Reads the 128-byte trailer and fills fields ID3v2 left empty.
+//
+void id3Reader::readId3v1() {
+    if(m_size < 128) return;
+
+    // read past the block cache so the first frame stays cached
+    char d[128];
+    if(!m_file.seek(m_size - 128)) return;
+    qint64 n = m_file.read(d, 128);
+    if(n > 0) m_bytes += n;
+    if(n < 128 || memcmp(d, "TAG", 3) != 0) return;
+    m_hasV1 = true;
+
+    scanString *fields[3] = { &m_rec->title, &m_rec->artist, &m_rec->album };
+    for(int i=0; i<3; i++) {
+        if(!fields[i]->isEmpty()) continue;
+
+        // space-padded Latin-1
+        char text[30 * 2];
+        int len = decodeText(d + 3 + 30*i, 30, 0, text);
+        int from = 0;
+        while(from < len && (uchar) text[from] <= ' ') from++;
+        while(len > from && (uchar) text[len-1] <= ' ') len--;
+        m_arena->assign(fields[i], text + from, len - from);
+    }
+
+    // ID3v1.1 keeps the track number at the end of the comment
+    if(m_rec->track < 0 && d[125] == 0 && d[126] != 0)
+        m_rec->track = (uchar) d[126];
+    if(m_rec->genre.isEmpty() && (uchar) d[127] != 255) {
+        const QByteArray &name = genreNames().at((uchar) d[127]);
+        m_arena->assign(&m_rec->genre, name.constData(), name.size());
+    }
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// id3Reader::readMpeg:
+//
+// Finds the first MPEG audio frame after the tag and computes the
+// duration from its Xing/Info (with LAME delay and padding) or VBRI
+// frame count, or from the bitrate for plain CBR files.
+//
+bool id3Reader::readMpeg(qint64 audioStart, qint64 audioEnd) {
+    int window = (int) qMin<qint64>(SYNC_WINDOW, audioEnd - audioStart);
+    if(window < 4) return false;
+
+    const uchar *d = (const uchar *) fetch(audioStart, window);
+    if(!d) return false;
+
+    for(int i=0; i+4<=window; i++) {
+        if(d[i] != 0xFF || (d[i+1] & 0xE0) != 0xE0) continue;
+
+        quint32 h = be32(d + i);
+        int version = (h >> 19) & 3;    // 3 MPEG1, 2 MPEG2, 0 MPEG2.5
+        int layer   = (h >> 17) & 3;    // 3 L1, 2 L2, 1 L3
+        int brIndex = (h >> 12) & 15;
+        int srIndex = (h >> 10) & 3;
+        int mono    = ((h >> 6) & 3) == 3;
+        if(version == 1 || layer == 0 || brIndex == 0 || brIndex == 15 || srIndex == 3)
+            continue;
+
+        bool mpeg1 = version == 3;
+        int  row   = mpeg1 ? 3 - layer : (layer == 3 ? 3 : 4);
+        int  bitrate    = BITRATES[row][brIndex];
+        int  sampleRate = SAMPLERATES[version][srIndex];
+        int  samples    = layer == 3 ? 384 : (layer == 1 && !mpeg1 ? 576 : 1152);
+
+        qint64 framePos = audioStart + i;
+        int    len = (int) qMin<qint64>(FRAME_HEADERS, audioEnd - framePos);
+        const uchar *f = (const uchar *) fetch(framePos, len);
+        if(!f) return false;
+
+        qint64 frames = -1;
+        int delay = 0, padding = 0;
+        int xing = 4 + (mpeg1 ? (mono ? 17 : 32) : (mono ? 9 : 17));
+
+        if(layer == 1 && xing + 8 <= len &&
+           (memcmp(f + xing, "Xing", 4) == 0 || memcmp(f + xing, "Info", 4) == 0)) {
+            quint32 flags = be32(f + xing + 4);
+            int p = xing + 8;
+            if((flags & 1) && p + 4 <= len) frames = be32(f + p);
+            if(flags & 1) p += 4;
+            if(flags & 2) p += 4;
+            if(flags & 4) p += 100;
+            if(flags & 8) p += 4;
+
+            // LAME extension: encoder delay and padding in samples
+            if(p + 24 <= len && memcmp(f + p, "LAME", 4) == 0) {
+                delay   = (f[p+21] << 4) | (f[p+22] >> 4);
+                padding = ((f[p+22] & 0x0F) << 8) | f[p+23];
+            }
+        }
+        else if(36 + 18 <= len && memcmp(f + 36, "VBRI", 4) == 0)
+            frames = be32(f + 36 + 14);
+
+        if(frames > 0)
+            m_rec->seconds = (int) ((frames * samples - delay - padding) / sampleRate);
+        else
+            m_rec->seconds = (int) ((audioEnd - framePos) * 8 / (bitrate * 1000));
+        return true;
+    }
+    return false;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// id3Reader::decodeText:
+//
+// Converts an ID3 string (0 Latin-1, 1 UTF-16 with BOM, 2 UTF-16BE,
+// 3 UTF-8) up to its terminator to UTF-8 in out, which must hold
+// size*3 bytes; only the first of multiple values is kept. Returns
+// the number of bytes written.
+//
+int id3Reader::decodeText(const char *data, int size, int encoding, char *out) {
+    const uchar *d = (const uchar *) data;
+    int len = 0;
+
+    if(encoding == 1 || encoding == 2) {
+        bool bigEndian = encoding == 2;
+        int  i = 0;
+        if(encoding == 1 && size >= 2) {
+            if(d[0] == 0xFE && d[1] == 0xFF)      { bigEndian = true;  i = 2; }
+            else if(d[0] == 0xFF && d[1] == 0xFE) { bigEndian = false; i = 2; }
+        }
+
+        for(; i+1<size; i+=2) {
+            uint c = bigEndian ? (d[i] << 8) | d[i+1] : d[i] | (d[i+1] << 8);
+            if(!c) break;
+
+            if(QChar::isHighSurrogate(c) && i+3 < size) {
+                uint low = bigEndian ? (d[i+2] << 8) | d[i+3] : d[i+2] | (d[i+3] << 8);
+                if(QChar::isLowSurrogate(low)) {
+                    c = QChar::surrogateToUcs4(c, low);
+                    i += 2;
+                }
+            }
+            len += scanArena::encodeUtf8(c, out + len);
+        }
+        return len;
+    }
+
+    for(int i=0; i<size && d[i]; i++) {
+        if(encoding == 3)
+            out[len++] = d[i];
+        else
+            len += scanArena::encodeUtf8(d[i], out + len);
+    }
+    return len;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// id3Reader::setGenre:
+//
+// Stores a TCON value, resolving numeric genres ("13", "(13)",
+// "(13)Pop") the way TagLib reports them.
+//
+void id3Reader::setGenre(const char *text, int len) {
+    const char *s = text;
+    int n = len;
+    if(n && s[0] == '(') {
+        const char *close = (const char *) memchr(s, ')', n);
+        if(close) {
+            int rest = len - (close + 1 - text);
+            if(rest > 0) {
+                m_arena->assign(&m_rec->genre, close + 1, rest);
+                return;
+            }
+            s = text + 1;
+            n = close - s;
+        }
+    }
+
+    int index = 0;
+    bool number = n > 0 && n <= 3;
+    for(int i=0; i<n && number; i++) {
+        number = s[i] >= '0' && s[i] <= '9';
+        index  = index*10 + s[i] - '0';
+    }
+
+    if(number && index < 256) {
+        const QByteArray &name = genreNames().at(index);
+        m_arena->assign(&m_rec->genre, name.constData(), name.size());
+    }
+    else
+        m_arena->assign(&m_rec->genre, text, len);
+}
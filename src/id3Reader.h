@@ -0,0 +1,59 @@
+#ifndef ID3READER_H
+#define ID3READER_H
+
+#include <QtCore>
+#include "scanArena.h"
+
+///////////////////////////////////////////////////////////////////////////////
+///
+/// \class id3Reader
+/// \brief Bounded-read tag and duration reader for MP3 files.
+///
+/// Reads the ID3v2 header and frame headers (skipping frame bodies it
+/// doesn't need, including the picture), the ID3v1 trailer and the
+/// first MPEG frame with its Xing/Info/LAME or VBRI header. Only those
+/// byte ranges are read, so the I/O per file stays small whatever the
+/// file size. read() returns false for files it can't handle; callers
+/// should then use TagLib. Text goes straight into the record's arena
+/// as UTF-8, so a read allocates nothing once the arena is warm.
+///
+///////////////////////////////////////////////////////////////////////////////
+
+class id3Reader
+{
+public:
+    id3Reader();
+
+    // fills everything but rec->file and rec->dir
+    bool        read(const QString &path, scanRecord *rec, scanArena *arena);
+
+    // bytes actually read from the file by the last read()
+    qint64      bytesRead() const   { return m_bytes; }
+
+private:
+    void        clear();
+    const char *fetch(qint64 pos, int len);
+    bool        readId3v2(qint64 *audioStart);
+    bool        readFrame(const char *id, qint64 pos, int size, int version);
+    bool        readPicture(qint64 pos, int size, int version);
+    void        readId3v1();
+    bool        readMpeg(qint64 audioStart, qint64 audioEnd);
+
+    void        setGenre(const char *text, int len);
+
+    static int  decodeText(const char *data, int size, int encoding, char *out);
+
+    scanRecord  *m_rec;
+    scanArena   *m_arena;
+    QFile       m_file;
+    qint64      m_size;
+    qint64      m_bytes;
+    bool        m_hasV1;
+
+    // last block read from the file
+    QByteArray  m_chunk;
+    int         m_chunkLen;
+    qint64      m_chunkPos;
+};
+
+#endif // ID3READER_H
@@ -0,0 +1,166 @@
+#include "libraryIndex.h"
+#include "trackStore.h"
+#include "scanArena.h"
+
+// identifies an index file; version 2 stores a missing track number
+// as -1 for every file
+const quint32 INDEX_MAGIC   = 0x51544958;
+const quint16 INDEX_VERSION = 2;
+
+// records appended to the store at a time, as in the scanner
+const int BATCH = 1024;
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// modified:
+//
+// Modification time of a folder in ms, or -1 if it is gone.
+//
+static qint64 modified(const QString &dir) {
+    QFileInfo info(dir);
+    return info.exists() ? info.lastModified().toMSecsSinceEpoch() : -1;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// libraryIndex::pathFor:
+//
+// Location of the index of root, named by a hash of its path.
+//
+QString libraryIndex::pathFor(const QString &root) {
+    QString dir = QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation);
+    QDir().mkpath(dir);
+    QByteArray hash = QCryptographicHash::hash(QDir::cleanPath(root).toUtf8(),
+                                               QCryptographicHash::Sha1);
+    return dir + "/library-" + hash.toHex().left(16) + ".index";
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// libraryIndex::save:
+//
+// Writes the folders with their times, then one record per track in ID
+// order. The album artist is written resolved, so untagged ones come
+// back as the track artist, which groups the same way.
+//
+bool libraryIndex::save(const QString &path, const QString &root,
+                        const QStringList &dirs, const trackStore &store) {
+    QSaveFile file(path);
+    if(!file.open(QIODevice::WriteOnly)) return false;
+
+    // visited folders, then any folder of a track not among them
+    QStringList list = dirs;
+    QHash<QString, int> position;
+    for(int i=0; i<list.size(); i++)
+        position.insert(list[i], i);
+    QVector<int> dirOf(store.dirCount(), -1);
+    for(int t=0; t<store.size(); t++) {
+        int &d = dirOf[store.dir(t)];
+        if(d >= 0) continue;
+        QString p = store.dirPath(store.dir(t));
+        if(!position.contains(p)) {
+            position.insert(p, list.size());
+            list << p;
+        }
+        d = position.value(p);
+    }
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_5_0);
+    out << INDEX_MAGIC << INDEX_VERSION << root;
+
+    out << (qint32) list.size();
+    for(int i=0; i<list.size(); i++)
+        out << list[i] << modified(list[i]);
+
+    out << (qint32) store.size();
+    for(int t=0; t<store.size(); t++) {
+        const trackAlbum &album = store.albumInfo(store.albumOf(t));
+        out << (qint32) dirOf[store.dir(t)] << store.fileName(t)
+            << store.title(t) << store.artist(t) << store.album(t)
+            << store.value(ARTIST, album.artist) << store.genre(t)
+            << (qint32) store.trackNumber(t) << (qint32) store.seconds(t)
+            << store.artOffset(t) << store.artSize(t) << store.artMime(t);
+    }
+
+    return out.status() == QDataStream::Ok && file.commit();
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// libraryIndex::load:
+//
+// Rebuilds the records in an arena and appends them in batches. On a
+// read error the store is cleared and false returned.
+//
+bool libraryIndex::load(const QString &path, const QString &root, trackStore *store,
+                        bool *stale, std::atomic<int> *done, std::atomic<int> *total) {
+    QFile file(path);
+    if(!file.open(QIODevice::ReadOnly)) return false;
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_5_0);
+    quint32 magic;
+    quint16 version;
+    QString indexRoot;
+    in >> magic >> version >> indexRoot;
+    if(magic != INDEX_MAGIC || version != INDEX_VERSION || indexRoot != root) return false;
+
+    qint32 dirCount;
+    in >> dirCount;
+    QStringList dirs;
+    *stale = false;
+    for(int i=0; i<dirCount && in.status() == QDataStream::Ok; i++) {
+        QString dir;
+        qint64 time;
+        in >> dir >> time;
+        dirs << dir;
+        if(modified(dir) != time)
+            *stale = true;
+    }
+
+    qint32 n;
+    in >> n;
+    if(in.status() != QDataStream::Ok || n < 0) return false;
+    if(total) total->store(n);
+
+    scanArena arena;
+    QVector<scanRecord *> records;
+    records.reserve(BATCH);
+    for(int t=0; t<n; t++) {
+        QString name, title, artist, album, albumArtist, genre, mime;
+        qint32 dir, track, seconds;
+        qint64 artOffset, artSize;
+        in >> dir >> name >> title >> artist >> album >> albumArtist >> genre
+           >> track >> seconds >> artOffset >> artSize >> mime;
+        if(in.status() != QDataStream::Ok || dir < 0 || dir >= dirs.size()) {
+            store->clear();
+            return false;
+        }
+
+        scanRecord *rec = arena.make<scanRecord>();
+        rec->dir = dir;
+        arena.assign(&rec->file,        name);
+        arena.assign(&rec->title,       title);
+        arena.assign(&rec->artist,      artist);
+        arena.assign(&rec->album,       album);
+        arena.assign(&rec->albumArtist, albumArtist);
+        arena.assign(&rec->genre,       genre);
+        arena.assign(&rec->mime,        mime);
+        rec->track     = track;
+        rec->seconds   = seconds;
+        rec->artOffset = artOffset;
+        rec->artSize   = artSize;
+        records << rec;
+
+        if(records.size() == BATCH || t == n-1) {
+            store->append(dirs, records);
+            records.resize(0);
+            arena.reset();
+            if(done) done->store(t + 1);
+        }
+    }
+    return true;
+}
@@ -0,0 +1,42 @@
+#ifndef LIBRARYINDEX_H
+#define LIBRARYINDEX_H
+
+#include <QtCore>
+#include <atomic>
+
+class trackStore;
+
+///////////////////////////////////////////////////////////////////////////////
+///
+/// \class libraryIndex
+/// \brief Saved copy of a scanned library, restored without reading tags.
+///
+/// The index holds every track's tags and cover location, plus the
+/// modification time of each folder the scan visited. Restoring feeds
+/// the tracks through trackStore::append() as a scan would, so values,
+/// directories and albums are rebuilt the same way. A folder whose
+/// time changed (files added, removed or renamed) marks the index
+/// stale; files retagged in place are not noticed until the next scan.
+/// Each library root has an index of its own.
+///
+///////////////////////////////////////////////////////////////////////////////
+
+class libraryIndex
+{
+public:
+    // the index shard of one library root in the user's data directory
+    static QString  pathFor(const QString &root);
+
+    // writes store, scanned from root visiting dirs, to path
+    static bool     save(const QString &path, const QString &root,
+                         const QStringList &dirs, const trackStore &store);
+
+    // appends the tracks of the index at path to an empty store if it was
+    // made for root; *stale is set if a folder changed since. done counts
+    // restored tracks and total is set first, for progress displays.
+    static bool     load(const QString &path, const QString &root, trackStore *store,
+                         bool *stale, std::atomic<int> *done = NULL,
+                         std::atomic<int> *total = NULL);
+};
+
+#endif // LIBRARYINDEX_H
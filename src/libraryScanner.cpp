@@ -0,0 +1,397 @@
+#include "libraryScanner.h"
+#include "trackStore.h"
+#include "allocStats.h"
+#include "traceRecorder.h"
+#include "metricsRegistry.h"
+#include <QtConcurrent>
+
+#include <tag.h>
+#include <fileref.h>
+#include <mpegfile.h>
+#include <id3v2tag.h>
+#include <attachedPictureFrame.h>
+
+// records moved into the store at a time
+const int BATCH = 1024;
+
+// leading picture bytes used to find candidate offsets in the tag
+const int ART_PROBE = 64;
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// libraryScanner::libraryScanner:
+//
+// Constructor.
+//
+libraryScanner::libraryScanner(trackStore *store)
+    : m_store(store), m_progress(NULL), m_abort(NULL), m_readers(1), m_fast(0), m_fallback(0), m_bytes(0),
+      m_allocs(0), m_elapsed(0) {
+    m_records.reserve(BATCH);
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// libraryScanner::scan:
+//
+// Scans root and everything below it into the store, or as much of
+// it as was read when the scan is aborted.
+//
+int libraryScanner::scan(const QString &root) {
+    TRACE_SCOPE("libraryScanner::scan", "scan");
+    TRACE_DETAIL(root);
+
+    m_fast = m_fallback = 0;
+    m_bytes = 0;
+    m_allocs = 0;
+    m_dirs.clear();
+
+    QElapsedTimer timer;
+    timer.start();
+    quint64 allocs = allocCount();
+
+    int first = m_store->size();
+    if(m_readers > 1)
+        scanParallel(QDir::cleanPath(root));
+    else {
+        traverseDirs(QDir::cleanPath(root));
+        commit();
+    }
+
+    m_allocs += allocCount() - allocs;
+    m_elapsed = timer.elapsed();
+
+    metricsRegistry *metrics = metricsRegistry::instance();
+    static metricCounter *scanned = metrics->counter("qtunes_scan_files_total",
+            "Files read by library scans.");
+    static metricGauge *rate = metrics->gauge("qtunes_scan_files_per_second",
+            "Files per second of the last library scan.");
+    static metricHistogram *duration = metrics->histogram("qtunes_scan_duration_seconds",
+            "Time taken by library scans.", QString(),
+            QVector<double>() << 0.1 << 0.5 << 1 << 5 << 10 << 30 << 60 << 300);
+    scanned->add(files());
+    rate->set(m_elapsed ? files() * 1000.0 / m_elapsed : 0);
+    duration->observe(m_elapsed / 1000.0);
+
+    return m_store->size() - first;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// libraryScanner::addFile:
+//
+// Reads a single file and commits it right away.
+//
+int libraryScanner::addFile(const QString &path) {
+    QFileInfo info(path);
+    m_dirs.clear();
+    m_dirs << info.path();
+
+    readFile(0, info.fileName());
+    return commit();
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// libraryScanner::traverseDirs:
+//
+// Reads the *.mp3 files of path, then descends into its subdirectories.
+// Both come from one listing, files first, each sorted by name.
+//
+void libraryScanner::traverseDirs(const QString &path) {
+    TRACE_SCOPE("traverseDirs", "scan");
+    TRACE_DETAIL(path);
+
+    int dir = m_dirs.size();
+    m_dirs << path;
+
+    QDir listing(path);
+    QFileInfoList entries = listing.entryInfoList(QStringList("*.mp3"),
+            QDir::AllDirs | QDir::Files | QDir::NoDotAndDotDot,
+            QDir::Name | QDir::IgnoreCase | QDir::DirsLast);
+
+    int i = 0;
+    for(; i<entries.size() && !entries.at(i).isDir() && !aborted(); i++)
+        readFile(dir, entries.at(i).fileName());
+
+    // recursively descend through all subdirectories
+    for(; i<entries.size() && !aborted(); i++)
+        traverseDirs(entries.at(i).filePath());
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// libraryScanner::listDirs:
+//
+// Lists the *.mp3 files below path in the order traverseDirs reads
+// them, without reading any.
+//
+void libraryScanner::listDirs(const QString &path, QVector<scanFile> *files) {
+    TRACE_SCOPE("listDirs", "scan");
+    TRACE_DETAIL(path);
+
+    int dir = m_dirs.size();
+    m_dirs << path;
+
+    QDir listing(path);
+    QFileInfoList entries = listing.entryInfoList(QStringList("*.mp3"),
+            QDir::AllDirs | QDir::Files | QDir::NoDotAndDotDot,
+            QDir::Name | QDir::IgnoreCase | QDir::DirsLast);
+
+    int i = 0;
+    for(; i<entries.size() && !entries.at(i).isDir(); i++)
+        files->append(scanFile(dir, entries.at(i).fileName()));
+    for(; i<entries.size() && !aborted(); i++)
+        listDirs(entries.at(i).filePath(), files);
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// libraryScanner::scanParallel:
+//
+// Reads the files of root with m_readers readers, each a scanner
+// without a store. A reader's batch is committed as soon as it and
+// the batches before it are done, while later ones are still read.
+//
+void libraryScanner::scanParallel(const QString &root) {
+    QVector<scanFile> files;
+    listDirs(root, &files);
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(m_readers);
+    QVector<libraryScanner *> readers;
+    for(int w=0; w<m_readers; w++) {
+        libraryScanner *reader = new libraryScanner(NULL);
+        reader->m_dirs     = m_dirs;
+        reader->m_progress = m_progress;
+        reader->m_abort    = m_abort;
+        readers << reader;
+    }
+
+    for(int start=0; start<files.size() && !aborted(); start += m_readers * BATCH) {
+        QList<QFuture<void>> reads;
+        for(int w=0; w<m_readers && start + w*BATCH < files.size(); w++) {
+            int begin = start + w*BATCH;
+            reads << QtConcurrent::run(&pool, readers[w], &libraryScanner::readRange,
+                                       &files, begin, qMin(begin + BATCH, files.size()));
+        }
+        for(int w=0; w<reads.size(); w++) {
+            reads[w].waitForFinished();
+            TRACE_SCOPE("libraryScanner::commit", "scan");
+            m_store->append(m_dirs, readers[w]->m_records);
+            readers[w]->m_records.resize(0);
+            readers[w]->m_arena.reset();
+        }
+    }
+
+    for(int w=0; w<m_readers; w++) {
+        m_fast     += readers[w]->m_fast;
+        m_fallback += readers[w]->m_fallback;
+        m_bytes    += readers[w]->m_bytes;
+        m_allocs   += readers[w]->m_allocs;
+        delete readers[w];
+    }
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// libraryScanner::readRange:
+//
+// Reads files [begin, end) into this reader's batch, counting the
+// allocations made on its thread.
+//
+void libraryScanner::readRange(const QVector<scanFile> *files, int begin, int end) {
+    quint64 allocs = allocCount();
+    for(int i=begin; i<end && !aborted(); i++)
+        readFile(files->at(i).first, files->at(i).second);
+    m_allocs += allocCount() - allocs;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// libraryScanner::readFile:
+//
+// Adds one file of directory dir to the batch.
+//
+void libraryScanner::readFile(int dir, const QString &name) {
+    scanRecord *rec = m_arena.make<scanRecord>();
+    rec->dir = dir;
+    m_arena.assign(&rec->file, name);
+
+    m_path  = m_dirs.at(dir);
+    m_path += '/';
+    m_path += name;
+
+    metricsRegistry *metrics = metricsRegistry::instance();
+    static metricHistogram *fast = metrics->histogram("qtunes_tag_parse_seconds",
+            "Time to read the tags of one file.", "reader=\"fast\"");
+    static metricHistogram *taglib = metrics->histogram("qtunes_tag_parse_seconds",
+            "Time to read the tags of one file.", "reader=\"taglib\"");
+    int fallbacks = m_fallback;
+    QElapsedTimer timer;
+    timer.start();
+    readTags(m_path, rec);
+    (m_fallback == fallbacks ? fast : taglib)->observe(timer.nsecsElapsed() / 1e9);
+
+    m_records << rec;
+    if(m_progress)
+        m_progress->fetch_add(1, std::memory_order_relaxed);
+
+    // readers of a parallel scan have no store; their batch is taken
+    if(m_store && m_records.size() >= BATCH)
+        commit();
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// libraryScanner::readTags:
+//
+// Reads the tags of one file into rec; untagged fields stay empty.
+// The bounded-read fast path handles most MP3s, TagLib the rest.
+//
+void libraryScanner::readTags(const QString &path, scanRecord *rec) {
+    TRACE_SCOPE("readTags", "scan");
+    TRACE_DETAIL(path);
+
+    // fast path: read only the tag headers, trailer and first frame
+    if(m_id3.read(path, rec, &m_arena)) {
+        m_fast++;
+        m_bytes += m_id3.bytesRead();
+        return;
+    }
+    m_fallback++;
+    TRACE_DETAIL(path + " (TagLib)");
+
+    rec->title .size = rec->artist.size = rec->album.size = 0;
+    rec->genre .size = rec->mime  .size = 0;
+    rec->albumArtist.size = 0;
+    rec->track     = -1;
+    rec->seconds   = -1;
+    rec->artOffset = -1;
+    rec->artSize   = 0;
+
+    // this is the only time the file's tags are parsed
+    TagLib::FileRef source(QFile::encodeName(path).constData());
+    if(source.isNull() || !source.tag()) return;
+
+    TagLib::Tag *tag = source.tag();
+    assignTag(&rec->title,  tag->title ());
+    assignTag(&rec->artist, tag->artist());
+    assignTag(&rec->album,  tag->album ());
+    assignTag(&rec->genre,  tag->genre ());
+    // TagLib reports a missing track number as 0
+    if(tag->track())
+        rec->track = tag->track();
+
+    if(source.audioProperties())
+        rec->seconds = source.audioProperties()->length();
+
+    // record where the cover picture lives in the file
+    TagLib::MPEG::File *mpeg = dynamic_cast<TagLib::MPEG::File *>(source.file());
+    if(mpeg && mpeg->hasID3v2Tag()) {
+        findArtwork(mpeg, rec);
+
+        // the generic tag has no album artist
+        const TagLib::ID3v2::FrameList &frames = mpeg->ID3v2Tag()->frameList("TPE2");
+        if(!frames.isEmpty())
+            assignTag(&rec->albumArtist, frames.front()->toString());
+    }
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// libraryScanner::findArtwork:
+//
+// Stores byte offset, size and MIME type of the first APIC picture.
+// The picture is looked up by its leading bytes within the tag at the
+// start of the file, and a match only counts if all of the picture's
+// bytes are there, so two pictures with the same JPEG header can't be
+// mixed up. Unsynchronised or compressed pictures are not stored
+// verbatim; their offset is -1 and the player falls back to a tag
+// parse.
+//
+void libraryScanner::findArtwork(TagLib::MPEG::File *file, scanRecord *rec) {
+    TagLib::ID3v2::Tag *tag = file->ID3v2Tag();
+    TagLib::ID3v2::FrameList frames = tag->frameList("APIC");
+    if(frames.isEmpty()) return;
+
+    TagLib::ID3v2::AttachedPictureFrame *frame =
+            static_cast<TagLib::ID3v2::AttachedPictureFrame *>(frames.front());
+    TagLib::ByteVector picture = frame->picture();
+    if(picture.isEmpty()) return;
+
+    long offset = -1;
+    const TagLib::ID3v2::Frame::Header *header = frame->header();
+    bool verbatim = !tag->header()->unsynchronisation()
+                    && !header->unsynchronisation() && !header->compression();
+    if(verbatim) {
+        // read no further than the tag; the audio is never searched
+        file->seek(0);
+        TagLib::ByteVector data = file->readBlock(tag->header()->completeTagSize());
+        TagLib::ByteVector probe = picture.mid(0, ART_PROBE);
+        for(int at = data.find(probe); at >= 0; at = data.find(probe, at + 1)) {
+            if(data.containsAt(picture, at)) {
+                offset = at;
+                break;
+            }
+        }
+    }
+
+    assignTag(&rec->mime, frame->mimeType());
+    rec->artOffset = offset;
+    rec->artSize   = picture.size();
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// libraryScanner::assignTag:
+//
+// Copies a TagLib string into s as UTF-8.
+//
+void libraryScanner::assignTag(scanString *s, const TagLib::String &text) {
+    std::string utf8 = text.to8Bit(true);
+    m_arena.assign(s, utf8.data(), utf8.size());
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// libraryScanner::commit:
+//
+// Moves the batch into the store in one go and recycles the arena.
+// Returns the ID of the first committed track, or -1 if none.
+//
+int libraryScanner::commit() {
+    if(m_records.isEmpty()) return -1;
+
+    TRACE_SCOPE("libraryScanner::commit", "scan");
+    int first = m_store->append(m_dirs, m_records);
+    m_records.resize(0);
+    m_arena.reset();
+    return first;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// libraryScanner::report:
+//
+// One-line summary of the last scan.
+//
+QString libraryScanner::report() const {
+    int n = files();
+    QString text = QString("scanned %1 files in %2 ms; %3 via TagLib, %4 bytes read per fast-path file")
+            .arg(n).arg(m_elapsed).arg(m_fallback)
+            .arg(m_fast ? m_bytes / m_fast : 0);
+    if(allocCountEnabled())
+        text += QString(", %1 allocations per track").arg(n ? (double) m_allocs / n : 0.0, 0, 'f', 1);
+    return text;
+}
@@ -0,0 +1,93 @@
+#ifndef LIBRARYSCANNER_H
+#define LIBRARYSCANNER_H
+
+#include <QtCore>
+#include <atomic>
+#include "scanArena.h"
+#include "id3Reader.h"
+
+class trackStore;
+namespace TagLib { class String; namespace MPEG { class File; } }
+
+///////////////////////////////////////////////////////////////////////////////
+///
+/// \class libraryScanner
+/// \brief Reads the tags of a folder tree into a trackStore.
+///
+/// Records are built in the scanner's own arena and moved into the
+/// store in batches, after which the arena is reset and its blocks
+/// reused. A scanner is used by one thread at a time.
+///
+/// With more than one reader the tree is listed first, and each round
+/// gives every reader a batch of files to read on its own thread, with
+/// its own arena; the batches are committed in listing order, so the
+/// store looks the same as after a single-reader scan.
+///
+///////////////////////////////////////////////////////////////////////////////
+
+class libraryScanner
+{
+public:
+    libraryScanner(trackStore *store);
+
+    // counts files read while scanning, for a progress display
+    void        setProgress(std::atomic<int> *files) { m_progress = files; }
+
+    // ends a scan early once *abort is set; what was read is kept
+    void        setAbort(const std::atomic<bool> *abort) { m_abort = abort; }
+    bool        aborted() const {
+        return m_abort && m_abort->load(std::memory_order_relaxed);
+    }
+
+    // files read at once, which bounds the I/O a scan puts on its drive
+    void        setReaders(int n)   { m_readers = qMax(1, n); }
+    int         readers() const     { return m_readers; }
+
+    // scans a folder tree; returns the number of tracks added
+    int         scan(const QString &root);
+
+    // reads one file not in the store; returns its track ID or -1
+    int         addFile(const QString &path);
+
+    // statistics of the last scan()
+    int         files() const       { return m_fast + m_fallback; }
+    int         fallbacks() const   { return m_fallback; }
+    qint64      bytesRead() const   { return m_bytes; }
+    qint64      allocs() const      { return m_allocs; }  // by its own threads
+    qint64      elapsed() const     { return m_elapsed; }
+    QString     report() const;
+
+    // directories visited by the last scan(), in visiting order
+    const QStringList &directories() const { return m_dirs; }
+
+private:
+    typedef QPair<int, QString> scanFile;   // directory, file name
+
+    void        traverseDirs(const QString &path);
+    void        listDirs(const QString &path, QVector<scanFile> *files);
+    void        scanParallel(const QString &root);
+    void        readRange(const QVector<scanFile> *files, int begin, int end);
+    void        readFile(int dir, const QString &name);
+    void        readTags(const QString &path, scanRecord *rec);
+    void        findArtwork(TagLib::MPEG::File *file, scanRecord *rec);
+    void        assignTag(scanString *s, const TagLib::String &text);
+    int         commit();
+
+    trackStore              *m_store;
+    scanArena               m_arena;
+    id3Reader               m_id3;
+    QVector<scanRecord *>   m_records;      // current batch
+    QStringList             m_dirs;         // directories of this scan
+    QString                 m_path;         // reused path buffer
+    std::atomic<int>        *m_progress;    // or NULL
+    const std::atomic<bool> *m_abort;       // or NULL
+    int                     m_readers;
+
+    int         m_fast;
+    int         m_fallback;
+    qint64      m_bytes;
+    qint64      m_allocs;
+    qint64      m_elapsed;
+};
+
+#endif // LIBRARYSCANNER_H
@@ -9,17 +9,49 @@
 
 #include <QApplication>
 #include "MainWindow.h"
+#include "traceRecorder.h"
+#include "metricsExporter.h"
+
+// value of --name <value> or --name=<value>, else of environment variable env
+static QString option(const QStringList &args, const QString &name, const char *env) {
+	QString value = qgetenv(env);
+	for(int i=1; i<args.size(); i++) {
+		if(args[i] == name && i+1 < args.size())
+			value = args[i+1];
+		else if(args[i].startsWith(name + "="))
+			value = args[i].mid(name.size() + 1);
+	}
+	return value;
+}
 
 int main(int argc, char **argv) {
+	// time to the first interactive frame is measured from here
+	QElapsedTimer startup;
+	startup.start();
+
 	// init variables and application font
 	QString	      program = argv[0];
 	QApplication  app(argc, argv);
 
+	// record a trace with --trace <file> or QTUNES_TRACE=<file>
+	QString trace = option(app.arguments(), "--trace", "QTUNES_TRACE");
+	if(!trace.isEmpty())
+		traceRecorder::start(trace);
+
+	// export metrics with --metrics <file|unix:socket> or QTUNES_METRICS
+	QString metrics = option(app.arguments(), "--metrics", "QTUNES_METRICS");
+	int interval = option(app.arguments(), "--metrics-interval", "QTUNES_METRICS_INTERVAL").toInt();
+	QScopedPointer<metricsExporter> exporter;
+	if(!metrics.isEmpty())
+		exporter.reset(new metricsExporter(metrics, interval > 0 ? interval : 15));
+
 	// invoke  MainWindow constructor
-	MainWindow window(program);
+	MainWindow window(program, &startup);
 
 	// display MainWindow
 	window.show();
 
-	return app.exec();
+	int status = app.exec();
+	traceRecorder::stop();
+	return status;
 }
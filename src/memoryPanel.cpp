@@ -0,0 +1,58 @@
+#include "memoryPanel.h"
+#include "traceRecorder.h"
+
+// debug panel showing where the memory goes
+
+
+//Contructor
+memoryPanel::memoryPanel(QWidget *parent)
+    : QDialog(parent) {
+
+    setWindowTitle(tr("Memory Report"));
+
+    // create text view and buttons
+    m_text = new QPlainTextEdit;
+    m_text->setReadOnly(true);
+    m_text->setLineWrapMode(QPlainTextEdit::NoWrap);
+    m_text->setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+    m_refresh = new QPushButton("&Refresh");
+    m_save    = new QPushButton("&Save...");
+
+    // connect buttons to slots
+    connect(m_refresh, SIGNAL(clicked()), this, SIGNAL(refreshRequested()));
+    connect(m_save,    SIGNAL(clicked()), this, SLOT(s_save()));
+
+    //set layout
+    QHBoxLayout *hbox= new QHBoxLayout;
+    QVBoxLayout *vbox= new QVBoxLayout;
+    hbox->addWidget(m_refresh);
+    hbox->addStretch();
+    hbox->addWidget(m_save);
+    vbox->addWidget(m_text);
+    vbox->addLayout(hbox);
+    setLayout(vbox);
+    resize(640, 480);
+}
+
+// the report is a snapshot; take a new one whenever the panel opens
+void memoryPanel::showEvent(QShowEvent *event){
+    emit refreshRequested();
+    QDialog::showEvent(event);
+}
+
+// show a new report
+void memoryPanel::setReport(const memoryReport &report){
+    m_report = report;
+    m_text->setPlainText(report.text());
+}
+
+// write the report to a file for capacity planning
+void memoryPanel::s_save(){
+    TRACE_SLOT("memoryPanel::s_save");
+    QString name = QFileDialog::getSaveFileName(this, "Save Memory Report",
+            QString("memory-%1.txt").arg(QDateTime::currentDateTime().toString("yyyyMMdd-hhmmss")));
+    if(name.isEmpty()) return;
+    if(!m_report.dump(name))
+        QMessageBox::warning(this, "Memory Report",
+                             QString("Cannot write %1").arg(name));
+}
@@ -0,0 +1,36 @@
+#ifndef MEMORYPANEL_H
+#define MEMORYPANEL_H
+
+#include <QtWidgets>
+#include "memoryReport.h"
+
+// dialog showing a memory report; the owner supplies it on request
+class memoryPanel : public QDialog {
+    Q_OBJECT
+
+public:
+    memoryPanel(QWidget *parent = 0);
+
+    void setReport(const memoryReport &report);
+
+signals:
+    void refreshRequested();
+
+protected:
+    void showEvent(QShowEvent *);
+
+private:
+    // Widgets
+    QPlainTextEdit  *m_text;
+    QPushButton     *m_refresh;
+    QPushButton     *m_save;
+
+    memoryReport    m_report;
+
+private slots:
+    // Slots
+    void s_save();
+
+};
+
+#endif
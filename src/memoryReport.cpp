@@ -0,0 +1,135 @@
+#include "memoryReport.h"
+
+#ifdef Q_OS_LINUX
+#include <unistd.h>
+#endif
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// memoryReport::memoryReport:
+//
+// Constructor.
+//
+memoryReport::memoryReport() : m_tracks(0), m_albums(0) {}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// memoryReport::add:
+//
+// Adds one row. Rows are shown in the order they were added.
+//
+void memoryReport::add(const QString &group, const QString &item, qint64 bytes, qint64 count) {
+    row r = { group, item, bytes, count };
+    m_rows << r;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// memoryReport::total:
+//
+// Sums the rows of group, or all rows if group is empty.
+//
+qint64 memoryReport::total(const QString &group) const {
+    qint64 sum = 0;
+    for(int i=0; i<m_rows.size(); i++)
+        if(group.isEmpty() || m_rows[i].group == group)
+            sum += m_rows[i].bytes;
+    return sum;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// memoryReport::residentBytes:
+//
+// Resident size of the process, or -1 where it cannot be read.
+//
+qint64 memoryReport::residentBytes() {
+#ifdef Q_OS_LINUX
+    QFile file("/proc/self/statm");
+    if(!file.open(QIODevice::ReadOnly)) return -1;
+
+    QList<QByteArray> fields = file.readAll().split(' ');
+    bool ok = false;
+    qint64 pages = fields.value(1).toLongLong(&ok);
+    return ok ? pages * sysconf(_SC_PAGESIZE) : -1;
+#else
+    return -1;
+#endif
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// memoryReport::text:
+//
+// Formats the rows as a table with a subtotal per group, followed by
+// the averages used for capacity planning as "key value" lines.
+//
+QString memoryReport::text() const {
+    qint64 all = total();
+
+    QString s;
+    QTextStream out(&s);
+    out << "time " << QDateTime::currentDateTime().toString(Qt::ISODate) << "\n";
+    out << "tracks " << m_tracks << "\n";
+    out << "albums " << m_albums << "\n\n";
+
+    out << qSetFieldWidth(10) << left << "group" << qSetFieldWidth(26) << "item"
+        << right << qSetFieldWidth(10) << "count" << qSetFieldWidth(14) << "bytes"
+        << qSetFieldWidth(8) << "share" << qSetFieldWidth(0) << "\n";
+
+    QString group;
+    for(int i=0; i<=m_rows.size(); i++) {
+        // subtotal when the group changes
+        if(!group.isEmpty() && (i == m_rows.size() || m_rows[i].group != group)) {
+            qint64 sub = total(group);
+            out << qSetFieldWidth(10) << left << group << qSetFieldWidth(26) << "(total)"
+                << right << qSetFieldWidth(10) << "" << qSetFieldWidth(14) << sub
+                << qSetFieldWidth(7) << QString::number(all ? 100.0 * sub / all : 0, 'f', 1)
+                << qSetFieldWidth(0) << "%\n\n";
+        }
+        if(i == m_rows.size()) break;
+
+        const row &r = m_rows[i];
+        group = r.group;
+        out << qSetFieldWidth(10) << left << r.group << qSetFieldWidth(26) << r.item
+            << right << qSetFieldWidth(10) << (r.count >= 0 ? QString::number(r.count) : QString())
+            << qSetFieldWidth(14) << r.bytes
+            << qSetFieldWidth(7) << QString::number(all ? 100.0 * r.bytes / all : 0, 'f', 1)
+            << qSetFieldWidth(0) << "%\n";
+    }
+
+    out << "accounted_bytes " << all << "\n";
+    qint64 resident = residentBytes();
+    if(resident >= 0) {
+        out << "resident_bytes " << resident << "\n";
+        out << "unaccounted_bytes " << resident - all << "\n";
+    }
+
+    // library and table rows scale with tracks, images and textures with albums
+    if(m_tracks > 0) {
+        out << "library_bytes_per_track " << total("library") / m_tracks << "\n";
+        out << "table_bytes_per_track "   << total("table")   / m_tracks << "\n";
+    }
+    if(m_albums > 0) {
+        out << "image_bytes_per_album "   << total("images")   / m_albums << "\n";
+        out << "texture_bytes_per_album " << total("textures") / m_albums << "\n";
+    }
+    return s;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// memoryReport::dump:
+//
+// Writes text() to a file.
+//
+bool memoryReport::dump(const QString &fileName) const {
+    QFile file(fileName);
+    if(!file.open(QIODevice::WriteOnly | QIODevice::Text)) return false;
+    file.write(text().toUtf8());
+    return true;
+}
@@ -0,0 +1,71 @@
+#ifndef MEMORYREPORT_H
+#define MEMORYREPORT_H
+
+#include <QtCore>
+#include <QImage>
+
+///////////////////////////////////////////////////////////////////////////////
+///
+/// \class memoryReport
+/// \brief Estimated memory use, broken down by subsystem.
+///
+/// Each subsystem adds rows of (group, item, bytes, count). Sizes are
+/// estimates from container capacities and Qt's data layouts, not heap
+/// measurements. Strings shared between containers are counted once,
+/// and allocator overhead is ignored. Where the process resident size
+/// is known, the part not covered by any row is shown as well.
+///
+///////////////////////////////////////////////////////////////////////////////
+
+class memoryReport
+{
+public:
+    memoryReport();
+
+    // count is the number of objects behind the bytes, or -1
+    void        add(const QString &group, const QString &item, qint64 bytes, qint64 count = -1);
+
+    // denominators of the per-track and per-album averages
+    void        setTracks(int n)    { m_tracks = n; }
+    void        setAlbums(int n)    { m_albums = n; }
+
+    // bytes of one group, or of all rows
+    qint64      total(const QString &group = QString()) const;
+
+    QString     text() const;
+
+    // resident size of the process, or -1 where it cannot be read
+    static qint64 residentBytes();
+
+    bool        dump(const QString &fileName) const;
+
+    // payload of a string; 0 if it is empty or static
+    static qint64 stringBytes(const QString &s) {
+        return s.isEmpty() ? 0 : (qint64) sizeof(QArrayData) + (s.capacity() + 1) * sizeof(QChar);
+    }
+    static qint64 imageBytes(const QImage &image) {
+        return (qint64) image.bytesPerLine() * image.height();
+    }
+    template <class T> static qint64 vectorBytes(const QVector<T> &v) {
+        return v.capacity() ? (qint64) sizeof(QArrayData) + (qint64) v.capacity() * sizeof(T) : 0;
+    }
+    // nodes and buckets; keys and values that own data are not followed
+    template <class K, class V> static qint64 hashBytes(const QHash<K, V> &h) {
+        qint64 node = sizeof(void *) + sizeof(uint) + sizeof(K) + sizeof(V);
+        return h.size() * ((node + 7) & ~7) + (qint64) h.capacity() * sizeof(void *);
+    }
+
+private:
+    struct row {
+        QString group;
+        QString item;
+        qint64  bytes;
+        qint64  count;
+    };
+
+    QVector<row>    m_rows;
+    int             m_tracks;
+    int             m_albums;
+};
+
+#endif // MEMORYREPORT_H
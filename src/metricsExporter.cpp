@@ -0,0 +1,145 @@
+#include "metricsExporter.h"
+#include "metricsRegistry.h"
+#include "memoryReport.h"
+
+// a connection that sends nothing within this time gets plain text
+const int REQUEST_MS = 200;
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// metricsExporter::metricsExporter:
+//
+// Constructor. Starts the export timer or listens on the socket.
+//
+metricsExporter::metricsExporter(const QString &target, int intervalSecs, QObject *parent)
+    : QObject(parent), m_valid(false), m_timer(NULL), m_server(NULL) {
+    m_uptime.start();
+
+    metricsRegistry *registry = metricsRegistry::instance();
+    m_resident    = registry->gauge("qtunes_resident_bytes", "Resident set size of the process.");
+    m_uptimeGauge = registry->gauge("qtunes_uptime_seconds", "Time since the player started.");
+
+    if(target.startsWith("unix:")) {
+        m_path = target.mid(5);
+        m_server = new QLocalServer(this);
+        QLocalServer::removeServer(m_path);
+        m_valid = m_server->listen(m_path);
+        if(!m_valid)
+            qWarning() << "metrics: cannot listen on" << m_path << m_server->errorString();
+        connect(m_server, SIGNAL(newConnection()), this, SLOT(s_connection()));
+        return;
+    }
+
+    m_path  = target;
+    m_timer = new QTimer(this);
+    connect(m_timer, SIGNAL(timeout()), this, SLOT(s_export()));
+    m_timer->start(qMax(1, intervalSecs) * 1000);
+    m_valid = true;
+    s_export();
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// metricsExporter::~metricsExporter:
+//
+// Destructor. Writes a last file so the final counts are kept.
+//
+metricsExporter::~metricsExporter() {
+    if(m_timer)
+        s_export();
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// metricsExporter::updateProcess:
+//
+// Refreshes the process gauges.
+//
+void metricsExporter::updateProcess() {
+    m_resident->set(memoryReport::residentBytes());
+    m_uptimeGauge->set(m_uptime.elapsed() / 1000.0);
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// metricsExporter::s_export:
+//
+// Slot function that rewrites the file target atomically.
+//
+void metricsExporter::s_export() {
+    updateProcess();
+
+    QSaveFile file(m_path);
+    if(!file.open(QIODevice::WriteOnly) ||
+       file.write(metricsRegistry::instance()->text()) < 0 || !file.commit()) {
+        if(m_valid)
+            qWarning() << "metrics: cannot write" << m_path;
+        m_valid = false;
+        return;
+    }
+    m_valid = true;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// metricsExporter::s_connection:
+//
+// Slot function for a client of the socket target. Waits briefly for
+// a request line; clients that send none are answered anyway.
+//
+void metricsExporter::s_connection() {
+    while(QLocalSocket *socket = m_server->nextPendingConnection()) {
+        connect(socket, SIGNAL(disconnected()), socket, SLOT(deleteLater()));
+        connect(socket, SIGNAL(readyRead()), this, SLOT(s_request()));
+
+        QPointer<QLocalSocket> guard(socket);
+        QTimer::singleShot(REQUEST_MS, this, [this, guard]() {
+            if(guard && !guard->property("answered").toBool())
+                reply(guard);
+        });
+    }
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// metricsExporter::s_request:
+//
+// Slot function for data from a socket client.
+//
+void metricsExporter::s_request() {
+    QLocalSocket *socket = qobject_cast<QLocalSocket *>(sender());
+    if(!socket || socket->property("answered").toBool()) return;
+
+    // an HTTP request is answered once its header is complete
+    QByteArray head = socket->peek(4096);
+    if(head.size() < 3 && QByteArray("GET").startsWith(head))
+        return;
+    if(head.startsWith("GET") && !head.contains("\r\n\r\n") && !head.contains("\n\n"))
+        return;
+    reply(socket);
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// metricsExporter::reply:
+//
+// Writes the current text to a socket client and closes it.
+//
+void metricsExporter::reply(QLocalSocket *socket) {
+    socket->setProperty("answered", true);
+    updateProcess();
+
+    QByteArray body = metricsRegistry::instance()->text();
+    if(socket->bytesAvailable() && socket->readAll().startsWith("GET")) {
+        socket->write("HTTP/1.0 200 OK\r\n"
+                      "Content-Type: text/plain; version=0.0.4\r\n"
+                      "Content-Length: " + QByteArray::number(body.size()) + "\r\n\r\n");
+    }
+    socket->write(body);
+    socket->disconnectFromServer();
+}
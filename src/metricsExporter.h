@@ -0,0 +1,54 @@
+#ifndef METRICSEXPORTER_H
+#define METRICSEXPORTER_H
+
+#include <QtCore>
+#include <QtNetwork>
+
+class metricGauge;
+
+///////////////////////////////////////////////////////////////////////////////
+///
+/// \class metricsExporter
+/// \brief Publishes the metrics registry for a monitoring sidecar.
+///
+/// A file target is rewritten every interval through a temporary file
+/// and a rename, so a node exporter textfile collector never reads a
+/// partial file; use a name ending in .prom. A "unix:" target is a
+/// local socket that answers each connection with the current text,
+/// as an HTTP response if the client sent a GET and as plain text
+/// otherwise. Process gauges (resident size, uptime) are refreshed on
+/// every export.
+///
+///////////////////////////////////////////////////////////////////////////////
+
+class metricsExporter : public QObject
+{
+    Q_OBJECT
+
+public:
+    // target is a file path or unix:<socket path>
+    metricsExporter(const QString &target, int intervalSecs = 15, QObject *parent = 0);
+    ~metricsExporter();
+
+    bool        isValid() const     { return m_valid; }
+
+private slots:
+    void        s_export();
+    void        s_connection();
+    void        s_request();
+
+private:
+    void        updateProcess();
+    void        reply(QLocalSocket *socket);
+
+    QString         m_path;
+    bool            m_valid;
+    QTimer          *m_timer;
+    QLocalServer    *m_server;
+    QElapsedTimer   m_uptime;
+
+    metricGauge     *m_resident;
+    metricGauge     *m_uptimeGauge;
+};
+
+#endif // METRICSEXPORTER_H
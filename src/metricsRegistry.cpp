@@ -0,0 +1,265 @@
+#include "metricsRegistry.h"
+#include <cstring>
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// toBits, fromBits:
+//
+// Store doubles in 64-bit atomics.
+//
+static quint64 toBits(double v) {
+    quint64 bits;
+    memcpy(&bits, &v, sizeof(bits));
+    return bits;
+}
+
+static double fromBits(quint64 bits) {
+    double v;
+    memcpy(&v, &bits, sizeof(v));
+    return v;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// number:
+//
+// Formats a sample value the way Prometheus reads it.
+//
+static QByteArray number(double v) {
+    if(qIsInf(v)) return v > 0 ? "+Inf" : "-Inf";
+    if(qIsNaN(v)) return "NaN";
+    return QByteArray::number(v, 'g', 15);
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// metricGauge::set, metricGauge::value:
+//
+// Stores and loads the value.
+//
+void metricGauge::set(double v) {
+    m_bits.store(toBits(v), std::memory_order_relaxed);
+}
+
+double metricGauge::value() const {
+    return fromBits(m_bits.load(std::memory_order_relaxed));
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// metricHistogram::metricHistogram:
+//
+// Constructor.
+//
+metricHistogram::metricHistogram(const QVector<double> &bounds)
+    : m_bounds(bounds), m_buckets(new std::atomic<quint64>[bounds.size() + 1]),
+      m_sumBits(toBits(0)) {
+    for(int i=0; i<=bounds.size(); i++)
+        m_buckets[i].store(0, std::memory_order_relaxed);
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// metricHistogram::latencyBounds:
+//
+// Buckets for latencies in seconds, about three per decade.
+//
+QVector<double> metricHistogram::latencyBounds() {
+    return QVector<double>() << 0.001 << 0.0025 << 0.005 << 0.01 << 0.025 << 0.05
+                             << 0.1 << 0.25 << 0.5 << 1 << 2.5 << 5 << 10;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// metricHistogram::frameBounds:
+//
+// Buckets for frame times in seconds, doubling up to a 10 fps frame.
+//
+QVector<double> metricHistogram::frameBounds() {
+    return QVector<double>() << 0.001 << 0.002 << 0.004 << 0.008 << 0.016
+                             << 0.033 << 0.066 << 0.1;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// metricHistogram::observe:
+//
+// Counts v in its bucket and adds it to the sum. The sum is updated
+// with a compare-and-swap loop since there is no atomic double add.
+// A reader may see the buckets and sum of slightly different moments.
+//
+void metricHistogram::observe(double v) {
+    int i = 0;
+    while(i < m_bounds.size() && v > m_bounds[i])
+        i++;
+    m_buckets[i].fetch_add(1, std::memory_order_relaxed);
+
+    quint64 old = m_sumBits.load(std::memory_order_relaxed);
+    while(!m_sumBits.compare_exchange_weak(old, toBits(fromBits(old) + v),
+                                           std::memory_order_relaxed))
+        ;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// metricHistogram::sum:
+//
+// Sum of all observations.
+//
+double metricHistogram::sum() const {
+    return fromBits(m_sumBits.load(std::memory_order_relaxed));
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// metricsRegistry::instance:
+//
+// The process-wide registry; never destroyed, so metrics stay valid
+// during static destruction.
+//
+metricsRegistry *metricsRegistry::instance() {
+    static metricsRegistry *registry = new metricsRegistry;
+    return registry;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// metricsRegistry::find:
+//
+// Existing series with name and labels, or NULL. Called with m_lock
+// held.
+//
+metricsRegistry::series *metricsRegistry::find(const char *name, const QString &labels) {
+    QByteArray l = labels.toUtf8();
+    for(int i=0; i<m_series.size(); i++)
+        if(m_series[i].name == name && m_series[i].labels == l)
+            return &m_series[i];
+    return NULL;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// metricsRegistry::counter:
+//
+// Returns the counter name{labels}, creating it on first use.
+//
+metricCounter *metricsRegistry::counter(const char *name, const char *help, const QString &labels) {
+    QMutexLocker locker(&m_lock);
+    if(series *s = find(name, labels)) {
+        Q_ASSERT(s->type == COUNTER);
+        return static_cast<metricCounter *>(s->metric);
+    }
+
+    series s = { name, help, labels.toUtf8(), COUNTER, new metricCounter };
+    m_series << s;
+    return static_cast<metricCounter *>(s.metric);
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// metricsRegistry::gauge:
+//
+// Returns the gauge name{labels}, creating it on first use.
+//
+metricGauge *metricsRegistry::gauge(const char *name, const char *help, const QString &labels) {
+    QMutexLocker locker(&m_lock);
+    if(series *s = find(name, labels)) {
+        Q_ASSERT(s->type == GAUGE);
+        return static_cast<metricGauge *>(s->metric);
+    }
+
+    series s = { name, help, labels.toUtf8(), GAUGE, new metricGauge };
+    m_series << s;
+    return static_cast<metricGauge *>(s.metric);
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// metricsRegistry::histogram:
+//
+// Returns the histogram name{labels}, creating it with bounds on first
+// use.
+//
+metricHistogram *metricsRegistry::histogram(const char *name, const char *help,
+                                            const QString &labels, const QVector<double> &bounds) {
+    QMutexLocker locker(&m_lock);
+    if(series *s = find(name, labels)) {
+        Q_ASSERT(s->type == HISTOGRAM);
+        return static_cast<metricHistogram *>(s->metric);
+    }
+
+    series s = { name, help, labels.toUtf8(), HISTOGRAM, new metricHistogram(bounds) };
+    m_series << s;
+    return static_cast<metricHistogram *>(s.metric);
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// metricsRegistry::text:
+//
+// All series in Prometheus text format. HELP and TYPE are written once
+// per name, before its first series; series of a name are kept
+// together. Histogram buckets are cumulative.
+//
+QByteArray metricsRegistry::text() const {
+    QMutexLocker locker(&m_lock);
+
+    // group by name, keeping the order names were first seen
+    QList<QByteArray> names;
+    for(int i=0; i<m_series.size(); i++)
+        if(!names.contains(m_series[i].name))
+            names << m_series[i].name;
+
+    static const char *types[] = {"counter", "gauge", "histogram"};
+    QByteArray out;
+    for(int n=0; n<names.size(); n++) {
+        bool first = true;
+        for(int i=0; i<m_series.size(); i++) {
+            const series &s = m_series[i];
+            if(s.name != names[n]) continue;
+
+            if(first) {
+                out += "# HELP " + s.name + " " + s.help + "\n";
+                out += "# TYPE " + s.name + " " + types[s.type] + "\n";
+                first = false;
+            }
+
+            QByteArray labels = s.labels.isEmpty() ? QByteArray() : "{" + s.labels + "}";
+            if(s.type == COUNTER) {
+                out += s.name + labels + " " +
+                       QByteArray::number(static_cast<metricCounter *>(s.metric)->value()) + "\n";
+            }
+            else if(s.type == GAUGE) {
+                out += s.name + labels + " " +
+                       number(static_cast<metricGauge *>(s.metric)->value()) + "\n";
+            }
+            else {
+                const metricHistogram *h = static_cast<metricHistogram *>(s.metric);
+                QByteArray prefix = s.labels.isEmpty() ? QByteArray("{") : "{" + s.labels + ",";
+                quint64 cumulative = 0;
+                for(int b=0; b<=h->bounds().size(); b++) {
+                    cumulative += h->bucket(b);
+                    double le = b < h->bounds().size() ? h->bounds()[b] : qInf();
+                    out += s.name + "_bucket" + prefix + "le=\"" + number(le) + "\"} " +
+                           QByteArray::number(cumulative) + "\n";
+                }
+                out += s.name + "_sum" + labels + " " + number(h->sum()) + "\n";
+                // from the buckets, so that it matches +Inf
+                out += s.name + "_count" + labels + " " + QByteArray::number(cumulative) + "\n";
+            }
+        }
+    }
+    return out;
+}
@@ -0,0 +1,101 @@
+#ifndef METRICSREGISTRY_H
+#define METRICSREGISTRY_H
+
+#include <QtCore>
+#include <atomic>
+
+// monotonically increasing count
+class metricCounter
+{
+public:
+    metricCounter() : m_value(0) {}
+
+    void        add(quint64 n = 1)  { m_value.fetch_add(n, std::memory_order_relaxed); }
+    quint64     value() const       { return m_value.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<quint64>    m_value;
+};
+
+// value that goes up and down; stored as the bits of a double
+class metricGauge
+{
+public:
+    metricGauge() : m_bits(0) {}
+
+    void        set(double v);
+    double      value() const;
+
+private:
+    std::atomic<quint64>    m_bits;
+};
+
+// distribution over fixed buckets; observations are lock-free
+class metricHistogram
+{
+public:
+    // bounds are the ascending upper limits of all but the +Inf bucket
+    metricHistogram(const QVector<double> &bounds);
+
+    void        observe(double v);
+
+    const QVector<double> &bounds() const   { return m_bounds; }
+    quint64     bucket(int i) const     { return m_buckets[i].load(std::memory_order_relaxed); }
+    double      sum() const;
+
+    // 1 ms .. 10 s, for latencies in seconds
+    static QVector<double> latencyBounds();
+    // 1 ms .. 100 ms, for frame times in seconds
+    static QVector<double> frameBounds();
+
+private:
+    QVector<double>                 m_bounds;
+    QScopedArrayPointer<std::atomic<quint64>> m_buckets;   // bounds + 1
+    std::atomic<quint64>            m_sumBits;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+///
+/// \class metricsRegistry
+/// \brief Process-wide counters, gauges and histograms.
+///
+/// Metrics are created once by name and labels, usually into a static
+/// pointer at their first use, and live until the process exits, so
+/// hot paths keep the pointer and update it with relaxed atomics and
+/// no lock. Only creation and text() take the registry's lock. text()
+/// uses the Prometheus text exposition format.
+///
+///////////////////////////////////////////////////////////////////////////////
+
+class metricsRegistry
+{
+public:
+    static metricsRegistry *instance();
+
+    // labels are preformatted, e.g. widget="coverflow"; the same name
+    // and labels return the same metric
+    metricCounter   *counter  (const char *name, const char *help, const QString &labels = QString());
+    metricGauge     *gauge    (const char *name, const char *help, const QString &labels = QString());
+    metricHistogram *histogram(const char *name, const char *help, const QString &labels = QString(),
+                               const QVector<double> &bounds = metricHistogram::latencyBounds());
+
+    QByteArray      text() const;
+
+private:
+    enum kind {COUNTER, GAUGE, HISTOGRAM};
+    struct series {
+        QByteArray  name;
+        QByteArray  help;
+        QByteArray  labels;
+        kind        type;
+        void        *metric;
+    };
+
+    metricsRegistry() {}
+    series         *find(const char *name, const QString &labels);
+
+    mutable QMutex      m_lock;
+    QList<series>       m_series;       // in creation order
+};
+
+#endif // METRICSREGISTRY_H
@@ -1,14 +1,19 @@
 #include "openPrompt.h"
+#include "traceRecorder.h"
 #include <QtWidgets>
 //creates the intial case for the prompt and intializes all the variables
 // and layout
 
 
-//Contructor
-openPrompt::openPrompt(){
+//Contructor; the prompt does not block its parent and deletes itself
+openPrompt::openPrompt(QWidget *parent)
+    : QDialog(parent) {
+    setModal(false);
+    setAttribute(Qt::WA_DeleteOnClose);
     
     // create buttons and labels
     label = new QLabel(tr("Do you want to load the previous folder loaded?"));
+    remember_box = new QCheckBox(tr("&Remember my choice"));
     yes = new QPushButton("&Yes");
     yes->setDefault(true);
     no = new QPushButton ("&No");
@@ -23,18 +28,25 @@ openPrompt::openPrompt(){
     hbox->addWidget(no);
     hbox->addWidget(yes);
     vbox->addWidget(label);
+    vbox->addWidget(remember_box);
     vbox->addLayout(hbox);
     setLayout(vbox);   
 }
 
 // load and close if yes is pressed
 void openPrompt::s_yesPressed(){
+    TRACE_SLOT("openPrompt::s_yesPressed");
+    if(remember_box->isChecked())
+        emit remember(true);
     emit load();
     close();
 }
 
 //close if no is pressed
 void openPrompt::s_noPressed(){
+    TRACE_SLOT("openPrompt::s_noPressed");
+    if(remember_box->isChecked())
+        emit remember(false);
     close();
 }
 
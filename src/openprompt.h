@@ -9,17 +9,20 @@ class openPrompt : public QDialog {
     Q_OBJECT
 
 public:
-    openPrompt();
+    openPrompt(QWidget *parent = 0);
 
 private:
     // Widgets
     QLabel      *label;
     QPushButton *yes;
     QPushButton *no;
+    QCheckBox   *remember_box;
 
 signals:
     // Signal
     void load();
+    // the answer, if it should be kept for later starts
+    void remember(bool load);
 
 private slots:
     // Slots
@@ -0,0 +1,357 @@
+#include "playQueue.h"
+#include <random>
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// playQueue::playQueue:
+//
+// Constructor. Starts empty, looping, with a time based seed.
+//
+playQueue::playQueue(QObject *parent)
+    : QObject(parent), m_pos(-1), m_mode(PlayLoop), m_pass(0) {
+    m_seed = (quint32) QDateTime::currentMSecsSinceEpoch();
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// playQueue::setTracks:
+//
+// Replaces the queue. Nothing is current until the caller picks a
+// track or calls next().
+//
+void playQueue::setTracks(const QVector<int> &tracks) {
+    m_tracks = tracks;
+    m_pos    = -1;
+    m_pass   = 0;
+    m_order.clear();
+    m_prevOrder.clear();
+    m_nextOrder.clear();
+    if(m_mode == PlayShuffle)
+        shuffle();
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// playQueue::clear:
+//
+// Empties the queue.
+//
+void playQueue::clear() {
+    setTracks(QVector<int>());
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// playQueue::append:
+//
+// Adds a track at the end of the queue (end of the shuffle order).
+//
+void playQueue::append(int track) {
+    m_tracks.append(track);
+    if(m_mode == PlayShuffle)
+        m_order.append(m_tracks.size() - 1);
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// playQueue::playNext:
+//
+// Adds a track right after the current one.
+//
+void playQueue::playNext(int track) {
+    if(m_mode == PlayShuffle) {
+        m_tracks.append(track);
+        m_order.insert(m_pos + 1, m_tracks.size() - 1);
+    }
+    else
+        m_tracks.insert(m_pos + 1, track);
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// playQueue::indexAt:
+//
+// Maps a play position to a queue index.
+//
+int playQueue::indexAt(int p) const {
+    return m_order.isEmpty() ? p : m_order[p];
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// playQueue::current:
+//
+// Returns the current track ID, or -1 if nothing is current.
+//
+int playQueue::current() const {
+    if(m_pos < 0 || m_pos >= m_tracks.size()) return -1;
+    return m_tracks[indexAt(m_pos)];
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// playQueue::peek:
+//
+// Looks ahead without moving. Returns -1 past the end of a shuffle
+// pass, since the next pass has not been drawn yet.
+//
+int playQueue::peek(int steps) const {
+    int n = m_tracks.size();
+    if(!n) return -1;
+    if(m_mode == PlayRepeatOne) return current();
+
+    int p = m_pos + steps;
+    if(p >= n) {
+        if(m_mode == PlayShuffle) return -1;
+        p %= n;
+    }
+    return m_tracks[indexAt(p)];
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// playQueue::setCurrentIndex:
+//
+// Makes queue index the current one. In shuffle mode the pick is
+// played next in the pass: a track not heard yet swaps places with
+// the one that would have come next, and a track already heard this
+// pass moves to the head of the history. Either way the history stays
+// what was actually played.
+//
+void playQueue::setCurrentIndex(int index) {
+    if(index < 0 || index >= m_tracks.size()) return;
+
+    if(m_order.isEmpty())
+        m_pos = index;
+    else {
+        int p = m_order.indexOf(index);
+        if(p > m_pos) {
+            m_pos++;
+            qSwap(m_order[m_pos], m_order[p]);
+        }
+        else if(p < m_pos)
+            m_order.move(p, m_pos);
+    }
+    emit currentChanged(current());
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// playQueue::setCurrentTrack:
+//
+// Makes the first queue entry holding track the current one.
+//
+bool playQueue::setCurrentTrack(int track) {
+    int index = m_tracks.indexOf(track);
+    if(index < 0) return false;
+    setCurrentIndex(index);
+    return true;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// playQueue::next:
+//
+// Advances one position. A finished shuffle pass draws a new one and
+// keeps the finished one as history, unless previous() stepped back
+// into it, in which case the later pass is taken up again.
+//
+bool playQueue::next() {
+    int n = m_tracks.size();
+    if(!n) return false;
+
+    if(m_mode != PlayRepeatOne || m_pos < 0) {
+        if(++m_pos >= n) {
+            m_pos = 0;
+            if(m_mode == PlayShuffle) {
+                m_prevOrder = m_order;
+                m_pass++;
+                if(m_nextOrder.size() == n)
+                    m_order = m_nextOrder;
+                else
+                    shuffle();
+                m_nextOrder.clear();
+            }
+        }
+    }
+    emit currentChanged(current());
+    return true;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// playQueue::previous:
+//
+// Steps back one position. Loop mode wraps to the end; shuffle mode
+// steps back into the previous pass and stops when there is none.
+//
+bool playQueue::previous() {
+    int n = m_tracks.size();
+    if(!n) return false;
+
+    if(m_mode == PlayShuffle && m_pos <= 0) {
+        // the queue changed size since that pass, or there was none
+        if(m_prevOrder.size() != n) return false;
+        m_nextOrder = m_order;
+        m_order     = m_prevOrder;
+        m_prevOrder.clear();
+        m_pass--;
+        m_pos = n - 1;
+    }
+    else if(m_mode != PlayRepeatOne || m_pos < 0) {
+        if(--m_pos < 0)
+            m_pos = n - 1;
+    }
+    emit currentChanged(current());
+    return true;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// playQueue::setMode:
+//
+// Switches play mode. The current track stays current; turning
+// shuffle on makes it the first entry of the new permutation.
+//
+void playQueue::setMode(PlayMode mode) {
+    if(mode == m_mode) return;
+
+    int index = m_pos >= 0 ? indexAt(m_pos) : -1;
+    m_mode = mode;
+    m_order.clear();
+    m_prevOrder.clear();
+    m_nextOrder.clear();
+    m_pos  = index;
+
+    if(m_mode == PlayShuffle) {
+        m_pass = 0;
+        shuffle();
+        if(index >= 0) {
+            int p = m_order.indexOf(index);
+            qSwap(m_order[0], m_order[p]);
+            m_pos = 0;
+        }
+    }
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// playQueue::setSeed:
+//
+// Sets the shuffle seed. Takes effect at the next permutation.
+//
+void playQueue::setSeed(quint32 seed) {
+    m_seed = seed;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// playQueue::shuffle:
+//
+// Draws the permutation for the current pass (Fisher-Yates). mt19937
+// output is fully specified, so a seed gives the same order everywhere.
+//
+void playQueue::shuffle() {
+    int n = m_tracks.size();
+    m_order.resize(n);
+    for(int i=0; i<n; i++)
+        m_order[i] = i;
+
+    std::mt19937 rng(m_seed + m_pass);
+    for(int i=n-1; i>0; i--)
+        qSwap(m_order[i], m_order[rng() % (i+1)]);
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// playQueue::saveState:
+//
+// Writes tracks, shuffle order and position. A queue holding the whole
+// library in order, as after a load, is written as its length only.
+//
+QByteArray playQueue::saveState() const {
+    QByteArray state;
+    QDataStream out(&state, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_5_0);
+
+    bool identity = true;
+    for(int i=0; i<m_tracks.size() && identity; i++)
+        identity = m_tracks[i] == i;
+
+    out << (qint32) m_mode << m_seed << m_pass << (qint32) m_pos << identity;
+    if(identity)
+        out << (qint32) m_tracks.size();
+    else
+        out << m_tracks;
+    out << m_order;
+    return state;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// playQueue::restoreState:
+//
+// Takes back a saved queue without emitting currentChanged; the caller
+// loads the current track. The queue is left alone if state is bad.
+//
+bool playQueue::restoreState(const QByteArray &state, int trackCount) {
+    QDataStream in(state);
+    in.setVersion(QDataStream::Qt_5_0);
+
+    qint32 mode, pos;
+    quint32 seed, pass;
+    bool identity;
+    QVector<int> tracks, order;
+    in >> mode >> seed >> pass >> pos >> identity;
+    if(identity) {
+        qint32 n;
+        in >> n;
+        if(n < 0 || n > trackCount) return false;
+        tracks.resize(n);
+        for(int i=0; i<n; i++)
+            tracks[i] = i;
+    }
+    else
+        in >> tracks;
+    in >> order;
+    if(in.status() != QDataStream::Ok || mode < PlayLoop || mode > PlayRepeatOne)
+        return false;
+
+    // every ID must be a track, and the order a permutation of the
+    // queue indices, which shuffle needs unless the queue is empty
+    for(int i=0; i<tracks.size(); i++)
+        if(tracks[i] < 0 || tracks[i] >= trackCount) return false;
+    if(!order.isEmpty() && order.size() != tracks.size()) return false;
+    if(order.isEmpty() && mode == PlayShuffle && !tracks.isEmpty()) return false;
+    QBitArray seen(order.size());
+    for(int i=0; i<order.size(); i++) {
+        if(order[i] < 0 || order[i] >= tracks.size() || seen.testBit(order[i])) return false;
+        seen.setBit(order[i]);
+    }
+    if(pos < -1 || pos >= tracks.size()) return false;
+
+    m_tracks = tracks;
+    m_order  = order;
+    m_prevOrder.clear();
+    m_nextOrder.clear();
+    m_pos    = pos;
+    m_mode   = (PlayMode) mode;
+    m_seed   = seed;
+    m_pass   = pass;
+    return true;
+}
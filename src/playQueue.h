@@ -0,0 +1,87 @@
+#ifndef PLAYQUEUE_H
+#define PLAYQUEUE_H
+
+#include <QtCore>
+
+///////////////////////////////////////////////////////////////////////////////
+///
+/// \class playQueue
+/// \brief Ordered list of track IDs to be played.
+///
+/// Tracks are indices into the library. Shuffle is a precomputed
+/// permutation of queue positions, so next/previous are O(1) and walk
+/// back through the history. Picking a track moves it to the next
+/// position of the pass rather than jumping ahead, so nothing is
+/// skipped or heard twice, and the previous pass is kept so that
+/// previous() can step back across a pass boundary. The permutation
+/// depends only on the seed, which makes a shuffled session
+/// reproducible.
+///
+///////////////////////////////////////////////////////////////////////////////
+
+class playQueue : public QObject
+{
+    Q_OBJECT
+
+public:
+    typedef enum {
+        PlayLoop,
+        PlayShuffle,
+        PlayRepeatOne
+    } PlayMode;
+
+    playQueue(QObject *parent = 0);
+
+    // replace the whole queue
+    void        setTracks(const QVector<int> &tracks);
+    void        clear();
+
+    // explicit queueing
+    void        append(int track);
+    void        playNext(int track);
+
+    // current track ID, or -1
+    int         current() const;
+    // track ID that next() would reach after steps calls, or -1
+    int         peek(int steps) const;
+    int         size() const        { return m_tracks.size(); }
+    const QVector<int> &tracks() const { return m_tracks; }
+
+    // make track the current one; returns false if it is not queued
+    bool        setCurrentTrack(int track);
+    void        setCurrentIndex(int index);
+
+    // false if the queue is empty; previous() is also false at the
+    // start of the shuffle history
+    bool        next();
+    bool        previous();
+
+    void        setMode(PlayMode mode);
+    PlayMode    mode() const        { return m_mode; }
+    void        setSeed(quint32 seed);
+    quint32     seed() const        { return m_seed; }
+
+    // whole queue including shuffle history, for session snapshots;
+    // restoreState() rejects track IDs of trackCount or above
+    QByteArray  saveState() const;
+    bool        restoreState(const QByteArray &state, int trackCount);
+
+signals:
+    void        currentChanged(int track);
+
+private:
+    // queue index at play position p
+    int         indexAt(int p) const;
+    void        shuffle();
+
+    QVector<int>    m_tracks;   // track IDs in queue order
+    QVector<int>    m_order;    // shuffled queue indices (empty: in order)
+    QVector<int>    m_prevOrder; // order of the pass before m_order
+    QVector<int>    m_nextOrder; // order of the pass after, once stepped back
+    int             m_pos;      // play position in m_order (or m_tracks)
+    PlayMode        m_mode;
+    quint32         m_seed;
+    quint32         m_pass;     // completed shuffle passes
+};
+
+#endif // PLAYQUEUE_H
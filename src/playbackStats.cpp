@@ -0,0 +1,235 @@
+#include "playbackStats.h"
+#include "traceRecorder.h"
+#include "metricsRegistry.h"
+
+// weight of the newest sample in the decode-ahead moving average
+const double AHEAD_WEIGHT = 0.1;
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// playbackStats::playbackStats:
+//
+// Constructor. Hooks into the player's status signals and probes the
+// decoded audio stream where the backend allows it.
+//
+playbackStats::playbackStats(QMediaPlayer *player, QObject *parent)
+    : QObject(parent), m_player(player) {
+    reset();
+
+    m_probe = new QAudioProbe(this);
+    m_probing = m_probe->setSource(m_player);
+    if(!m_probing)
+        qWarning() << "playback stats: audio probing not supported, block counters disabled";
+
+    connect(m_player, SIGNAL(bufferStatusChanged(int)),
+            this, SLOT(s_bufferStatus(int)));
+    connect(m_player, SIGNAL(mediaStatusChanged(QMediaPlayer::MediaStatus)),
+            this, SLOT(s_mediaStatus(QMediaPlayer::MediaStatus)));
+    connect(m_probe, SIGNAL(audioBufferProbed(const QAudioBuffer &)),
+            this, SLOT(s_probed(const QAudioBuffer &)));
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// playbackStats::reset:
+//
+// Clears all counters.
+//
+void playbackStats::reset() {
+    m_bufferFill    = 0;
+    m_underruns     = 0;
+    m_underrunTotal = 0;
+    m_blocks        = 0;
+    m_blockGapMsSum = 0;
+    m_blockGapMsMax = 0;
+    m_blockAudioMs  = 0;
+    m_decodeAheadMs = 0;
+    m_startupMs     = -1;
+    m_switchMs      = -1;
+    m_underrunClock.invalidate();
+    m_blockClock.invalidate();
+    m_startClock.invalidate();
+    m_switchClock.invalidate();
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// playbackStats::markPlayRequested:
+//
+// Starts the click-to-first-sample clock.
+//
+void playbackStats::markPlayRequested() {
+    m_startClock.start();
+    m_blockClock.invalidate();
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// playbackStats::markTrackSwitch:
+//
+// Starts the track switch clock.
+//
+void playbackStats::markTrackSwitch() {
+    m_switchClock.start();
+    m_blockClock.invalidate();
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// playbackStats::underrunMs:
+//
+// Total time spent stalled, including a stall still in progress.
+//
+qint64 playbackStats::underrunMs() const {
+    qint64 total = m_underrunTotal;
+    if(m_underrunClock.isValid())
+        total += m_underrunClock.elapsed();
+    return total;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// playbackStats::blockGapMsAvg:
+//
+// Average wall time between decoded blocks.
+//
+double playbackStats::blockGapMsAvg() const {
+    return m_blocks ? m_blockGapMsSum / m_blocks : 0.0;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// playbackStats::s_bufferStatus:
+//
+// Slot function recording the player's buffer fill (percent).
+//
+void playbackStats::s_bufferStatus(int percent) {
+    TRACE_SLOT("playbackStats::s_bufferStatus");
+    m_bufferFill = percent;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// playbackStats::s_mediaStatus:
+//
+// Slot function that counts stalls during playback as underruns and
+// times how long they last.
+//
+void playbackStats::s_mediaStatus(QMediaPlayer::MediaStatus status) {
+    TRACE_SLOT("playbackStats::s_mediaStatus");
+    bool playing = m_player->state() == QMediaPlayer::PlayingState;
+
+    metricsRegistry *metrics = metricsRegistry::instance();
+    static metricCounter *underruns = metrics->counter("qtunes_playback_underruns_total",
+            "Stalls during playback.");
+    static metricHistogram *stalls = metrics->histogram("qtunes_playback_underrun_seconds",
+            "Length of stalls during playback.");
+
+    if(status == QMediaPlayer::StalledMedia && playing) {
+        if(!m_underrunClock.isValid()) {
+            m_underruns++;
+            underruns->add();
+            m_underrunClock.start();
+        }
+    }
+    else if(m_underrunClock.isValid()) {
+        qint64 ms = m_underrunClock.elapsed();
+        m_underrunTotal += ms;
+        stalls->observe(ms / 1000.0);
+        m_underrunClock.invalidate();
+    }
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// playbackStats::s_probed:
+//
+// Slot function called for every decoded block on its way to the
+// output. Measures block spacing, how far decoding runs ahead of the
+// playback position and closes the startup and track switch clocks.
+//
+void playbackStats::s_probed(const QAudioBuffer &buffer) {
+    TRACE_SLOT("playbackStats::s_probed");
+    if(m_startClock.isValid()) {
+        static metricHistogram *startup = metricsRegistry::instance()->histogram(
+                "qtunes_playback_start_seconds", "Time from play to the first decoded sample.");
+        m_startupMs = m_startClock.elapsed();
+        startup->observe(m_startupMs / 1000.0);
+        m_startClock.invalidate();
+    }
+    if(m_switchClock.isValid()) {
+        m_switchMs = m_switchClock.elapsed();
+        m_switchClock.invalidate();
+    }
+
+    if(m_blockClock.isValid()) {
+        double ms = m_blockClock.nsecsElapsed() / 1.0e6;
+        m_blocks++;
+        m_blockGapMsSum += ms;
+        if(ms > m_blockGapMsMax) m_blockGapMsMax = ms;
+    }
+    m_blockClock.start();
+    m_blockAudioMs = buffer.duration() / 1000.0;
+
+    // startTime is in microseconds, position in milliseconds
+    double ahead = buffer.startTime() / 1000.0 - m_player->position();
+    if(ahead >= 0)
+        m_decodeAheadMs += AHEAD_WEIGHT * (ahead - m_decodeAheadMs);
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// playbackStats::report:
+//
+// Formats all counters, one per line. Counters that depend on the
+// probe read "n/a" when the backend doesn't support it.
+//
+QString playbackStats::report() const {
+    QString s;
+    QTextStream out(&s);
+    out << "time "               << QDateTime::currentDateTime().toString(Qt::ISODate) << "\n";
+    out << "probe_available "    << (m_probing ? 1 : 0) << "\n";
+    out << "buffer_fill_percent " << m_bufferFill << "\n";
+    out << "underrun_count "     << m_underruns << "\n";
+    out << "underrun_ms "        << underrunMs() << "\n";
+    if(!m_probing) {
+        out << "block_count n/a\n";
+        out << "block_gap_ms_avg n/a\n";
+        out << "block_gap_ms_max n/a\n";
+        out << "block_audio_ms n/a\n";
+        out << "decode_ahead_ms n/a\n";
+        out << "play_to_sample_ms n/a\n";
+        out << "track_switch_ms n/a\n";
+        return s;
+    }
+    out << "block_count "        << m_blocks << "\n";
+    out << "block_gap_ms_avg "   << blockGapMsAvg() << "\n";
+    out << "block_gap_ms_max "   << m_blockGapMsMax << "\n";
+    out << "block_audio_ms "     << m_blockAudioMs << "\n";
+    out << "decode_ahead_ms "    << m_decodeAheadMs << "\n";
+    out << "play_to_sample_ms "  << m_startupMs << "\n";
+    out << "track_switch_ms "    << m_switchMs << "\n";
+    return s;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// playbackStats::dump:
+//
+// Writes report() to a file.
+//
+bool playbackStats::dump(const QString &fileName) const {
+    QFile file(fileName);
+    if(!file.open(QIODevice::WriteOnly | QIODevice::Text)) return false;
+    file.write(report().toUtf8());
+    return true;
+}
@@ -0,0 +1,71 @@
+#ifndef PLAYBACKSTATS_H
+#define PLAYBACKSTATS_H
+
+#include <QtCore>
+#include <QtMultimedia>
+
+class playbackStats : public QObject
+{
+    Q_OBJECT
+
+public:
+    playbackStats(QMediaPlayer *player, QObject *parent = 0);
+
+    // called by the UI right before asking the player to play / switch
+    void        markPlayRequested();
+    void        markTrackSwitch();
+
+    // accessors; the block, decode-ahead and startup counters need
+    // QAudioProbe, which not every media backend supports
+    bool        probing() const         { return m_probing; }
+    int         bufferFill() const      { return m_bufferFill; }
+    int         underruns() const       { return m_underruns; }
+    qint64      underrunMs() const;
+    double      blockGapMsAvg() const;
+    double      blockGapMsMax() const   { return m_blockGapMsMax; }
+    double      decodeAheadMs() const   { return m_decodeAheadMs; }
+    qint64      startupMs() const       { return m_startupMs; }
+    qint64      switchMs() const        { return m_switchMs; }
+
+    // plain "key value" lines suitable for incident reports
+    QString     report() const;
+    bool        dump(const QString &fileName) const;
+
+    void        reset();
+
+private slots:
+    void        s_bufferStatus(int);
+    void        s_mediaStatus(QMediaPlayer::MediaStatus);
+    void        s_probed(const QAudioBuffer &);
+
+private:
+    QMediaPlayer    *m_player;
+    QAudioProbe     *m_probe;
+    bool            m_probing;
+
+    int             m_bufferFill;
+
+    // underruns: stalls while the player should be playing
+    int             m_underruns;
+    qint64          m_underrunTotal;
+    QElapsedTimer   m_underrunClock;
+
+    // wall time between decoded blocks as seen by the probe; tracks
+    // the blocks' audio duration unless decoding falls behind
+    QElapsedTimer   m_blockClock;
+    qint64          m_blocks;
+    double          m_blockGapMsSum;
+    double          m_blockGapMsMax;
+    double          m_blockAudioMs;
+
+    // decoded-ahead position minus reported position
+    double          m_decodeAheadMs;
+
+    // play click / track switch to first decoded sample
+    QElapsedTimer   m_startClock;
+    QElapsedTimer   m_switchClock;
+    qint64          m_startupMs;
+    qint64          m_switchMs;
+};
+
+#endif // PLAYBACKSTATS_H
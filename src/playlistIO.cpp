@@ -0,0 +1,166 @@
+#include "playlistIO.h"
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// playlistReader::playlistReader:
+//
+// Constructor.
+//
+playlistReader::playlistReader()
+    : m_pls(false), m_utf8(true), m_lines(0) {
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// playlistReader::open:
+//
+// Opens a playlist. Plain .m3u files use the local 8-bit encoding,
+// .m3u8 and .pls are read as UTF-8.
+//
+bool playlistReader::open(const QString &fileName) {
+    QString suffix = QFileInfo(fileName).suffix().toLower();
+    m_pls   = suffix == "pls";
+    m_utf8  = suffix != "m3u";
+    m_base  = QFileInfo(fileName).absolutePath();
+    m_lines = 0;
+
+    m_file.setFileName(fileName);
+    return m_file.open(QIODevice::ReadOnly);
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// playlistReader::next:
+//
+// Reads lines until the next entry. M3U comments (#EXTINF etc.) and
+// PLS keys other than FileN are skipped.
+//
+bool playlistReader::next(QString *path) {
+    while(!m_file.atEnd()) {
+        QByteArray line = m_file.readLine().trimmed();
+        m_lines++;
+
+        // drop a UTF-8 byte order mark on the first line
+        if(m_lines == 1 && line.startsWith("\xEF\xBB\xBF"))
+            line.remove(0, 3);
+        if(line.isEmpty()) continue;
+
+        if(m_pls) {
+            if(!line.startsWith("File")) continue;
+            int eq = line.indexOf('=');
+            if(eq < 0) continue;
+            line.remove(0, eq + 1);
+        }
+        else if(line[0] == '#')
+            continue;
+
+        *path = resolve(decode(line));
+        return true;
+    }
+    return false;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// playlistReader::decode:
+//
+// Converts raw line bytes to a string.
+//
+QString playlistReader::decode(const QByteArray &line) const {
+    return m_utf8 ? QString::fromUtf8(line) : QString::fromLocal8Bit(line);
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// playlistReader::resolve:
+//
+// Turns an entry into a clean absolute path. Handles file:// URLs,
+// Windows separators and paths relative to the playlist.
+//
+QString playlistReader::resolve(QString entry) const {
+    if(entry.startsWith("file:", Qt::CaseInsensitive))
+        return QDir::cleanPath(QUrl(entry).toLocalFile());
+
+    entry.replace('\\', '/');
+    if(QDir::isRelativePath(entry))
+        entry = m_base + '/' + entry;
+    return QDir::cleanPath(entry);
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// playlistWriter::playlistWriter:
+//
+// Constructor.
+//
+playlistWriter::playlistWriter()
+    : m_pls(false), m_count(0) {
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// playlistWriter::open:
+//
+// Creates the playlist and writes its header.
+//
+bool playlistWriter::open(const QString &fileName) {
+    QString suffix = QFileInfo(fileName).suffix().toLower();
+    m_pls   = suffix == "pls";
+    m_count = 0;
+
+    m_file.setFileName(fileName);
+    if(!m_file.open(QIODevice::WriteOnly | QIODevice::Text)) return false;
+
+    m_out.setDevice(&m_file);
+    if(suffix == "m3u")
+        m_out.setCodec(QTextCodec::codecForLocale());
+    else
+        m_out.setCodec("UTF-8");
+
+    if(m_pls)
+        m_out << "[playlist]\n";
+    else
+        m_out << "#EXTM3U\n";
+    return true;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// playlistWriter::add:
+//
+// Appends one entry.
+//
+void playlistWriter::add(const QString &path, int seconds, const QString &title) {
+    m_count++;
+    if(m_pls) {
+        m_out << "File"   << m_count << "=" << path  << "\n";
+        m_out << "Title"  << m_count << "=" << title << "\n";
+        m_out << "Length" << m_count << "=" << seconds << "\n";
+    }
+    else {
+        m_out << "#EXTINF:" << seconds << "," << title << "\n";
+        m_out << path << "\n";
+    }
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// playlistWriter::close:
+//
+// Writes the trailer and commits the file.
+//
+bool playlistWriter::close() {
+    if(m_pls) {
+        m_out << "NumberOfEntries=" << m_count << "\n";
+        m_out << "Version=2\n";
+    }
+    m_out.flush();
+    return m_file.commit();
+}
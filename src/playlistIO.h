@@ -0,0 +1,62 @@
+#ifndef PLAYLISTIO_H
+#define PLAYLISTIO_H
+
+#include <QtCore>
+
+///////////////////////////////////////////////////////////////////////////////
+///
+/// \class playlistReader
+/// \brief Streaming reader for M3U, M3U8 and PLS playlists.
+///
+/// Entries are returned one at a time as absolute, cleaned paths, so a
+/// playlist of any length is parsed in constant memory. The format is
+/// chosen by file extension.
+///
+///////////////////////////////////////////////////////////////////////////////
+
+class playlistReader
+{
+public:
+    playlistReader();
+
+    bool        open(const QString &fileName);
+    // fetch the next entry; returns false at end of file
+    bool        next(QString *path);
+    int         lineCount() const   { return m_lines; }
+
+private:
+    QString     decode(const QByteArray &line) const;
+    QString     resolve(QString entry) const;
+
+    QFile       m_file;
+    QString     m_base;     // directory of the playlist
+    bool        m_pls;
+    bool        m_utf8;
+    int         m_lines;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+///
+/// \class playlistWriter
+/// \brief Streaming writer for M3U, M3U8 and PLS playlists.
+///
+///////////////////////////////////////////////////////////////////////////////
+
+class playlistWriter
+{
+public:
+    playlistWriter();
+
+    bool        open(const QString &fileName);
+    // seconds < 0 means unknown length
+    void        add(const QString &path, int seconds, const QString &title);
+    bool        close();
+
+private:
+    QSaveFile   m_file;
+    QTextStream m_out;
+    bool        m_pls;
+    int         m_count;
+};
+
+#endif // PLAYLISTIO_H
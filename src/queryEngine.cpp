@@ -0,0 +1,634 @@
+#include "queryEngine.h"
+#include <algorithm>
+
+// matched values up to which postings are united; above it the
+// tracks are scanned once instead
+const int UNION_MAX = 16;
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// queryEngine::queryEngine:
+//
+// Constructor. Indexes are built on first use.
+//
+queryEngine::queryEngine(const trackStore *store)
+    : m_store(store), m_generation(~Q_UINT64_C(0)), m_pos(0) {
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// queryEngine::update:
+//
+// Drops indexes built for an older library.
+//
+void queryEngine::update() {
+    if(m_generation == m_store->generation()) return;
+
+    m_generation = m_store->generation();
+    m_all = trackBitmap::range(0, m_store->size());
+    for(int f=0; f<COLS; f++) {
+        m_postings[f].clear();
+        m_orders  [f].clear();
+        m_text    [f] = textIndex();
+    }
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// queryEngine::evaluate:
+//
+// Parses and runs a query. Returns false with a message in error if
+// the query is malformed.
+//
+bool queryEngine::evaluate(const QString &query, trackBitmap *result, QString *error) {
+    update();
+
+    if(!tokenize(query, error)) return false;
+    if(m_tokens.size() == 1) {
+        *result = m_all;
+        return true;
+    }
+
+    m_nodes.clear();
+    m_error.clear();
+    m_pos = 0;
+    int root = parseOr();
+    if(root >= 0 && m_tokens[m_pos].type != token::END) {
+        m_error = QString("unexpected \"%1\"").arg(m_tokens[m_pos].text);
+        root = -1;
+    }
+    if(root < 0) {
+        if(error) *error = m_error;
+        return false;
+    }
+
+    *result = run(root);
+    return true;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// queryEngine::tokenize:
+//
+// Splits a query into words, quoted strings, operators and
+// parentheses. A leading '-' or '!' on a term means not; "m:ss" stays
+// one word.
+//
+bool queryEngine::tokenize(const QString &query, QString *error) {
+    static const QString special = "()=!<>:~\"&|";
+
+    m_tokens.clear();
+    int i = 0, n = query.size();
+    while(i < n) {
+        QChar c = query[i];
+        if(c.isSpace()) {
+            i++;
+            continue;
+        }
+
+        token t;
+        if(c == '(' || c == ')') {
+            t.type = c == '(' ? token::OPEN : token::CLOSE;
+            t.text = c;
+            i++;
+        }
+        else if(c == '"') {
+            t.type = token::STRING;
+            for(i++; i<n && query[i] != '"'; i++) {
+                if(query[i] == '\\' && i+1 < n) i++;
+                t.text += query[i];
+            }
+            if(i == n) {
+                if(error) *error = "missing closing quote";
+                return false;
+            }
+            i++;
+        }
+        else if(query.midRef(i, 2) == "==" || query.midRef(i, 2) == "!=" ||
+                query.midRef(i, 2) == "<=" || query.midRef(i, 2) == ">=") {
+            t.type = token::OP;
+            t.text = query.mid(i, 2);
+            i += 2;
+        }
+        else if(special.contains(c) && c != '!') {
+            t.type = token::OP;
+            t.text = c;
+            i++;
+        }
+        else if((c == '-' || c == '!') && i+1 < n && !query[i+1].isSpace()) {
+            t.type = token::OP;
+            t.text = "not";
+            i++;
+        }
+        else {
+            t.type = token::WORD;
+            int start = i;
+            for(; i<n; i++) {
+                QChar d = query[i];
+                if(d.isSpace()) break;
+                bool time = d == ':' && i > start && query[i-1].isDigit() &&
+                            i+1 < n && query[i+1].isDigit();
+                if(special.contains(d) && !time) break;
+            }
+            t.text = query.mid(start, i - start);
+        }
+        m_tokens << t;
+    }
+
+    token end;
+    end.type = token::END;
+    end.text = "end of query";
+    m_tokens << end;
+    return true;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// queryEngine::addNode:
+//
+// Appends an operator node; returns its index.
+//
+int queryEngine::addNode(int type, int left, int right) {
+    node n;
+    n.type   = type;
+    n.left   = left;
+    n.right  = right;
+    n.field  = -1;
+    n.op     = CONTAINS;
+    n.number = 0;
+    m_nodes << n;
+    return m_nodes.size() - 1;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// queryEngine::parseOr:
+//
+// or-expression: and-expressions joined by "or" or "|".
+//
+int queryEngine::parseOr() {
+    int left = parseAnd();
+    while(left >= 0) {
+        const token &t = m_tokens[m_pos];
+        bool isOr = (t.type == token::WORD && !t.text.compare("or", Qt::CaseInsensitive)) ||
+                    (t.type == token::OP && t.text == "|");
+        if(!isOr) break;
+
+        m_pos++;
+        int right = parseAnd();
+        if(right < 0) return -1;
+        left = addNode(OR, left, right);
+    }
+    return left;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// queryEngine::parseAnd:
+//
+// and-expression: terms joined by "and", "&" or nothing at all.
+//
+int queryEngine::parseAnd() {
+    int left = parseUnary();
+    while(left >= 0) {
+        const token &t = m_tokens[m_pos];
+        if((t.type == token::WORD && !t.text.compare("and", Qt::CaseInsensitive)) ||
+           (t.type == token::OP && t.text == "&"))
+            m_pos++;
+        else if(t.type == token::END || t.type == token::CLOSE ||
+                (t.type == token::OP && t.text != "not") ||
+                (t.type == token::WORD && !t.text.compare("or", Qt::CaseInsensitive)))
+            break;
+
+        int right = parseUnary();
+        if(right < 0) return -1;
+        left = addNode(AND, left, right);
+    }
+    return left;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// queryEngine::parseUnary:
+//
+// A term, optionally negated by "not", "-" or "!".
+//
+int queryEngine::parseUnary() {
+    const token &t = m_tokens[m_pos];
+    if((t.type == token::WORD || t.type == token::OP) &&
+       !t.text.compare("not", Qt::CaseInsensitive)) {
+        m_pos++;
+        int child = parseUnary();
+        if(child < 0) return -1;
+        return addNode(NOT, child, -1);
+    }
+    return parsePrimary();
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// queryEngine::parsePrimary:
+//
+// A parenthesised query, a field test or a bare word.
+//
+int queryEngine::parsePrimary() {
+    token t = m_tokens[m_pos];
+
+    if(t.type == token::OPEN) {
+        m_pos++;
+        int inner = parseOr();
+        if(inner < 0) return -1;
+        if(m_tokens[m_pos].type != token::CLOSE) {
+            m_error = "missing )";
+            return -1;
+        }
+        m_pos++;
+        return inner;
+    }
+
+    if(t.type != token::WORD && t.type != token::STRING) {
+        m_error = QString("unexpected \"%1\"").arg(t.text);
+        return -1;
+    }
+    m_pos++;
+
+    // bare word: title, artist or album contains it
+    int field = t.type == token::WORD ? fieldOf(t.text) : -1;
+    const token &next = m_tokens[m_pos];
+    bool test = next.type == token::OP && next.text != "not" &&
+                next.text != "&" && next.text != "|";
+    if(field < 0 || !test) {
+        int n = addNode(MATCH, -1, -1);
+        m_nodes[n].text = t.text;
+        return n;
+    }
+
+    QString op = m_tokens[m_pos++].text;
+    const token &value = m_tokens[m_pos];
+    if(value.type != token::WORD && value.type != token::STRING) {
+        m_error = QString("missing value after \"%1 %2\"").arg(t.text).arg(op);
+        return -1;
+    }
+    m_pos++;
+
+    int n = addNode(MATCH, -1, -1);
+    node &m = m_nodes[n];
+    m.field = field;
+    m.text  = value.text;
+    if(op == "=" || op == "==")     m.op = EQ;
+    else if(op == "!=")             m.op = NE;
+    else if(op == ":" || op == "~") m.op = CONTAINS;
+    else if(op == "<")              m.op = LT;
+    else if(op == "<=")             m.op = LE;
+    else if(op == ">")              m.op = GT;
+    else                            m.op = GE;
+
+    bool number = field == TRACK || field == TIME;
+    if(!number && m.op >= LT) {
+        m_error = QString("\"%1\" only applies to track and time").arg(op);
+        return -1;
+    }
+    if(number && !parseNumber(field, value.text, &m.number)) {
+        m_error = QString("\"%1\" is not a %2").arg(value.text)
+                  .arg(field == TIME ? "time" : "number");
+        return -1;
+    }
+    return n;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// queryEngine::fieldOf:
+//
+// Maps a field name to its column, or -1.
+//
+int queryEngine::fieldOf(const QString &name) {
+    QString s = name.toLower();
+    if(s == "title" || s == "name")                         return TITLE;
+    if(s == "artist")                                       return ARTIST;
+    if(s == "album")                                        return ALBUM;
+    if(s == "genre")                                        return GENRE;
+    if(s == "track")                                        return TRACK;
+    if(s == "time" || s == "duration" || s == "length")     return TIME;
+    return -1;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// queryEngine::parseNumber:
+//
+// Reads a track number, or a time as seconds, m:ss or h:mm:ss.
+//
+bool queryEngine::parseNumber(int field, const QString &text, int *number) {
+    QStringList parts = text.split(':');
+    if(parts.size() > (field == TIME ? 3 : 1)) return false;
+
+    int value = 0;
+    for(int i=0; i<parts.size(); i++) {
+        bool ok;
+        int part = parts[i].toInt(&ok);
+        if(!ok || part < 0) return false;
+        value = value * 60 + part;
+    }
+    *number = value;
+    return true;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// queryEngine::run:
+//
+// Evaluates node n.
+//
+trackBitmap queryEngine::run(int n) {
+    const node &m = m_nodes[n];
+    switch(m.type) {
+    case AND: {
+        trackBitmap left = run(m.left);
+        if(left.isEmpty()) return left;
+        return left & run(m.right);
+    }
+    case OR:
+        return run(m.left) | run(m.right);
+    case NOT:
+        return m_all.andNot(run(m.left));
+    }
+
+    if(m.field < 0)
+        return matchText(TITLE, CONTAINS, m.text) | matchText(ARTIST, CONTAINS, m.text)
+             | matchText(ALBUM, CONTAINS, m.text);
+    if(m.field == TRACK || m.field == TIME)
+        return matchNumber(m.field, m.op, m.number);
+    return matchText(m.field, m.op, m.text);
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// queryEngine::matchText:
+//
+// Tracks whose text field f equals or contains text, ignoring case.
+// Each distinct value is tested once; with three or more characters
+// only the values holding the rarest trigram of text are.
+//
+trackBitmap queryEngine::matchText(int f, int op, const QString &text) {
+    if(op == NE)
+        return m_all.andNot(matchText(f, EQ, text));
+
+    const textIndex &index = textIndexOf(f);
+    QString folded = text.toCaseFolded();
+
+    // candidate value IDs, or all of them if text is too short
+    static const QVector<int> none;
+    const QVector<int> *candidates = NULL;
+    for(int i=0; i+3<=folded.size(); i++) {
+        auto it = index.trigrams.constFind(trigramAt(folded, i));
+        if(it == index.trigrams.constEnd()) {
+            candidates = &none;
+            break;
+        }
+        if(!candidates || it->size() < candidates->size())
+            candidates = &*it;
+    }
+
+    int count = candidates ? candidates->size() : index.folded.size();
+    QBitArray hit(index.folded.size());
+    QVector<int> hits;
+    for(int k=0; k<count; k++) {
+        int id = candidates ? candidates->at(k) : k;
+        const QString &value = index.folded[id];
+        bool match = op == CONTAINS ? value.contains(folded) : value == folded;
+        if(!match) continue;
+
+        hit.setBit(id);
+        if(hits.size() <= UNION_MAX)
+            hits << id;
+    }
+
+    trackBitmap set;
+    if(hits.size() <= UNION_MAX) {
+        for(int i=0; i<hits.size(); i++)
+            set = set | postings(f, hits[i]);
+        return set;
+    }
+
+    for(int i=0; i<m_store->size(); i++)
+        if(hit.testBit(m_store->valueId(i, f)))
+            set.add(i);
+    return set;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// queryEngine::textIndexOf:
+//
+// Case-folds the values of text field f and indexes their trigrams,
+// on first use after the library changed.
+//
+const queryEngine::textIndex &queryEngine::textIndexOf(int f) {
+    textIndex &index = m_text[f];
+    int count = m_store->valueCount(f);
+    if(index.folded.size() == count) return index;
+
+    index.folded.resize(count);
+    index.trigrams.clear();
+    for(int id=0; id<count; id++) {
+        QString folded = m_store->value(f, id).toCaseFolded();
+        for(int i=0; i+3<=folded.size(); i++) {
+            QVector<int> &ids = index.trigrams[trigramAt(folded, i)];
+            if(ids.isEmpty() || ids.last() != id)
+                ids << id;
+        }
+        index.folded[id] = folded;
+    }
+    return index;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// queryEngine::trigramAt:
+//
+// The three UTF-16 units of text from i, packed into one key.
+//
+quint64 queryEngine::trigramAt(const QString &text, int i) {
+    return (quint64) text[i].unicode() << 32 | (quint64) text[i+1].unicode() << 16
+           | text[i+2].unicode();
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// queryEngine::matchNumber:
+//
+// Tracks whose number field f compares to number with op; tracks
+// without a number never match.
+//
+trackBitmap queryEngine::matchNumber(int f, int op, int number) {
+    if(op == NE)
+        return matchNumber(f, GE, 0).andNot(matchNumber(f, EQ, number));
+
+    const QVector<int> &order = numberOrder(f);
+    auto below = [this, f, &order](int value) {
+        int lo = 0, hi = order.size();
+        while(lo < hi) {
+            int mid = (lo + hi) / 2;
+            if(numberOf(order[mid], f) < value) lo = mid + 1;
+            else hi = mid;
+        }
+        return lo;
+    };
+
+    int first = below(0), last = order.size();
+    switch(op) {
+    case EQ:
+    case CONTAINS: first = below(number); last = below(number + 1); break;
+    case LT:       last  = below(number);     break;
+    case LE:       last  = below(number + 1); break;
+    case GT:       first = below(number + 1); break;
+    case GE:       first = below(number);     break;
+    }
+    if(first >= last) return trackBitmap();
+
+    QVector<int> ids(order.constBegin() + first, order.constBegin() + last);
+    std::sort(ids.begin(), ids.end());
+    return trackBitmap::fromSorted(ids.constData(), ids.size());
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// queryEngine::numberOf:
+//
+// Track number or length of a track; -1 if unknown.
+//
+int queryEngine::numberOf(int track, int f) const {
+    return f == TRACK ? m_store->trackNumber(track) : m_store->seconds(track);
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// queryEngine::numberOrder:
+//
+// Returns all tracks sorted by number field f.
+//
+const QVector<int> &queryEngine::numberOrder(int f) {
+    QVector<int> &order = m_orders[f];
+    if(order.size() == m_store->size()) return order;
+
+    order.resize(m_store->size());
+    for(int i=0; i<order.size(); i++)
+        order[i] = i;
+    std::sort(order.begin(), order.end(), [this, f](int a, int b) {
+        int x = numberOf(a, f), y = numberOf(b, f);
+        return x != y ? x < y : a < b;
+    });
+    return order;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// queryEngine::postings:
+//
+// Returns the tracks with value id in text field f. All postings of a
+// field are built in one pass over the library.
+//
+const trackBitmap &queryEngine::postings(int f, int id) {
+    update();
+
+    QVector<trackBitmap> &lists = m_postings[f];
+    if(lists.isEmpty()) {
+        lists.resize(m_store->valueCount(f));
+        for(int i=0; i<m_store->size(); i++)
+            lists[m_store->valueId(i, f)].add(i);
+    }
+    return lists[id];
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// queryEngine::facetCounts:
+//
+// Counts the tracks of result per value of field f.
+//
+QVector<int> queryEngine::facetCounts(int f, const trackBitmap &result) {
+    QVector<int> counts(m_store->valueCount(f), 0);
+    const trackStore *store = m_store;
+    result.forEach([&counts, store, f](int track) {
+        counts[store->valueId(track, f)]++;
+    });
+    return counts;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// queryEngine::albumPostings:
+//
+// Returns the tracks of an album, read off its track ranges.
+//
+trackBitmap queryEngine::albumPostings(int album) const {
+    const QVector<QPair<int,int>> &ranges = m_store->albumInfo(album).ranges;
+
+    trackBitmap set;
+    for(int r=0; r<ranges.size(); r++)
+        for(int i=ranges[r].first; i<ranges[r].second; i++)
+            set.add(i);
+    return set;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// queryEngine::albumCounts:
+//
+// Counts the tracks of result per album.
+//
+QVector<int> queryEngine::albumCounts(const trackBitmap &result) const {
+    QVector<int> counts(m_store->albumCount(), 0);
+    const trackStore *store = m_store;
+    result.forEach([&counts, store](int track) {
+        counts[store->albumOf(track)]++;
+    });
+    return counts;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// queryEngine::bytes:
+//
+// Sums the postings, the number orders, the text indexes and the
+// all-tracks bitmap.
+//
+qint64 queryEngine::bytes() const {
+    qint64 sum = m_all.bytes();
+    for(int f=0; f<COLS; f++) {
+        sum += m_postings[f].capacity() * sizeof(trackBitmap);
+        for(int i=0; i<m_postings[f].size(); i++)
+            sum += m_postings[f][i].bytes();
+        sum += m_orders[f].capacity() * sizeof(int);
+
+        const textIndex &index = m_text[f];
+        sum += index.folded.capacity() * sizeof(QString);
+        for(int i=0; i<index.folded.size(); i++)
+            sum += index.folded[i].capacity() * sizeof(QChar);
+        for(auto it = index.trigrams.constBegin(); it != index.trigrams.constEnd(); ++it)
+            sum += sizeof(quint64) + sizeof(QVector<int>) + it->capacity() * sizeof(int);
+    }
+    return sum;
+}
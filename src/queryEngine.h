@@ -0,0 +1,113 @@
+#ifndef QUERYENGINE_H
+#define QUERYENGINE_H
+
+#include <QtCore>
+#include "trackStore.h"
+#include "trackBitmap.h"
+
+///////////////////////////////////////////////////////////////////////////////
+///
+/// \class queryEngine
+/// \brief Boolean queries over the library, evaluated on bitmaps.
+///
+/// A query combines field tests with and, or, not and parentheses:
+///
+///     genre = Jazz and artist : davis and time > 10:00
+///     (artist = "Miles Davis" or artist = Coltrane) -live
+///
+/// Fields are title, artist, album, genre, track and time. "=" and
+/// "!=" compare whole values, ":" or "~" match a substring (ignoring
+/// case), and "<", "<=", ">", ">=" compare numbers or m:ss times. A
+/// bare word matches title, artist or album; "and" may be left out.
+///
+/// Text tests are resolved on the distinct values of a field, so each
+/// value is looked at once, and turned into the union of the value's
+/// posting bitmaps. Values are case-folded once, and a substring of
+/// three or more characters is only checked against the values that
+/// hold its rarest trigram. Postings, trigrams and number orders are
+/// built on first use and rebuilt when the library changes.
+///
+///////////////////////////////////////////////////////////////////////////////
+
+class queryEngine
+{
+public:
+    queryEngine(const trackStore *store);
+
+    // evaluates query into result; an empty query matches every track
+    bool            evaluate(const QString &query, trackBitmap *result, QString *error);
+
+    // tracks whose field f has value ID id
+    const trackBitmap &postings(int f, int id);
+
+    // number of tracks in result per value ID of field f
+    QVector<int>    facetCounts(int f, const trackBitmap &result);
+
+    // the same for album IDs (see trackStore::albumOf)
+    trackBitmap     albumPostings(int album) const;
+    QVector<int>    albumCounts(const trackBitmap &result) const;
+
+    // memory held by the indexes built so far
+    qint64          bytes() const;
+
+private:
+    enum {AND, OR, NOT, MATCH};                         // node types
+    enum {EQ, NE, CONTAINS, LT, LE, GT, GE};            // operators
+
+    struct node {
+        int     type;
+        int     left;       // child nodes
+        int     right;
+        int     field;      // MATCH: field, or -1 for title/artist/album
+        int     op;
+        QString text;
+        int     number;
+    };
+
+    struct token {
+        enum {END, WORD, STRING, OP, OPEN, CLOSE} type;
+        QString text;
+    };
+
+    // case-folded values of a text field, and the IDs of the values
+    // holding each trigram, ascending
+    struct textIndex {
+        QVector<QString>                folded;
+        QHash<quint64, QVector<int>>    trigrams;
+    };
+
+    // parser
+    bool            tokenize(const QString &query, QString *error);
+    int             parseOr();
+    int             parseAnd();
+    int             parseUnary();
+    int             parsePrimary();
+    int             addNode(int type, int left, int right);
+    static int      fieldOf(const QString &name);
+    static bool     parseNumber(int field, const QString &text, int *number);
+
+    // evaluation
+    void            update();
+    trackBitmap     run(int n);
+    trackBitmap     matchText(int f, int op, const QString &text);
+    const textIndex &textIndexOf(int f);
+    static quint64  trigramAt(const QString &text, int i);
+    trackBitmap     matchNumber(int f, int op, int number);
+    const QVector<int> &numberOrder(int f);
+    int             numberOf(int track, int f) const;
+
+    const trackStore    *m_store;
+    quint64             m_generation;
+
+    QVector<token>      m_tokens;
+    int                 m_pos;
+    QVector<node>       m_nodes;
+    QString             m_error;
+
+    trackBitmap         m_all;
+    QVector<trackBitmap> m_postings[COLS];
+    QVector<int>        m_orders[COLS];     // tracks by number for TRACK, TIME
+    textIndex           m_text[COLS];       // for TITLE, ARTIST, ALBUM, GENRE
+};
+
+#endif // QUERYENGINE_H
@@ -0,0 +1,85 @@
+#include "resultCache.h"
+#include "metricsRegistry.h"
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// resultCache::entry::bytes:
+//
+// Memory held by an entry, used as its cost.
+//
+int resultCache::entry::bytes() const {
+    int n = sizeof(entry) + tracks.size() * sizeof(int);
+    for(int i=0; i<3; i++)
+        n += counts[i].size() * sizeof(int);
+    return n;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// resultCache::resultCache:
+//
+// Constructor. Keeps entries up to maxBytes in total.
+//
+resultCache::resultCache(const trackStore *store, int maxBytes)
+    : m_store(store), m_generation(store->generation()),
+      m_cache(maxBytes) {
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// resultCache::update:
+//
+// Drops entries computed for an older library.
+//
+void resultCache::update() {
+    if(m_generation == m_store->generation()) return;
+
+    m_generation = m_store->generation();
+    m_cache.clear();
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// resultCache::lookup:
+//
+// Returns the entry for key and marks it most recently used.
+//
+const resultCache::entry *resultCache::lookup(const QString &key) {
+    update();
+
+    metricsRegistry *metrics = metricsRegistry::instance();
+    static metricCounter *hit = metrics->counter("qtunes_cache_requests_total",
+            "Cache lookups by cache and outcome.", "cache=\"filter\",result=\"hit\"");
+    static metricCounter *miss = metrics->counter("qtunes_cache_requests_total",
+            "Cache lookups by cache and outcome.", "cache=\"filter\",result=\"miss\"");
+
+    entry *e = m_cache.object(key);
+    (e ? hit : miss)->add();
+    return e;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// resultCache::insert:
+//
+// Stores a copy of e, evicting least recently used entries to stay
+// within the byte limit. Entries larger than the limit are not kept.
+//
+void resultCache::insert(const QString &key, const entry &e) {
+    update();
+    m_cache.insert(key, new entry(e), e.bytes());
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// resultCache::clear:
+//
+// Drops all entries; the counters are kept.
+//
+void resultCache::clear() {
+    m_cache.clear();
+}
@@ -0,0 +1,51 @@
+#ifndef RESULTCACHE_H
+#define RESULTCACHE_H
+
+#include <QtCore>
+#include "trackStore.h"
+
+///////////////////////////////////////////////////////////////////////////////
+///
+/// \class resultCache
+/// \brief Recently shown filter results, least recently used dropped first.
+///
+/// An entry holds what a filter puts on screen: the track IDs in table
+/// order and the per-value counts of the three panels. It is keyed by
+/// the query, the panel picks and the sort column. The cache is bounded
+/// by the bytes its entries take and emptied when the library
+/// generation changes.
+///
+///////////////////////////////////////////////////////////////////////////////
+
+class resultCache
+{
+public:
+    struct entry {
+        QVector<int>    tracks;         // in table order
+        QVector<int>    counts[3];      // genre, artist, album counts
+
+        int             bytes() const;
+    };
+
+    resultCache(const trackStore *store, int maxBytes = 32 << 20);
+
+    // cached entry for key, or NULL; valid until the next insert
+    const entry *lookup(const QString &key);
+
+    // takes a copy of e
+    void        insert(const QString &key, const entry &e);
+
+    void        clear();
+
+    int         bytes()    const    { return m_cache.totalCost(); }
+    int         count()    const    { return m_cache.size(); }
+
+private:
+    void        update();
+
+    const trackStore        *m_store;
+    quint64                 m_generation;
+    QCache<QString, entry>  m_cache;        // cost is bytes
+};
+
+#endif // RESULTCACHE_H
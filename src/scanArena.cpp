@@ -0,0 +1,178 @@
+#include "scanArena.h"
+#include <cstdlib>
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// scanArena::scanArena:
+//
+// Constructor. Blocks are allocated on first use.
+//
+scanArena::scanArena(int blockSize)
+    : m_current(-1), m_used(0), m_bytes(0), m_blockSize(blockSize), m_blockAllocs(0) {
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// scanArena::~scanArena:
+//
+// Destructor. Frees all blocks.
+//
+scanArena::~scanArena() {
+    for(int i=0; i<m_blocks.size(); i++)
+        free(m_blocks[i]);
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// scanArena::alloc:
+//
+// Returns size bytes aligned to align. Moves on to the next block
+// (reusing blocks kept by reset) when the current one is full;
+// oversized requests get a block of their own. The block taken is
+// always placed right after the current one, so kept blocks that were
+// too small for this request stay ahead for the next ones.
+//
+void *scanArena::alloc(int size, int align) {
+    if(m_current >= 0) {
+        int start = (m_used + align - 1) & ~(align - 1);
+        if(start + size <= m_sizes[m_current]) {
+            m_bytes += start + size - m_used;
+            m_used   = start + size;
+            return m_blocks[m_current] + start;
+        }
+    }
+
+    // find the next kept block that is large enough
+    int next = m_current + 1;
+    while(next < m_blocks.size() && m_sizes[next] < size)
+        next++;
+
+    if(next >= m_blocks.size()) {
+        int blockSize = qMax(size, m_blockSize);
+        m_blocks << (char *) malloc(blockSize);
+        m_sizes  << blockSize;
+        m_blockAllocs++;
+        next = m_blocks.size() - 1;
+    }
+
+    // keep blocks in fill order
+    m_blocks.move(next, m_current + 1);
+    m_sizes .move(next, m_current + 1);
+
+    m_current = m_current + 1;
+    m_used    = size;
+    m_bytes  += size;
+    return m_blocks[m_current];
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// scanArena::reserve:
+//
+// Points s at storage for up to capacity bytes: its inline buffer if
+// that is big enough, the arena otherwise.
+//
+char *scanArena::reserve(scanString *s, int capacity) {
+    s->size = 0;
+    if(capacity <= scanString::INLINE) {
+        s->local = true;
+        return s->inl;
+    }
+    s->local = false;
+    char *buffer = (char *) alloc(capacity, 1);
+    s->ptr = buffer;
+    return buffer;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// scanArena::assign:
+//
+// Copies size bytes of UTF-8 into s.
+//
+void scanArena::assign(scanString *s, const char *data, int size) {
+    char *buffer = reserve(s, size);
+    memcpy(buffer, data, size);
+    s->size = size;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// scanArena::reset:
+//
+// Releases everything handed out; blocks are kept for reuse.
+//
+void scanArena::reset() {
+    m_current = m_blocks.isEmpty() ? -1 : 0;
+    m_used    = 0;
+    m_bytes   = 0;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// scanArena::bytesUsed:
+//
+// Bytes handed out since the last reset, including alignment padding
+// but not the unused ends of blocks that were moved past.
+//
+qint64 scanArena::bytesUsed() const {
+    return m_bytes;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// scanArena::assign:
+//
+// Converts text to UTF-8 straight into s, without a temporary
+// QByteArray.
+//
+void scanArena::assign(scanString *s, const QString &text) {
+    const ushort *d = text.utf16();
+    int n = text.size();
+
+    char *out = reserve(s, n * 3);
+    int len = 0;
+    for(int i=0; i<n; i++) {
+        uint c = d[i];
+        if(QChar::isHighSurrogate(c) && i+1 < n && QChar::isLowSurrogate(d[i+1]))
+            c = QChar::surrogateToUcs4(c, d[++i]);
+        len += encodeUtf8(c, out + len);
+    }
+    s->size = len;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// scanArena::encodeUtf8:
+//
+// Writes one code point as UTF-8 (at most 4 bytes).
+//
+int scanArena::encodeUtf8(uint c, char *out) {
+    if(c < 0x80) {
+        out[0] = c;
+        return 1;
+    }
+    if(c < 0x800) {
+        out[0] = 0xC0 | (c >> 6);
+        out[1] = 0x80 | (c & 0x3F);
+        return 2;
+    }
+    if(c < 0x10000) {
+        out[0] = 0xE0 | (c >> 12);
+        out[1] = 0x80 | ((c >> 6) & 0x3F);
+        out[2] = 0x80 | (c & 0x3F);
+        return 3;
+    }
+    out[0] = 0xF0 | (c >> 18);
+    out[1] = 0x80 | ((c >> 12) & 0x3F);
+    out[2] = 0x80 | ((c >> 6) & 0x3F);
+    out[3] = 0x80 | (c & 0x3F);
+    return 4;
+}
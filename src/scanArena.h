@@ -0,0 +1,90 @@
+#ifndef SCANARENA_H
+#define SCANARENA_H
+
+#include <QtCore>
+#include <new>
+
+// UTF-8 string owned by a scanArena; short strings are stored inline
+struct scanString {
+    enum { INLINE = 15 };
+
+    int         size;
+    bool        local;
+    union {
+        char        inl[INLINE + 1];
+        const char *ptr;
+    };
+
+    const char *data() const    { return local ? inl : ptr; }
+    bool        isEmpty() const { return size == 0; }
+    bool        equals(const scanString &other) const {
+        return size == other.size && memcmp(data(), other.data(), size) == 0;
+    }
+};
+
+// one file as read by the scanner; strings live in the scanner's arena
+struct scanRecord {
+    scanString  title;
+    scanString  artist;
+    scanString  album;
+    scanString  albumArtist;    // empty if untagged; the artist is used
+    scanString  genre;
+    scanString  mime;       // of the cover picture
+    scanString  file;       // file name inside directory dir
+    int         dir;
+    int         track;      // -1 if untagged
+    int         seconds;    // -1 if unknown
+    qint64      artOffset;  // -1 if not stored verbatim
+    qint64      artSize;    // 0 if no picture
+};
+
+///////////////////////////////////////////////////////////////////////////////
+///
+/// \class scanArena
+/// \brief Bump allocator for records built during a library scan.
+///
+/// Memory is handed out from large blocks and released all at once by
+/// reset(), which keeps the blocks for the next batch. An arena is
+/// owned by one scanning thread and is not thread-safe.
+///
+///////////////////////////////////////////////////////////////////////////////
+
+class scanArena
+{
+public:
+    scanArena(int blockSize = 64 * 1024);
+    ~scanArena();
+
+    void       *alloc(int size, int align = 8);
+
+    // default-constructed object in the arena (never destroyed)
+    template<class T> T *make() { return new (alloc(sizeof(T), alignof(T))) T(); }
+
+    // writable buffer for up to capacity bytes; caller sets s->size
+    char       *reserve(scanString *s, int capacity);
+    void        assign(scanString *s, const char *data, int size);
+    void        assign(scanString *s, const QString &text);
+
+    // writes code point c as UTF-8; returns the number of bytes
+    static int  encodeUtf8(uint c, char *out);
+
+    void        reset();
+
+    // statistics
+    int         blocks() const      { return m_blocks.size(); }
+    qint64      bytesUsed() const;
+    qint64      blockAllocs() const { return m_blockAllocs; }
+
+private:
+    Q_DISABLE_COPY(scanArena)
+
+    QVector<char *> m_blocks;
+    QVector<int>    m_sizes;
+    int             m_current;      // block being filled
+    int             m_used;         // bytes used in m_current
+    qint64          m_bytes;        // bytes handed out since reset
+    int             m_blockSize;
+    qint64          m_blockAllocs;
+};
+
+#endif // SCANARENA_H
@@ -0,0 +1,185 @@
+#include "sessionState.h"
+#include "trackStore.h"
+
+// identifies a snapshot file
+const quint32 SESSION_MAGIC   = 0x51545353;
+const quint16 SESSION_VERSION = 2;     // 2: library hash
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// sessionState::sessionState:
+//
+// Constructor. Nothing playing, nothing filtered.
+//
+sessionState::sessionState()
+    : position(0), playing(false), volume(100), muted(false),
+      playMode(0), searchField(0), sortColumn(-1), ascending(true),
+      coverPosition(0), coverDirection(1) {
+    facet[0] = facet[1] = facet[2] = -1;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// sessionState::setLibrary:
+//
+// Records root and the hash of its store.
+//
+void sessionState::setLibrary(const QString &dir, const QByteArray &hash) {
+    root        = dir;
+    libraryHash = hash;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// sessionState::matches:
+//
+// True if a store loaded from dir, whose hashLibrary() is hash, is the
+// snapshot's library, so its IDs still hold.
+//
+bool sessionState::matches(const QString &dir, const QByteArray &hash) const {
+    return dir == root && !hash.isEmpty() && hash == libraryHash;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// sessionState::hashLibrary:
+//
+// SHA-1 of everything the snapshot's IDs refer to: the directory
+// table, each track's directory, file name, value IDs and album, and
+// the number of values and albums. A rescan that adds, drops, moves
+// or retags a file changes it.
+//
+QByteArray sessionState::hashLibrary(const trackStore &store) {
+    static const int fields[4] = {TITLE, ARTIST, ALBUM, GENRE};
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+
+    QVector<qint32> counts;
+    counts << store.size() << store.dirCount() << store.albumCount();
+    for(int f=0; f<4; f++)
+        counts << store.valueCount(fields[f]);
+    hash.addData((const char *) counts.constData(), counts.size() * sizeof(qint32));
+
+    for(int d=0; d<store.dirCount(); d++) {
+        QString path = store.dirPath(d);
+        hash.addData((const char *) path.constData(), (path.size() + 1) * sizeof(QChar));
+    }
+    for(int t=0; t<store.size(); t++) {
+        const QString &file = store.fileName(t);
+        qint32 ids[6] = {store.dir(t), store.albumOf(t)};
+        for(int f=0; f<4; f++)
+            ids[2+f] = store.valueId(t, fields[f]);
+        hash.addData((const char *) ids, sizeof(ids));
+        hash.addData((const char *) file.constData(), (file.size() + 1) * sizeof(QChar));
+    }
+    return hash.result();
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// sessionState::encode:
+//
+// Serializes the snapshot; the queue makes up most of it, so the
+// whole is compressed.
+//
+QByteArray sessionState::encode() const {
+    QByteArray bytes;
+    QDataStream out(&bytes, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_5_0);
+
+    out << root << libraryHash;
+    out << trackPath << position << playing << (qint32) volume << muted
+        << (qint32) playMode << queue;
+    out << (qint32) searchField << searchInput << searchText;
+    for(int p=0; p<3; p++)
+        out << (qint32) facet[p];
+    out << (qint32) sortColumn << ascending
+        << (qint32) coverPosition << (qint32) coverDirection;
+
+    QByteArray file;
+    QDataStream header(&file, QIODevice::WriteOnly);
+    header << SESSION_MAGIC << SESSION_VERSION;
+    return file + qCompress(bytes);
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// sessionState::decode:
+//
+// Reads a snapshot made by encode(). Returns false, leaving the state
+// undefined, if bytes are not one.
+//
+bool sessionState::decode(const QByteArray &file) {
+    QDataStream header(file);
+    quint32 magic;
+    quint16 version;
+    header >> magic >> version;
+    if(header.status() != QDataStream::Ok ||
+       magic != SESSION_MAGIC || version != SESSION_VERSION) return false;
+
+    QByteArray bytes = qUncompress(file.mid(sizeof(magic) + sizeof(version)));
+    QDataStream in(bytes);
+    in.setVersion(QDataStream::Qt_5_0);
+
+    qint32 vol, mode, field, sort, cover, direction;
+    in >> root >> libraryHash;
+    in >> trackPath >> position >> playing >> vol >> muted >> mode >> queue;
+    in >> field >> searchInput >> searchText;
+    for(int p=0; p<3; p++) {
+        qint32 id;
+        in >> id;
+        facet[p] = id;
+    }
+    in >> sort >> ascending >> cover >> direction;
+
+    volume         = vol;
+    playMode       = mode;
+    searchField    = field;
+    sortColumn     = sort;
+    coverPosition  = cover;
+    coverDirection = direction;
+    return in.status() == QDataStream::Ok;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// sessionState::defaultPath:
+//
+// Location of the snapshot, next to the library indexes.
+//
+QString sessionState::defaultPath() {
+    QString dir = QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation);
+    QDir().mkpath(dir);
+    return dir + "/session.snapshot";
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// sessionState::write:
+//
+// Replaces the file at path with bytes; a crash leaves the old one.
+//
+bool sessionState::write(const QString &path, const QByteArray &bytes) {
+    QSaveFile file(path);
+    if(!file.open(QIODevice::WriteOnly)) return false;
+    file.write(bytes);
+    return file.commit();
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// sessionState::read:
+//
+// Contents of the file at path, or empty.
+//
+QByteArray sessionState::read(const QString &path) {
+    QFile file(path);
+    if(!file.open(QIODevice::ReadOnly)) return QByteArray();
+    return file.readAll();
+}
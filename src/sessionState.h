@@ -0,0 +1,65 @@
+#ifndef SESSIONSTATE_H
+#define SESSIONSTATE_H
+
+#include <QtCore>
+
+class trackStore;
+
+///////////////////////////////////////////////////////////////////////////////
+///
+/// \class sessionState
+/// \brief Snapshot of what the player was doing, for resuming at startup.
+///
+/// Track, value and album IDs are only meaningful for the library they
+/// were taken from, so the snapshot keeps a hash of that library's
+/// content; matches() tells whether a store hashes the same. A library
+/// restored from its index gets the same IDs back. Otherwise only the
+/// parts kept as text (current track, search) are used.
+///
+///////////////////////////////////////////////////////////////////////////////
+
+struct sessionState
+{
+    sessionState();
+
+    // fingerprint of the library
+    QString     root;
+    QByteArray  libraryHash;        // hashLibrary() of its store
+
+    // playback
+    QString     trackPath;          // empty if nothing was current
+    qint64      position;           // in ms
+    bool        playing;
+    int         volume;
+    bool        muted;
+    int         playMode;           // playQueue::PlayMode
+    QByteArray  queue;              // playQueue::saveState()
+
+    // view
+    int         searchField;        // index of the search combo box
+    QString     searchInput;        // text typed in the search box
+    QString     searchText;         // query it became
+    int         facet[3];           // value ID per panel, or -1
+    int         sortColumn;         // -1 if unsorted
+    bool        ascending;
+    int         coverPosition;      // cover flow album and direction
+    int         coverDirection;
+
+    // fills in the fingerprint of a store loaded from root, given its
+    // hashLibrary(); hashing reads every track, so callers keep it
+    void        setLibrary(const QString &root, const QByteArray &hash);
+    bool        matches(const QString &root, const QByteArray &hash) const;
+
+    // hash of the paths, value IDs and albums of every track of store
+    static QByteArray hashLibrary(const trackStore &store);
+
+    QByteArray  encode() const;
+    bool        decode(const QByteArray &bytes);
+
+    // the snapshot file in the user's data directory
+    static QString defaultPath();
+    static bool    write(const QString &path, const QByteArray &bytes);
+    static QByteArray read(const QString &path);
+};
+
+#endif // SESSIONSTATE_H
@@ -0,0 +1,76 @@
+#include "statsPanel.h"
+#include "playbackStats.h"
+#include "traceRecorder.h"
+#include <QtWidgets>
+
+// debug panel showing live playback counters
+
+
+//Contructor
+statsPanel::statsPanel(playbackStats *stats, QWidget *parent)
+    : QDialog(parent), m_stats(stats) {
+
+    setWindowTitle(tr("Playback Stats"));
+
+    // create text view and buttons
+    m_text = new QPlainTextEdit;
+    m_text->setReadOnly(true);
+    m_save  = new QPushButton("&Save...");
+    m_reset = new QPushButton("&Reset");
+
+    // refresh twice a second while visible
+    m_timer = new QTimer(this);
+    m_timer->setInterval(500);
+
+    // connect buttons to slots
+    connect(m_save,  SIGNAL(clicked()), this, SLOT(s_save()));
+    connect(m_reset, SIGNAL(clicked()), this, SLOT(s_reset()));
+    connect(m_timer, SIGNAL(timeout()), this, SLOT(s_refresh()));
+
+    //set layout
+    QHBoxLayout *hbox= new QHBoxLayout;
+    QVBoxLayout *vbox= new QVBoxLayout;
+    hbox->addWidget(m_reset);
+    hbox->addStretch();
+    hbox->addWidget(m_save);
+    vbox->addWidget(m_text);
+    vbox->addLayout(hbox);
+    setLayout(vbox);
+    resize(360, 300);
+}
+
+// only poll while the panel is shown
+void statsPanel::showEvent(QShowEvent *event){
+    s_refresh();
+    m_timer->start();
+    QDialog::showEvent(event);
+}
+
+void statsPanel::hideEvent(QHideEvent *event){
+    m_timer->stop();
+    QDialog::hideEvent(event);
+}
+
+// show current counters
+void statsPanel::s_refresh(){
+    TRACE_SLOT("statsPanel::s_refresh");
+    m_text->setPlainText(m_stats->report());
+}
+
+// write counters to a file for incident reports
+void statsPanel::s_save(){
+    TRACE_SLOT("statsPanel::s_save");
+    QString name = QFileDialog::getSaveFileName(this, "Save Playback Stats",
+                                                "playback-stats.txt");
+    if(name.isEmpty()) return;
+    if(!m_stats->dump(name))
+        QMessageBox::warning(this, "Playback Stats",
+                             QString("Cannot write %1").arg(name));
+}
+
+// clear counters
+void statsPanel::s_reset(){
+    TRACE_SLOT("statsPanel::s_reset");
+    m_stats->reset();
+    s_refresh();
+}
@@ -0,0 +1,35 @@
+#ifndef STATSPANEL_H
+#define STATSPANEL_H
+
+#include <QtWidgets>
+
+class playbackStats;
+
+class statsPanel : public QDialog {
+    Q_OBJECT
+
+public:
+    statsPanel(playbackStats *stats, QWidget *parent = 0);
+
+protected:
+    void showEvent(QShowEvent *);
+    void hideEvent(QHideEvent *);
+
+private:
+    // Widgets
+    QPlainTextEdit  *m_text;
+    QPushButton     *m_save;
+    QPushButton     *m_reset;
+    QTimer          *m_timer;
+
+    playbackStats   *m_stats;
+
+private slots:
+    // Slots
+    void s_refresh();
+    void s_save();
+    void s_reset();
+
+};
+
+#endif
@@ -0,0 +1,270 @@
+#include <QtTest>
+#include <algorithm>
+#include "playQueue.h"
+
+// tracks and seed used by every shuffle test
+const int     TRACKS = 12;
+const quint32 SEED   = 1234;
+
+///////////////////////////////////////////////////////////////////////////////
+///
+/// \class playQueueTest
+/// \brief Next, previous, picks and pass rollover of playQueue.
+///
+///////////////////////////////////////////////////////////////////////////////
+
+class playQueueTest : public QObject
+{
+    Q_OBJECT
+
+private:
+    // queue of tracks 100.. in shuffle mode with a fixed seed
+    void        shuffled(playQueue *queue) {
+        QVector<int> tracks;
+        for(int i=0; i<TRACKS; i++)
+            tracks.append(100 + i);
+        queue->setSeed(SEED);
+        queue->setMode(playQueue::PlayShuffle);
+        queue->setTracks(tracks);
+    }
+
+    // track IDs reached by calling next() count times
+    QVector<int> walk(playQueue *queue, int count) {
+        QVector<int> played;
+        for(int i=0; i<count; i++) {
+            queue->next();
+            played.append(queue->current());
+        }
+        return played;
+    }
+
+    // true if played holds every queued track exactly once
+    bool        isPass(const QVector<int> &played) {
+        QSet<int> seen;
+        for(int i=0; i<played.size(); i++)
+            seen.insert(played[i]);
+        return played.size() == TRACKS && seen.size() == TRACKS
+               && *std::min_element(played.begin(), played.end()) == 100
+               && *std::max_element(played.begin(), played.end()) == 100 + TRACKS - 1;
+    }
+
+private slots:
+    void        loopWraps();
+    void        shuffleIsReproducible();
+    void        shufflePassPlaysEachOnce();
+    void        previousWalksHistory();
+    void        previousStopsAtStart();
+    void        pickUnheardPlaysNext();
+    void        pickHeardMovesToHistory();
+    void        rolloverKeepsHistory();
+    void        saveRestore();
+    void        restoreRejectsBadOrder();
+};
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// playQueueTest::loopWraps:
+//
+// Loop mode plays in queue order and wraps both ways.
+//
+void playQueueTest::loopWraps() {
+    playQueue queue;
+    queue.setTracks(QVector<int>() << 7 << 8 << 9);
+
+    QCOMPARE(walk(&queue, 4), QVector<int>() << 7 << 8 << 9 << 7);
+    QVERIFY(queue.previous());
+    QCOMPARE(queue.current(), 9);
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// playQueueTest::shuffleIsReproducible:
+//
+// The same seed gives the same passes.
+//
+void playQueueTest::shuffleIsReproducible() {
+    playQueue a, b;
+    shuffled(&a);
+    shuffled(&b);
+    QCOMPARE(walk(&a, 3 * TRACKS), walk(&b, 3 * TRACKS));
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// playQueueTest::shufflePassPlaysEachOnce:
+//
+// Every pass is a permutation of the queue.
+//
+void playQueueTest::shufflePassPlaysEachOnce() {
+    playQueue queue;
+    shuffled(&queue);
+    QVERIFY(isPass(walk(&queue, TRACKS)));
+    QVERIFY(isPass(walk(&queue, TRACKS)));
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// playQueueTest::previousWalksHistory:
+//
+// previous() returns the tracks just played, newest first, and next()
+// then replays the same ones.
+//
+void playQueueTest::previousWalksHistory() {
+    playQueue queue;
+    shuffled(&queue);
+    QVector<int> played = walk(&queue, 5);
+
+    for(int i=3; i>=0; i--) {
+        QVERIFY(queue.previous());
+        QCOMPARE(queue.current(), played[i]);
+    }
+    QCOMPARE(walk(&queue, 4), played.mid(1));
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// playQueueTest::previousStopsAtStart:
+//
+// Without an earlier pass, previous() at the first track does nothing.
+//
+void playQueueTest::previousStopsAtStart() {
+    playQueue queue;
+    shuffled(&queue);
+    int first = walk(&queue, 1).first();
+
+    QVERIFY(!queue.previous());
+    QCOMPARE(queue.current(), first);
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// playQueueTest::pickUnheardPlaysNext:
+//
+// Picking a track not heard yet plays it now, previous() goes back to
+// the track before, and the pass still plays every track once.
+//
+void playQueueTest::pickUnheardPlaysNext() {
+    playQueue queue;
+    shuffled(&queue);
+
+    // pick the track three steps ahead
+    QVector<int> played = walk(&queue, 2);
+    int pick = queue.peek(3);
+    QVERIFY(queue.setCurrentTrack(pick));
+    QCOMPARE(queue.current(), pick);
+    played.append(pick);
+
+    QVERIFY(queue.previous());
+    QCOMPARE(queue.current(), played[1]);
+    queue.next();
+
+    played += walk(&queue, TRACKS - 3);
+    QVERIFY(isPass(played));
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// playQueueTest::pickHeardMovesToHistory:
+//
+// Picking a track already heard replays it without skipping any of
+// the tracks still to come.
+//
+void playQueueTest::pickHeardMovesToHistory() {
+    playQueue queue;
+    shuffled(&queue);
+    QVector<int> played = walk(&queue, 4);
+    QVector<int> ahead;
+    for(int i=1; i<=TRACKS-4; i++)
+        ahead.append(queue.peek(i));
+
+    QVERIFY(queue.setCurrentTrack(played[1]));
+    QCOMPARE(queue.current(), played[1]);
+
+    QVERIFY(queue.previous());
+    QCOMPARE(queue.current(), played[3]);
+    queue.next();
+
+    QCOMPARE(walk(&queue, TRACKS - 4), ahead);
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// playQueueTest::rolloverKeepsHistory:
+//
+// previous() at the start of a pass steps back into the one before,
+// and next() then returns to the same later pass.
+//
+void playQueueTest::rolloverKeepsHistory() {
+    playQueue queue;
+    shuffled(&queue);
+    QVector<int> first  = walk(&queue, TRACKS);
+    QVector<int> second = walk(&queue, 2);
+
+    QVERIFY(queue.previous());
+    QCOMPARE(queue.current(), second[0]);
+    QVERIFY(queue.previous());
+    QCOMPARE(queue.current(), first.last());
+    QVERIFY(queue.previous());
+    QCOMPARE(queue.current(), first[TRACKS-2]);
+
+    QCOMPARE(walk(&queue, 3), QVector<int>() << first.last() << second[0] << second[1]);
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// playQueueTest::saveRestore:
+//
+// A restored queue continues the same pass, and bad state is refused.
+//
+void playQueueTest::saveRestore() {
+    playQueue queue;
+    shuffled(&queue);
+    walk(&queue, 3);
+    QByteArray state = queue.saveState();
+
+    playQueue copy;
+    QVERIFY(copy.restoreState(state, 100 + TRACKS));
+    QCOMPARE(copy.current(), queue.current());
+    QCOMPARE(walk(&copy, TRACKS), walk(&queue, TRACKS));
+
+    QVERIFY(!copy.restoreState(state, 100));
+    QVERIFY(!copy.restoreState(state.left(5), 100 + TRACKS));
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// playQueueTest::restoreRejectsBadOrder:
+//
+// A shuffle order that repeats an index, or is missing in shuffle
+// mode, is refused and leaves the queue as it was.
+//
+void playQueueTest::restoreRejectsBadOrder() {
+    // saveState() layout of three tracks in library order
+    auto state = [](qint32 mode, const QVector<int> &order) {
+        QByteArray bytes;
+        QDataStream out(&bytes, QIODevice::WriteOnly);
+        out.setVersion(QDataStream::Qt_5_0);
+        out << mode << SEED << (quint32) 0 << (qint32) 0 << true << (qint32) 3 << order;
+        return bytes;
+    };
+
+    playQueue queue;
+    QVERIFY(queue.restoreState(state(playQueue::PlayShuffle, QVector<int>() << 2 << 0 << 1), 3));
+    QCOMPARE(queue.current(), 2);
+
+    QVERIFY(!queue.restoreState(state(playQueue::PlayShuffle, QVector<int>() << 2 << 2 << 1), 3));
+    QVERIFY(!queue.restoreState(state(playQueue::PlayShuffle, QVector<int>()), 3));
+    QVERIFY(queue.restoreState(state(playQueue::PlayLoop, QVector<int>()), 3));
+    QCOMPARE(queue.current(), 0);
+}
+
+QTEST_APPLESS_MAIN(playQueueTest)
+#include "playQueueTest.moc"
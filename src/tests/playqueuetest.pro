@@ -0,0 +1,17 @@
+######################################################################
+# Unit tests for the play queue; see playQueueTest.cpp.
+#
+#   qmake playqueuetest.pro && make && ./playqueuetest
+######################################################################
+QT += core testlib
+QT -= gui widgets
+
+CONFIG += console testcase
+CONFIG -= app_bundle
+TEMPLATE = app
+TARGET = playqueuetest
+INCLUDEPATH += ..
+
+# Input
+HEADERS += ../playQueue.h
+SOURCES += playQueueTest.cpp ../playQueue.cpp
@@ -0,0 +1,342 @@
+#include <QtTest>
+#include <algorithm>
+#include <iterator>
+#include <random>
+#include <set>
+#include "queryEngine.h"
+
+typedef std::set<int> idSet;
+
+// IDs per 16-bit container
+const int SPAN = 65536;
+
+///////////////////////////////////////////////////////////////////////////////
+///
+/// \class queryTest
+/// \brief Query parsing and evaluation, and trackBitmap set operations
+///        checked against std::set.
+///
+///////////////////////////////////////////////////////////////////////////////
+
+class queryTest : public QObject
+{
+    Q_OBJECT
+
+private:
+    // count distinct IDs drawn from [first, first + span)
+    idSet       randomSet(std::mt19937 *rng, int first, int span, int count) {
+        idSet ids;
+        while((int) ids.size() < count)
+            ids.insert(first + (*rng)() % span);
+        return ids;
+    }
+
+    QVector<int> toVector(const idSet &ids) {
+        QVector<int> v;
+        v.reserve(ids.size());
+        for(idSet::const_iterator i=ids.begin(); i!=ids.end(); ++i)
+            v << *i;
+        return v;
+    }
+
+    trackBitmap toBitmap(const idSet &ids) {
+        QVector<int> v = toVector(ids);
+        return trackBitmap::fromSorted(v.constData(), v.size());
+    }
+
+    // test sets: sparse (array containers), dense (bitmap containers)
+    // and both kinds in neighbouring containers
+    QList<idSet> sets(std::mt19937 *rng) {
+        QList<idSet> list;
+        list << randomSet(rng, 0, 3 * SPAN, 900);
+        list << randomSet(rng, 0, 2 * SPAN, 20000);
+        idSet mixed = randomSet(rng, 0, SPAN, 9000);
+        idSet sparse = randomSet(rng, SPAN, SPAN, 300);
+        mixed.insert(sparse.begin(), sparse.end());
+        list << mixed;
+        list << idSet();
+        return list;
+    }
+
+    // small library the query tests run on
+    void        buildLibrary(trackStore *store);
+
+    QVector<int> query(queryEngine *engine, const QString &text) {
+        trackBitmap result;
+        QString error;
+        if(!engine->evaluate(text, &result, &error))
+            qWarning() << text << error;
+        return result.toVector();
+    }
+
+private slots:
+    void        bitmapBasics();
+    void        bitmapArrayLimit();
+    void        bitmapOperations();
+    void        bitmapConversions();
+    void        queryMatches_data();
+    void        queryMatches();
+    void        queryErrors_data();
+    void        queryErrors();
+    void        facetCounts();
+};
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// queryTest::buildLibrary:
+//
+// Six tracks; Naima has no track number.
+//
+void queryTest::buildLibrary(trackStore *store) {
+    struct song {
+        const char *title, *artist, *album, *genre;
+        int         track, seconds;
+    };
+    static const song songs[] = {
+        { "So What",            "Miles Davis",   "Kind of Blue", "Jazz",       1, 562 },
+        { "Blue in Green",      "Miles Davis",   "Kind of Blue", "Jazz",       3, 337 },
+        { "Giant Steps",        "John Coltrane", "Giant Steps",  "Jazz",       1, 286 },
+        { "Naima",              "John Coltrane", "Giant Steps",  "Jazz",      -1, 261 },
+        { "Paranoid",           "Black Sabbath", "Paranoid",     "Metal",      2, 168 },
+        { "Blue Monday (live)", "New Order",     "Substance",    "Electronic", 1, 449 },
+    };
+
+    scanArena arena;
+    QVector<scanRecord *> records;
+    for(unsigned i=0; i<sizeof(songs) / sizeof(songs[0]); i++) {
+        scanRecord *rec = arena.make<scanRecord>();
+        rec->dir = 0;
+        arena.assign(&rec->file,        QString("%1.mp3").arg(i));
+        arena.assign(&rec->title,       QString(songs[i].title));
+        arena.assign(&rec->artist,      QString(songs[i].artist));
+        arena.assign(&rec->album,       QString(songs[i].album));
+        arena.assign(&rec->albumArtist, QString());
+        arena.assign(&rec->genre,       QString(songs[i].genre));
+        arena.assign(&rec->mime,        QString());
+        rec->track     = songs[i].track;
+        rec->seconds   = songs[i].seconds;
+        rec->artOffset = -1;
+        rec->artSize   = 0;
+        records << rec;
+    }
+    store->append(QStringList("/music"), records);
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// queryTest::bitmapBasics:
+//
+// Building, membership and counting agree with std::set.
+//
+void queryTest::bitmapBasics() {
+    std::mt19937 rng(7);
+    QList<idSet> list = sets(&rng);
+    for(int s=0; s<list.size(); s++) {
+        trackBitmap set = toBitmap(list[s]);
+        QCOMPARE(set.toVector(), toVector(list[s]));
+        QCOMPARE(set.cardinality(), (int) list[s].size());
+        QCOMPARE(set.isEmpty(), list[s].empty());
+
+        for(int i=0; i<2000; i++) {
+            int id = rng() % (3 * SPAN);
+            QCOMPARE(set.contains(id), list[s].count(id) > 0);
+        }
+    }
+
+    trackBitmap range = trackBitmap::range(SPAN - 10, SPAN + 10);
+    QCOMPARE(range.cardinality(), 20);
+    QVERIFY(range.contains(SPAN - 10) && range.contains(SPAN + 9));
+    QVERIFY(!range.contains(SPAN - 11) && !range.contains(SPAN + 10));
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// queryTest::bitmapArrayLimit:
+//
+// Containers right at and just past the 4096-entry array limit.
+//
+void queryTest::bitmapArrayLimit() {
+    for(int n=4095; n<=4097; n++) {
+        trackBitmap set = trackBitmap::range(0, n);
+        QCOMPARE(set.cardinality(), n);
+        QVERIFY(set.contains(n - 1));
+        QVERIFY(!set.contains(n));
+
+        trackBitmap odd;
+        for(int i=1; i<2*n; i+=2)
+            odd.add(i);
+        QCOMPARE((set & odd).cardinality(), n / 2);
+        QCOMPARE((set | odd).cardinality(), n + (n - n / 2));
+        QCOMPARE(set.andNot(odd).cardinality(), n - n / 2);
+    }
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// queryTest::bitmapOperations:
+//
+// and, or and andNot of every pair of test sets agree with std::set.
+//
+void queryTest::bitmapOperations() {
+    std::mt19937 rng(11);
+    QList<idSet> list = sets(&rng);
+    for(int i=0; i<list.size(); i++) {
+        for(int j=0; j<list.size(); j++) {
+            const idSet &a = list[i], &b = list[j];
+            trackBitmap x = toBitmap(a), y = toBitmap(b);
+
+            idSet both, either, only;
+            std::set_intersection(a.begin(), a.end(), b.begin(), b.end(),
+                                  std::inserter(both, both.end()));
+            std::set_union(a.begin(), a.end(), b.begin(), b.end(),
+                           std::inserter(either, either.end()));
+            std::set_difference(a.begin(), a.end(), b.begin(), b.end(),
+                                std::inserter(only, only.end()));
+
+            QCOMPARE((x & y).toVector(), toVector(both));
+            QCOMPARE((x | y).toVector(), toVector(either));
+            QCOMPARE(x.andNot(y).toVector(), toVector(only));
+            QCOMPARE((x | y).cardinality(), (int) either.size());
+        }
+    }
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// queryTest::bitmapConversions:
+//
+// Two arrays whose union passes the limit become a bitmap; removing
+// most of a bitmap, or intersecting two, turns it back into an array.
+//
+void queryTest::bitmapConversions() {
+    trackBitmap even, odd;
+    for(int i=0; i<6000; i+=2) even.add(i);
+    for(int i=1; i<6000; i+=2) odd.add(i);
+
+    trackBitmap all = even | odd;
+    QCOMPARE(all.cardinality(), 6000);
+    QVERIFY(all.bytes() >= 8192);
+
+    trackBitmap back = all.andNot(odd);
+    QCOMPARE(back.toVector(), even.toVector());
+    QVERIFY(back.bytes() < 8192);
+
+    trackBitmap low = trackBitmap::range(0, 5000), high = trackBitmap::range(3000, 8000);
+    trackBitmap overlap = low & high;
+    QCOMPARE(overlap.toVector(), trackBitmap::range(3000, 5000).toVector());
+    QVERIFY(overlap.bytes() < 8192);
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// queryTest::queryMatches:
+//
+// Queries and the tracks of buildLibrary() they match.
+//
+void queryTest::queryMatches_data() {
+    QTest::addColumn<QString>("text");
+    QTest::addColumn<QVector<int> >("tracks");
+
+    typedef QVector<int> v;
+    QTest::newRow("empty")      << ""                       << (v() << 0 << 1 << 2 << 3 << 4 << 5);
+    QTest::newRow("equals")     << "genre = jazz"           << (v() << 0 << 1 << 2 << 3);
+    QTest::newRow("not equals") << "genre != jazz"          << (v() << 4 << 5);
+    QTest::newRow("contains")   << "artist : davis"         << (v() << 0 << 1);
+    QTest::newRow("bare word")  << "blue"                   << (v() << 0 << 1 << 5);
+    QTest::newRow("upper case") << "BLUE"                   << (v() << 0 << 1 << 5);
+    QTest::newRow("short word") << "an"                     << (v() << 2 << 3 << 4 << 5);
+    QTest::newRow("no trigram") << "xyz"                    << v();
+    QTest::newRow("minus")      << "blue -live"             << (v() << 0 << 1);
+    QTest::newRow("and not")    << "blue and not live"      << (v() << 0 << 1);
+    QTest::newRow("quoted")     << "title = \"blue in green\"" << (v() << 1);
+    QTest::newRow("or")         << "genre = jazz | genre = metal" << (v() << 0 << 1 << 2 << 3 << 4);
+    QTest::newRow("and")        << "artist:davis & track=3" << (v() << 1);
+    QTest::newRow("grouped")    << "(artist = \"Miles Davis\" or artist : coltrane) -naima"
+                                << (v() << 0 << 1 << 2);
+    QTest::newRow("track <")    << "track < 3"              << (v() << 0 << 2 << 4 << 5);
+    QTest::newRow("track !=")   << "track != 1"             << (v() << 1 << 4);
+    QTest::newRow("time >")     << "time > 5:00"            << (v() << 0 << 1 << 5);
+    QTest::newRow("time <=")    << "time <= 4:46"           << (v() << 2 << 3 << 4);
+    QTest::newRow("no match")   << "genre = polka"          << v();
+}
+
+void queryTest::queryMatches() {
+    QFETCH(QString, text);
+    QFETCH(QVector<int>, tracks);
+
+    trackStore store;
+    buildLibrary(&store);
+    queryEngine engine(&store);
+    QCOMPARE(query(&engine, text), tracks);
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// queryTest::queryErrors:
+//
+// Malformed queries and the message they give.
+//
+void queryTest::queryErrors_data() {
+    QTest::addColumn<QString>("text");
+    QTest::addColumn<QString>("error");
+
+    QTest::newRow("open quote")  << "\"kind of"         << "missing closing quote";
+    QTest::newRow("open paren")  << "(genre = jazz"     << "missing )";
+    QTest::newRow("close paren") << "genre = jazz )"    << "unexpected \")\"";
+    QTest::newRow("lone paren")  << ")"                 << "unexpected \")\"";
+    QTest::newRow("dangling or") << "jazz or"           << "unexpected \"end of query\"";
+    QTest::newRow("no value")    << "artist ="          << "missing value after \"artist =\"";
+    QTest::newRow("text <")      << "title < 3"         << "\"<\" only applies to track and time";
+    QTest::newRow("bad number")  << "track > abc"       << "\"abc\" is not a number";
+    QTest::newRow("bad time")    << "time > 1:2:3:4"    << "\"1:2:3:4\" is not a time";
+}
+
+void queryTest::queryErrors() {
+    QFETCH(QString, text);
+    QFETCH(QString, error);
+
+    trackStore store;
+    buildLibrary(&store);
+    queryEngine engine(&store);
+
+    trackBitmap result;
+    QString message;
+    QVERIFY(!engine.evaluate(text, &result, &message));
+    QCOMPARE(message, error);
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// queryTest::facetCounts:
+//
+// Counts per genre of a query result.
+//
+void queryTest::facetCounts() {
+    trackStore store;
+    buildLibrary(&store);
+    queryEngine engine(&store);
+
+    trackBitmap result;
+    QVERIFY(engine.evaluate("blue", &result, NULL));
+    QVector<int> counts = engine.facetCounts(GENRE, result);
+
+    QMap<QString, int> byName;
+    for(int id=0; id<counts.size(); id++)
+        if(counts[id]) byName.insert(store.value(GENRE, id), counts[id]);
+
+    QMap<QString, int> expected;
+    expected.insert("Jazz", 2);
+    expected.insert("Electronic", 1);
+    QCOMPARE(byName, expected);
+}
+
+QTEST_APPLESS_MAIN(queryTest)
+#include "queryTest.moc"
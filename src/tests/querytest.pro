@@ -0,0 +1,18 @@
+######################################################################
+# Unit tests for the query parser and track bitmaps; see queryTest.cpp.
+#
+#   qmake querytest.pro && make && ./querytest
+######################################################################
+QT += core gui testlib
+QT -= widgets
+
+CONFIG += console testcase
+CONFIG -= app_bundle
+TEMPLATE = app
+TARGET = querytest
+INCLUDEPATH += ..
+
+# Input
+HEADERS += ../scanArena.h ../trackStore.h ../memoryReport.h ../trackBitmap.h ../queryEngine.h
+SOURCES += queryTest.cpp \
+           ../scanArena.cpp ../trackStore.cpp ../memoryReport.cpp ../trackBitmap.cpp ../queryEngine.cpp
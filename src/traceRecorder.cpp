@@ -0,0 +1,176 @@
+#include "traceRecorder.h"
+
+// spans kept before further ones are dropped (about 100 MB)
+const int MAX_EVENTS = 1 << 20;
+
+// one finished span
+struct traceEvent {
+    const char  *name;
+    const char  *cat;
+    qint64      begin;      // ns since start
+    qint64      end;
+    int         tid;
+    QString     detail;
+};
+
+std::atomic<bool>   traceRecorder::s_enabled(false);
+
+static QMutex               g_lock;
+static QVector<traceEvent>  g_events;
+static QStringList          g_threads;      // names by trace thread ID
+static QElapsedTimer        g_clock;
+static QString              g_path;
+static int                  g_dropped = 0;
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// threadId:
+//
+// Small per-thread number for the trace; registers the thread's name
+// on first use. Called with g_lock held.
+//
+static int threadId() {
+    static thread_local int id = -1;
+    if(id < 0) {
+        QThread *thread = QThread::currentThread();
+        QString name = thread->objectName();
+        if(QCoreApplication::instance() && thread == QCoreApplication::instance()->thread())
+            name = "main";
+        else if(name.isEmpty())
+            name = QString("thread %1").arg(g_threads.size());
+        id = g_threads.size();
+        g_threads << name;
+    }
+    return id;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// quote:
+//
+// Returns text as a JSON string literal.
+//
+static QByteArray quote(const QString &text) {
+    QByteArray out = "\"";
+    QByteArray utf8 = text.toUtf8();
+    for(int i=0; i<utf8.size(); i++) {
+        char c = utf8[i];
+        if(c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        }
+        else if((uchar) c < 0x20)
+            out += "\\u" + QByteArray::number((uchar) c, 16).rightJustified(4, '0');
+        else
+            out += c;
+    }
+    return out + '"';
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// traceRecorder::start:
+//
+// Clears earlier spans and starts recording.
+//
+void traceRecorder::start(const QString &path) {
+    QMutexLocker locker(&g_lock);
+    g_events.clear();
+    g_events.reserve(4096);
+    g_dropped = 0;
+    g_path = path;
+    g_clock.start();
+    s_enabled.store(true, std::memory_order_relaxed);
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// traceRecorder::now:
+//
+// Time on the trace clock.
+//
+qint64 traceRecorder::now() {
+    return g_clock.nsecsElapsed();
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// traceRecorder::complete:
+//
+// Appends a span. Spans ending after stop() are ignored.
+//
+void traceRecorder::complete(const char *name, const char *cat,
+                             qint64 begin, qint64 end, const QString &detail) {
+    QMutexLocker locker(&g_lock);
+    if(!isEnabled()) return;
+    if(g_events.size() >= MAX_EVENTS) {
+        g_dropped++;
+        return;
+    }
+
+    traceEvent event = { name, cat, begin, end, threadId(), detail };
+    g_events << event;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// traceRecorder::stop:
+//
+// Stops recording and writes the spans as complete ("X") events, plus
+// thread names as metadata. Times are in microseconds. Returns false if
+// the file cannot be written.
+//
+bool traceRecorder::stop() {
+    QMutexLocker locker(&g_lock);
+    if(!isEnabled()) return true;
+    s_enabled.store(false, std::memory_order_relaxed);
+
+    QSaveFile file(g_path);
+    if(!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "trace: cannot write" << g_path;
+        return false;
+    }
+
+    QByteArray pid = QByteArray::number(QCoreApplication::applicationPid());
+    file.write("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    for(int t=0; t<g_threads.size(); t++) {
+        file.write("{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":" + pid +
+                   ",\"tid\":" + QByteArray::number(t) +
+                   ",\"args\":{\"name\":" + quote(g_threads[t]) + "}},\n");
+    }
+
+    QByteArray line;
+    for(int i=0; i<g_events.size(); i++) {
+        const traceEvent &e = g_events.at(i);
+        line  = "{\"ph\":\"X\",\"name\":\"";
+        line += e.name;
+        line += "\",\"cat\":\"";
+        line += e.cat;
+        line += "\",\"pid\":" + pid + ",\"tid\":" + QByteArray::number(e.tid);
+        line += ",\"ts\":"  + QByteArray::number(e.begin / 1000.0, 'f', 3);
+        line += ",\"dur\":" + QByteArray::number((e.end - e.begin) / 1000.0, 'f', 3);
+        if(!e.detail.isEmpty())
+            line += ",\"args\":{\"detail\":" + quote(e.detail) + "}";
+        line += "},\n";
+        file.write(line);
+    }
+
+    // closes the array without a trailing comma
+    file.write("{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":" + pid +
+               ",\"args\":{\"name\":\"qtunes\",\"dropped\":" +
+               QByteArray::number(g_dropped) + "}}\n]}\n");
+
+    int n = g_events.size();
+    g_events.clear();
+    g_events.squeeze();
+    if(!file.commit()) {
+        qWarning() << "trace: cannot write" << g_path;
+        return false;
+    }
+    qInfo() << "trace: wrote" << n << "spans to" << g_path;
+    return true;
+}
@@ -0,0 +1,78 @@
+#ifndef TRACERECORDER_H
+#define TRACERECORDER_H
+
+#include <QtCore>
+#include <atomic>
+
+///////////////////////////////////////////////////////////////////////////////
+///
+/// \class traceRecorder
+/// \brief Collects timed spans and writes them as Chrome trace-event JSON.
+///
+/// Recording is off unless start() was called, for instance from
+/// --trace or QTUNES_TRACE. A span that is not recording costs one
+/// relaxed load. The file opens in chrome://tracing or Perfetto.
+/// Building with CONFIG+=no_trace removes the spans altogether.
+///
+///////////////////////////////////////////////////////////////////////////////
+
+class traceRecorder
+{
+public:
+    // begins recording; the trace is written to path by stop()
+    static void     start(const QString &path);
+    static bool     stop();
+
+    static bool     isEnabled() { return s_enabled.load(std::memory_order_relaxed); }
+
+    // ns since start()
+    static qint64   now();
+
+    // adds a finished span; name and category must be string literals
+    static void     complete(const char *name, const char *cat,
+                             qint64 begin, qint64 end, const QString &detail);
+
+private:
+    static std::atomic<bool>    s_enabled;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+///
+/// \class traceScope
+/// \brief Records the lifetime of a block as one span.
+///
+///////////////////////////////////////////////////////////////////////////////
+
+class traceScope
+{
+public:
+    traceScope(const char *name, const char *cat)
+        : m_name(name), m_cat(cat),
+          m_begin(traceRecorder::isEnabled() ? traceRecorder::now() : -1) {}
+    ~traceScope() {
+        if(m_begin >= 0)
+            traceRecorder::complete(m_name, m_cat, m_begin, traceRecorder::now(), m_detail);
+    }
+
+    bool        isActive() const                { return m_begin >= 0; }
+    void        setDetail(const QString &text)  { m_detail = text; }
+
+private:
+    const char  *m_name;
+    const char  *m_cat;
+    qint64      m_begin;
+    QString     m_detail;
+};
+
+#ifndef QTUNES_NO_TRACE
+#define TRACE_SCOPE(name, cat)  traceScope trace_scope_(name, cat)
+#define TRACE_SLOT(name)        traceScope trace_scope_(name, "slot")
+// text is only evaluated while recording
+#define TRACE_DETAIL(text)      do { if(trace_scope_.isActive()) trace_scope_.setDetail(text); } while(0)
+#else
+#define TRACE_SCOPE(name, cat)
+#define TRACE_SLOT(name)
+#define TRACE_DETAIL(text)
+#endif
+
+#endif // TRACERECORDER_H
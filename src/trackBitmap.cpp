@@ -0,0 +1,378 @@
+#include "trackBitmap.h"
+#include <algorithm>
+
+// most entries kept as an array; above this a bitmap is smaller
+const int ARRAY_MAX = 4096;
+
+// 64-bit words in a bitmap container
+const int WORDS = 1024;
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// trackBitmap::trackBitmap:
+//
+// Constructor. The set is empty.
+//
+trackBitmap::trackBitmap() {
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// trackBitmap::range:
+//
+// Returns the set of IDs first..last-1.
+//
+trackBitmap trackBitmap::range(int first, int last) {
+    trackBitmap set;
+    for(int id=first; id<last; id++)
+        set.add(id);
+    return set;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// trackBitmap::fromSorted:
+//
+// Returns the set of n increasing IDs; repeats are ignored.
+//
+trackBitmap trackBitmap::fromSorted(const int *ids, int n) {
+    trackBitmap set;
+    for(int i=0; i<n; i++)
+        if(!i || ids[i] != ids[i-1])
+            set.add(ids[i]);
+    return set;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// trackBitmap::add:
+//
+// Appends an ID larger than any in the set. An array container turns
+// into a bitmap once it outgrows ARRAY_MAX.
+//
+void trackBitmap::add(int id) {
+    int key = id >> 16;
+    if(m_containers.isEmpty() || m_containers.last().key != key) {
+        container c;
+        c.key  = key;
+        c.card = 0;
+        m_containers << c;
+    }
+
+    container &c = m_containers.last();
+    quint16 low = id & 0xFFFF;
+    if(c.isArray()) {
+        if(c.card < ARRAY_MAX) {
+            c.array << low;
+            c.card++;
+            return;
+        }
+        c.bits = toBits(c);
+        c.array.clear();
+    }
+    c.bits[low >> 6] |= Q_UINT64_C(1) << (low & 63);
+    c.card++;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// trackBitmap::contains:
+//
+// Returns true if id is in the set.
+//
+bool trackBitmap::contains(int id) const {
+    int key = id >> 16;
+    int lo = 0, hi = m_containers.size();
+    while(lo < hi) {
+        int mid = (lo + hi) / 2;
+        if(m_containers[mid].key < key) lo = mid + 1;
+        else hi = mid;
+    }
+    if(lo == m_containers.size() || m_containers[lo].key != key) return false;
+
+    const container &c = m_containers[lo];
+    quint16 low = id & 0xFFFF;
+    if(c.isArray())
+        return std::binary_search(c.array.begin(), c.array.end(), low);
+    return c.bits[low >> 6] & (Q_UINT64_C(1) << (low & 63));
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// trackBitmap::cardinality:
+//
+// Returns the number of IDs in the set.
+//
+int trackBitmap::cardinality() const {
+    int n = 0;
+    for(int c=0; c<m_containers.size(); c++)
+        n += m_containers[c].card;
+    return n;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// trackBitmap::toVector:
+//
+// Returns the IDs in increasing order.
+//
+QVector<int> trackBitmap::toVector() const {
+    QVector<int> ids;
+    ids.reserve(cardinality());
+    forEach([&ids](int id) { ids << id; });
+    return ids;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// trackBitmap::bytes:
+//
+// Returns the memory held by the containers.
+//
+qint64 trackBitmap::bytes() const {
+    qint64 n = m_containers.capacity() * sizeof(container);
+    for(int c=0; c<m_containers.size(); c++)
+        n += m_containers[c].array.capacity() * sizeof(quint16)
+           + m_containers[c].bits.capacity()  * sizeof(quint64);
+    return n;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// trackBitmap::operator&:
+//
+// Intersection. Only containers with the same key are combined.
+//
+trackBitmap trackBitmap::operator&(const trackBitmap &other) const {
+    trackBitmap set;
+    int i = 0, j = 0;
+    while(i < m_containers.size() && j < other.m_containers.size()) {
+        const container &a = m_containers[i];
+        const container &b = other.m_containers[j];
+        if(a.key < b.key) i++;
+        else if(b.key < a.key) j++;
+        else {
+            container c = andContainers(a, b);
+            if(c.card) set.m_containers << c;
+            i++;
+            j++;
+        }
+    }
+    return set;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// trackBitmap::operator|:
+//
+// Union. Containers found in one set only are shared, not copied.
+//
+trackBitmap trackBitmap::operator|(const trackBitmap &other) const {
+    trackBitmap set;
+    int i = 0, j = 0;
+    while(i < m_containers.size() || j < other.m_containers.size()) {
+        if(j == other.m_containers.size() ||
+           (i < m_containers.size() && m_containers[i].key < other.m_containers[j].key))
+            set.m_containers << m_containers[i++];
+        else if(i == m_containers.size() || other.m_containers[j].key < m_containers[i].key)
+            set.m_containers << other.m_containers[j++];
+        else
+            set.m_containers << orContainers(m_containers[i++], other.m_containers[j++]);
+    }
+    return set;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// trackBitmap::andNot:
+//
+// Difference: IDs in this set but not in other.
+//
+trackBitmap trackBitmap::andNot(const trackBitmap &other) const {
+    trackBitmap set;
+    int j = 0;
+    for(int i=0; i<m_containers.size(); i++) {
+        const container &a = m_containers[i];
+        while(j < other.m_containers.size() && other.m_containers[j].key < a.key)
+            j++;
+
+        if(j == other.m_containers.size() || other.m_containers[j].key != a.key)
+            set.m_containers << a;
+        else {
+            container c = andNotContainers(a, other.m_containers[j]);
+            if(c.card) set.m_containers << c;
+        }
+    }
+    return set;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// trackBitmap::andContainers:
+//
+// Intersects two containers of the same key.
+//
+trackBitmap::container trackBitmap::andContainers(const container &a, const container &b) {
+    container c;
+    c.key  = a.key;
+    c.card = 0;
+
+    if(a.isArray() && b.isArray()) {
+        int i = 0, j = 0;
+        while(i < a.array.size() && j < b.array.size()) {
+            if(a.array[i] < b.array[j]) i++;
+            else if(b.array[j] < a.array[i]) j++;
+            else {
+                c.array << a.array[i];
+                i++;
+                j++;
+            }
+        }
+        c.card = c.array.size();
+    }
+    else if(a.isArray() || b.isArray()) {
+        const container &arr = a.isArray() ? a : b;
+        const container &map = a.isArray() ? b : a;
+        for(int i=0; i<arr.array.size(); i++) {
+            quint16 low = arr.array[i];
+            if(map.bits[low >> 6] & (Q_UINT64_C(1) << (low & 63)))
+                c.array << low;
+        }
+        c.card = c.array.size();
+    }
+    else {
+        QVector<quint64> bits(WORDS);
+        for(int w=0; w<WORDS; w++)
+            bits[w] = a.bits[w] & b.bits[w];
+        fromBits(&c, bits);
+    }
+    return c;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// trackBitmap::orContainers:
+//
+// Unites two containers of the same key. Small arrays are merged,
+// anything larger is done on a bitmap.
+//
+trackBitmap::container trackBitmap::orContainers(const container &a, const container &b) {
+    container c;
+    c.key  = a.key;
+    c.card = 0;
+
+    if(a.isArray() && b.isArray() && a.card + b.card <= ARRAY_MAX) {
+        c.array.resize(a.card + b.card);
+        quint16 *end = std::set_union(a.array.begin(), a.array.end(),
+                                      b.array.begin(), b.array.end(), c.array.begin());
+        c.array.resize(end - c.array.begin());
+        c.card = c.array.size();
+        return c;
+    }
+
+    QVector<quint64> bits = toBits(a);
+    if(b.isArray()) {
+        for(int i=0; i<b.array.size(); i++)
+            bits[b.array[i] >> 6] |= Q_UINT64_C(1) << (b.array[i] & 63);
+    }
+    else {
+        for(int w=0; w<WORDS; w++)
+            bits[w] |= b.bits[w];
+    }
+    fromBits(&c, bits);
+    return c;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// trackBitmap::andNotContainers:
+//
+// Removes the entries of b from a.
+//
+trackBitmap::container trackBitmap::andNotContainers(const container &a, const container &b) {
+    container c;
+    c.key  = a.key;
+    c.card = 0;
+
+    if(a.isArray()) {
+        for(int i=0; i<a.array.size(); i++) {
+            quint16 low = a.array[i];
+            bool found = b.isArray()
+                    ? std::binary_search(b.array.begin(), b.array.end(), low)
+                    : (b.bits[low >> 6] & (Q_UINT64_C(1) << (low & 63))) != 0;
+            if(!found) c.array << low;
+        }
+        c.card = c.array.size();
+        return c;
+    }
+
+    QVector<quint64> bits = a.bits;
+    if(b.isArray()) {
+        for(int i=0; i<b.array.size(); i++)
+            bits[b.array[i] >> 6] &= ~(Q_UINT64_C(1) << (b.array[i] & 63));
+    }
+    else {
+        for(int w=0; w<WORDS; w++)
+            bits[w] &= ~b.bits[w];
+    }
+    fromBits(&c, bits);
+    return c;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// trackBitmap::toBits:
+//
+// Returns the container's entries as a bitmap.
+//
+QVector<quint64> trackBitmap::toBits(const container &c) {
+    if(!c.isArray()) return c.bits;
+
+    QVector<quint64> bits(WORDS, 0);
+    for(int i=0; i<c.array.size(); i++)
+        bits[c.array[i] >> 6] |= Q_UINT64_C(1) << (c.array[i] & 63);
+    return bits;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// trackBitmap::fromBits:
+//
+// Stores a bitmap in c, as an array if that is smaller.
+//
+void trackBitmap::fromBits(container *c, const QVector<quint64> &bits) {
+    int card = 0;
+    for(int w=0; w<WORDS; w++)
+        card += qPopulationCount(bits[w]);
+    c->card = card;
+
+    if(card > ARRAY_MAX) {
+        c->bits = bits;
+        c->array.clear();
+        return;
+    }
+
+    c->bits.clear();
+    c->array.reserve(card);
+    for(int w=0; w<WORDS; w++) {
+        quint64 word = bits[w];
+        while(word) {
+            c->array << quint16((w << 6) | qCountTrailingZeroBits(word));
+            word &= word - 1;
+        }
+    }
+}
@@ -0,0 +1,80 @@
+#ifndef TRACKBITMAP_H
+#define TRACKBITMAP_H
+
+#include <QtCore>
+
+///////////////////////////////////////////////////////////////////////////////
+///
+/// \class trackBitmap
+/// \brief Compressed set of track IDs.
+///
+/// Roaring-style layout: IDs are split by their upper 16 bits into
+/// containers, each holding its lower 16 bits either as a sorted array
+/// (up to 4096 entries) or as a 65536-bit bitmap. Sparse sets stay
+/// small and dense ones are intersected a word at a time.
+///
+///////////////////////////////////////////////////////////////////////////////
+
+class trackBitmap
+{
+public:
+    trackBitmap();
+
+    // IDs in [first, last)
+    static trackBitmap  range(int first, int last);
+    static trackBitmap  fromSorted(const int *ids, int n);
+
+    // IDs must be added in increasing order
+    void            add(int id);
+
+    bool            contains(int id) const;
+    bool            isEmpty() const     { return m_containers.isEmpty(); }
+    int             cardinality() const;
+    QVector<int>    toVector() const;
+    qint64          bytes() const;
+
+    trackBitmap     operator&(const trackBitmap &other) const;
+    trackBitmap     operator|(const trackBitmap &other) const;
+    trackBitmap     andNot(const trackBitmap &other) const;
+
+    // calls f(id) for each ID in increasing order
+    template<class F> void forEach(F f) const {
+        for(int c=0; c<m_containers.size(); c++) {
+            const container &k = m_containers[c];
+            int base = k.key << 16;
+            if(k.isArray()) {
+                for(int i=0; i<k.array.size(); i++)
+                    f(base | k.array[i]);
+            }
+            else {
+                for(int w=0; w<k.bits.size(); w++) {
+                    quint64 word = k.bits[w];
+                    while(word) {
+                        f(base | (w << 6) | qCountTrailingZeroBits(word));
+                        word &= word - 1;
+                    }
+                }
+            }
+        }
+    }
+
+private:
+    struct container {
+        int                 key;        // upper 16 bits
+        int                 card;
+        QVector<quint16>    array;      // sorted, if not a bitmap
+        QVector<quint64>    bits;       // 1024 words, if a bitmap
+
+        bool isArray() const { return bits.isEmpty(); }
+    };
+
+    static container    andContainers(const container &a, const container &b);
+    static container    orContainers(const container &a, const container &b);
+    static container    andNotContainers(const container &a, const container &b);
+    static QVector<quint64> toBits(const container &c);
+    static void         fromBits(container *c, const QVector<quint64> &bits);
+
+    QVector<container>  m_containers;   // sorted by key
+};
+
+#endif // TRACKBITMAP_H
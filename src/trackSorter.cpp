@@ -0,0 +1,198 @@
+#include "trackSorter.h"
+#include <QtConcurrent>
+#include <algorithm>
+
+// tracks below which sorting in one thread is faster
+const int PARALLEL_MIN = 32768;
+
+// secondary columns of each column, most significant first
+static const int CHAINS[COLS][4] = {
+    {TITLE,  ARTIST, ALBUM,  TRACK},    // TITLE
+    {TRACK,  ARTIST, ALBUM,  TITLE},    // TRACK
+    {TIME,   TITLE,  -1,     -1   },    // TIME
+    {ARTIST, ALBUM,  TRACK,  TITLE},    // ARTIST
+    {ALBUM,  TRACK,  TITLE,  -1   },    // ALBUM
+    {GENRE,  ARTIST, ALBUM,  TRACK}     // GENRE
+};
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// trackSorter::trackSorter:
+//
+// Constructor. Keys and orders are built on first use.
+//
+trackSorter::trackSorter(const trackStore *store)
+    : m_store(store), m_generation(store->generation()) {
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// trackSorter::update:
+//
+// Drops keys and orders built for an older library.
+//
+void trackSorter::update() {
+    if(m_generation == m_store->generation()) return;
+
+    m_generation = m_store->generation();
+    for(int f=0; f<COLS; f++) {
+        m_keys  [f].clear();
+        m_orders[f].clear();
+    }
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// trackSorter::keys:
+//
+// Returns the sort key of every track for column f. Text columns use
+// the rank of the value's collation key, so comparing two tracks is
+// an integer comparison.
+//
+const QVector<qint32> &trackSorter::keys(int f) {
+    QVector<qint32> &keys = m_keys[f];
+    if(!keys.isEmpty() || m_store->isEmpty()) return keys;
+
+    int n = m_store->size();
+    keys.resize(n);
+
+    if(f == TRACK) {
+        for(int i=0; i<n; i++)
+            keys[i] = m_store->trackNumber(i);
+    }
+    else if(f == TIME) {
+        for(int i=0; i<n; i++)
+            keys[i] = m_store->seconds(i);
+    }
+    else {
+        QVector<int> values = m_store->distinctValues(f);
+        QVector<qint32> rank(m_store->valueCount(f), 0);
+        for(int r=0; r<values.size(); r++)
+            rank[values[r]] = r;
+        for(int i=0; i<n; i++)
+            keys[i] = rank[m_store->valueId(i, f)];
+    }
+    return keys;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// trackSorter::comparator:
+//
+// Builds the comparison for column f and its secondary columns.
+//
+trackSorter::keyLess trackSorter::comparator(int f) {
+    keyLess less;
+    less.count = 0;
+    for(int k=0; k<4 && CHAINS[f][k] >= 0; k++)
+        less.keys[less.count++] = keys(CHAINS[f][k]).constData();
+    return less;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// trackSorter::order:
+//
+// Returns the whole library sorted by column f, sorting it only the
+// first time after a library change.
+//
+const QVector<int> &trackSorter::order(int f) {
+    update();
+
+    QVector<int> &order = m_orders[f];
+    if(order.size() == m_store->size()) return order;
+
+    order.resize(m_store->size());
+    for(int i=0; i<order.size(); i++)
+        order[i] = i;
+    parallelSort(order.data(), order.data() + order.size(), comparator(f));
+    return order;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// trackSorter::sort:
+//
+// Sorts a subset of the library by column f. Large subsets are picked
+// out of the cached full order in one pass; small ones are sorted
+// directly with the same comparison, which gives the same result.
+//
+QVector<int> trackSorter::sort(const QVector<int> &tracks, int f) {
+    update();
+
+    int n = m_store->size();
+    int k = tracks.size();
+    if((qint64) k * 16 < n && m_orders[f].size() != n) {
+        QVector<int> sorted = tracks;
+        parallelSort(sorted.data(), sorted.data() + k, comparator(f));
+        return sorted;
+    }
+
+    QBitArray wanted(n);
+    for(int i=0; i<k; i++)
+        wanted.setBit(tracks[i]);
+
+    const QVector<int> &all = order(f);
+    QVector<int> sorted;
+    sorted.reserve(k);
+    for(int i=0; i<n; i++)
+        if(wanted.testBit(all[i]))
+            sorted << all[i];
+    return sorted;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// trackSorter::parallelSort:
+//
+// Sorts [begin, end) by sorting one slice per core in the thread pool
+// and merging neighbouring slices pairwise, also in the pool.
+//
+void trackSorter::parallelSort(int *begin, int *end, const keyLess &less) {
+    int n     = end - begin;
+    int parts = QThread::idealThreadCount();
+    if(n < PARALLEL_MIN || parts < 2) {
+        std::sort(begin, end, less);
+        return;
+    }
+
+    int slice = (n + parts - 1) / parts;
+    QVector<QPair<int, int> > ranges;
+    for(int i=0; i<n; i+=slice)
+        ranges << qMakePair(i, qMin(i + slice, n));
+
+    QtConcurrent::blockingMap(ranges, [begin, &less](const QPair<int, int> &r) {
+        std::sort(begin + r.first, begin + r.second, less);
+    });
+
+    // merge runs of width, doubling it each pass
+    for(int width=slice; width<n; width*=2) {
+        QVector<int> starts;
+        for(int i=0; i+width<n; i+=2*width)
+            starts << i;
+
+        QtConcurrent::blockingMap(starts, [begin, n, width, &less](int i) {
+            std::inplace_merge(begin + i, begin + i + width,
+                               begin + qMin(i + 2*width, n), less);
+        });
+    }
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// trackSorter::bytes:
+//
+// Sums the sort keys and the cached orders.
+//
+qint64 trackSorter::bytes() const {
+    qint64 sum = 0;
+    for(int f=0; f<COLS; f++)
+        sum += m_keys[f].capacity() * sizeof(qint32) + m_orders[f].capacity() * sizeof(int);
+    return sum;
+}
@@ -0,0 +1,59 @@
+#ifndef TRACKSORTER_H
+#define TRACKSORTER_H
+
+#include <QtCore>
+#include "trackStore.h"
+
+///////////////////////////////////////////////////////////////////////////////
+///
+/// \class trackSorter
+/// \brief Sorts track IDs by a table column.
+///
+/// Each column has a typed key per track (collation rank for text,
+/// numbers for track and time) and a fixed chain of secondary columns,
+/// e.g. artist, album, track. The ascending order of the whole library
+/// is cached per column until the store changes; a subset is sorted by
+/// picking its tracks out of that order. Large sorts run in parallel.
+///
+///////////////////////////////////////////////////////////////////////////////
+
+class trackSorter
+{
+public:
+    trackSorter(const trackStore *store);
+
+    // all tracks in ascending order of column f
+    const QVector<int> &order(int f);
+
+    // tracks in ascending order of column f
+    QVector<int>        sort(const QVector<int> &tracks, int f);
+
+    // memory held by the keys and orders built so far
+    qint64              bytes() const;
+
+private:
+    // compares tracks by a chain of key columns, then by ID
+    struct keyLess {
+        const qint32    *keys[4];
+        int             count;
+
+        bool operator()(int a, int b) const {
+            for(int k=0; k<count; k++)
+                if(keys[k][a] != keys[k][b]) return keys[k][a] < keys[k][b];
+            return a < b;
+        }
+    };
+
+    void                update();
+    const QVector<qint32> &keys(int f);
+    keyLess             comparator(int f);
+
+    static void         parallelSort(int *begin, int *end, const keyLess &less);
+
+    const trackStore    *m_store;
+    quint64             m_generation;
+    QVector<qint32>     m_keys  [COLS];
+    QVector<int>        m_orders[COLS];
+};
+
+#endif // TRACKSORTER_H
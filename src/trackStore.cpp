@@ -0,0 +1,529 @@
+#include "trackStore.h"
+#include "memoryReport.h"
+#include <algorithm>
+#include <atomic>
+
+// records converted at a time when appending another store
+const int BATCH = 1024;
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// nextGeneration:
+//
+// Generations are unique across all stores, so a cache keyed on one
+// also notices when the store it watches is replaced by assignment.
+//
+static quint64 nextGeneration() {
+    static std::atomic<quint64> counter(0);
+    return ++counter;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// trackStore::trackStore:
+//
+// Constructor.
+//
+trackStore::trackStore()
+    : m_generation(nextGeneration()) {
+    m_collator.setCaseSensitivity(Qt::CaseInsensitive);
+    m_mimes    << QString();
+    m_mimeKeys << QByteArray();
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// trackStore::timeString:
+//
+// Formats a length in seconds as m:ss.
+//
+QString trackStore::timeString(int length) {
+    int seconds=length%60;
+    int minutes=length/60;
+
+    if(seconds<10)
+        return QString("%1:0%2").arg(minutes).arg(seconds);
+    else
+        return QString("%1:%2").arg(minutes).arg(seconds);
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// trackStore::dictOf:
+//
+// Maps a text field to its value table.
+//
+int trackStore::dictOf(int f) {
+    switch(f) {
+    case TITLE:  return 0;
+    case ARTIST: return 1;
+    case ALBUM:  return 2;
+    case GENRE:  return 3;
+    }
+    Q_ASSERT(false);
+    return 0;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// trackStore::field:
+//
+// Returns the text shown for field f of a track. Unknown numbers are
+// shown as empty cells.
+//
+QString trackStore::field(int track, int f) const {
+    switch(f) {
+    case TITLE:
+    case ARTIST:
+    case ALBUM:
+    case GENRE:  return value(f, valueId(track, f));
+    case PATH:   return path(track);
+    case TRACK:  return m_track[track] < 0 ? QString() : QString::number(m_track[track]);
+    case TIME:   return m_seconds[track] < 0 ? QString() : timeString(m_seconds[track]);
+    }
+    return QString();
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// trackStore::append:
+//
+// Moves a batch of scanned records into the columns. All columns are
+// grown once per batch, and a string equal to the previous record's
+// (the same artist, album or genre within a folder) reuses its value
+// ID without being converted again.
+//
+int trackStore::append(const QStringList &dirs, const QVector<scanRecord *> &records) {
+    int first = size();
+    int n     = first + records.size();
+
+    for(int d=0; d<DICTS; d++)
+        m_values[d].reserve(n);
+    m_dir      .reserve(n);
+    m_file     .reserve(n);
+    m_track    .reserve(n);
+    m_seconds  .reserve(n);
+    m_artOffset.reserve(n);
+    m_artSize  .reserve(n);
+    m_artMime  .reserve(n);
+    m_album    .reserve(n);
+    m_fileIndex.reserve(n);
+
+    // batch directory -> directory ID
+    QVector<int> dirIds(dirs.size(), -1);
+
+    const scanRecord *prev = NULL;
+    for(int i=0; i<records.size(); i++) {
+        const scanRecord *r = records[i];
+
+        m_values[0].append(intern(0, r->title,  prev ? &prev->title  : NULL));
+        m_values[1].append(intern(1, r->artist, prev ? &prev->artist : NULL));
+        m_values[2].append(intern(2, r->album,  prev ? &prev->album  : NULL));
+        m_values[3].append(intern(3, r->genre,  prev ? &prev->genre  : NULL));
+
+        int &dir = dirIds[r->dir];
+        if(dir < 0)
+            dir = internDir(dirs.at(r->dir));
+        QString file = QString::fromUtf8(r->file.data(), r->file.size);
+        m_fileIndex.insert(dirKey(dir, file), m_file.size());
+        m_dir .append(dir);
+        m_file.append(file);
+
+        m_track    .append(r->track);
+        m_seconds  .append(r->seconds);
+        m_artOffset.append(r->artOffset);
+        m_artSize  .append(r->artSize);
+        m_artMime  .append(mimeIndex(r->mime));
+
+        int album = internAlbum(r, prev);
+        m_album.append(album);
+        addToAlbum(album, m_file.size() - 1);
+        prev = r;
+    }
+    m_generation = nextGeneration();
+    return first;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// trackStore::append:
+//
+// Appends all tracks of other, in order, as if they had been scanned
+// into this store; albums shared with tracks already here are merged.
+// Untagged album artists come across resolved, which groups the same.
+//
+int trackStore::append(const trackStore &other) {
+    int first = size();
+
+    QStringList dirs;
+    for(int d=0; d<other.dirCount(); d++)
+        dirs << other.dirPath(d);
+
+    scanArena arena;
+    QVector<scanRecord *> records;
+    records.reserve(BATCH);
+    for(int t=0; t<other.size(); t++) {
+        const trackAlbum &album = other.albumInfo(other.albumOf(t));
+        scanRecord *rec = arena.make<scanRecord>();
+        rec->dir = other.dir(t);
+        arena.assign(&rec->file,        other.fileName(t));
+        arena.assign(&rec->title,       other.title(t));
+        arena.assign(&rec->artist,      other.artist(t));
+        arena.assign(&rec->album,       other.album(t));
+        arena.assign(&rec->albumArtist, other.value(ARTIST, album.artist));
+        arena.assign(&rec->genre,       other.genre(t));
+        arena.assign(&rec->mime,        other.artMime(t));
+        rec->track     = other.trackNumber(t);
+        rec->seconds   = other.seconds(t);
+        rec->artOffset = other.artOffset(t);
+        rec->artSize   = other.artSize(t);
+        records << rec;
+
+        if(records.size() == BATCH || t == other.size()-1) {
+            append(dirs, records);
+            records.resize(0);
+            arena.reset();
+        }
+    }
+    return first;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// trackStore::intern:
+//
+// Returns the value ID of s in table d, adding the value with its
+// collation key if it is new. prev is the same field of the previous
+// record, whose ID is the last one appended.
+//
+int trackStore::intern(int d, const scanString &s, const scanString *prev) {
+    if(prev && prev->equals(s))
+        return m_values[d].last();
+
+    dictionary &dict = m_dicts[d];
+    QString text = QString::fromUtf8(s.data(), s.size);
+    int id = dict.index.value(text, -1);
+    if(id < 0) {
+        id = dict.text.size();
+        dict.text << text;
+        dict.keys << m_collator.sortKey(text);
+        dict.index.insert(text, id);
+    }
+    return id;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// trackStore::internAlbum:
+//
+// Returns the album ID of a record just appended, adding the album if
+// it is new. A record with the same album and artists as the previous
+// one belongs to its album without a lookup.
+//
+int trackStore::internAlbum(const scanRecord *r, const scanRecord *prev) {
+    if(prev && prev->album.equals(r->album) && prev->albumArtist.equals(r->albumArtist) &&
+       (!r->albumArtist.isEmpty() || prev->artist.equals(r->artist)))
+        return m_album.last();
+
+    int artist = r->albumArtist.isEmpty() ? m_values[1].last()
+                                          : intern(1, r->albumArtist, NULL);
+    QPair<int,int> key(artist, m_values[2].last());
+    int id = m_albumIndex.value(key, -1);
+    if(id < 0) {
+        trackAlbum album;
+        album.artist  = key.first;
+        album.title   = key.second;
+        album.tracks  = 0;
+        album.seconds = 0;
+        album.art     = -1;
+
+        id = m_albums.size();
+        m_albums << album;
+        m_albumIndex.insert(key, id);
+    }
+    return id;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// trackStore::addToAlbum:
+//
+// Adds a track to an album's ranges and totals. The cover comes from
+// the first track with a picture, preferring one whose bytes can be
+// mapped over one that needs a tag parse.
+//
+void trackStore::addToAlbum(int album, int track) {
+    trackAlbum &a = m_albums[album];
+    if(!a.ranges.isEmpty() && a.ranges.last().second == track)
+        a.ranges.last().second++;
+    else
+        a.ranges << qMakePair(track, track + 1);
+
+    a.tracks++;
+    if(m_seconds[track] > 0)
+        a.seconds += m_seconds[track];
+
+    if(m_artSize[track] && (a.art < 0 || (m_artOffset[a.art] < 0 && m_artOffset[track] >= 0)))
+        a.art = track;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// trackStore::albumOrder:
+//
+// Returns all album IDs sorted by title, then by album artist.
+//
+QVector<int> trackStore::albumOrder() const {
+    QVector<int> order(m_albums.size());
+    for(int i=0; i<order.size(); i++)
+        order[i] = i;
+
+    const QList<QCollatorSortKey> &titles  = m_dicts[2].keys;
+    const QList<QCollatorSortKey> &artists = m_dicts[1].keys;
+    std::sort(order.begin(), order.end(), [&](int a, int b) {
+        const trackAlbum &x = m_albums[a], &y = m_albums[b];
+        int c = titles.at(x.title).compare(titles.at(y.title));
+        if(!c) c = artists.at(x.artist).compare(artists.at(y.artist));
+        return c ? c < 0 : a < b;
+    });
+    return order;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// trackStore::distinctValues:
+//
+// Collects the values of field f used by the given tracks, or by all
+// tracks, sorted by their collation keys.
+//
+QVector<int> trackStore::distinctValues(int f, const QVector<int> *tracks) const {
+    int d = dictOf(f);
+    const QVector<qint32> &ids = m_values[d];
+    QBitArray seen(m_dicts[d].text.size());
+
+    QVector<int> values;
+    int n = tracks ? tracks->size() : size();
+    for(int i=0; i<n; i++) {
+        int id = ids[tracks ? tracks->at(i) : i];
+        if(seen.testBit(id)) continue;
+        seen.setBit(id);
+        values << id;
+    }
+
+    const QList<QCollatorSortKey> &keys = m_dicts[d].keys;
+    std::sort(values.begin(), values.end(), [&keys](int a, int b) {
+        return keys.at(a).compare(keys.at(b)) < 0;
+    });
+    return values;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// trackStore::mimeIndex:
+//
+// Interns a picture MIME type; there are only a handful of them.
+//
+int trackStore::mimeIndex(const scanString &s) {
+    if(s.isEmpty()) return 0;
+
+    for(int i=1; i<m_mimeKeys.size(); i++) {
+        const QByteArray &key = m_mimeKeys.at(i);
+        if(key.size() == s.size && memcmp(key.constData(), s.data(), s.size) == 0)
+            return i;
+    }
+    if(m_mimes.size() > 255) return 0;
+
+    m_mimeKeys << QByteArray(s.data(), s.size);
+    m_mimes    << QString::fromUtf8(s.data(), s.size);
+    return m_mimes.size() - 1;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// trackStore::clear:
+//
+// Removes all tracks.
+//
+void trackStore::clear() {
+    for(int d=0; d<DICTS; d++) {
+        m_values[d].clear();
+        m_dicts [d] = dictionary();
+    }
+    m_dir      .clear();
+    m_file     .clear();
+    m_track    .clear();
+    m_seconds  .clear();
+    m_artOffset.clear();
+    m_artSize  .clear();
+    m_artMime  .clear();
+    m_album    .clear();
+    m_albums   .clear();
+    m_albumIndex.clear();
+    m_fileIndex.clear();
+    m_dirParent.clear();
+    m_dirName  .clear();
+    m_dirIndex .clear();
+    m_generation = nextGeneration();
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// trackStore::joinPath:
+//
+// Rebuilds the path of a directory, plus a file name inside it if
+// file is given, with a single allocation.
+//
+QString trackStore::joinPath(int dir, const QString *file) const {
+    int len = file ? file->size() + 1 : 0;
+    for(int d=dir; d>=0; d=m_dirParent[d])
+        len += m_dirName[d].size() + 1;
+    len--;
+
+    // the root of an absolute path
+    if(!len && dir >= 0) return QString("/");
+
+    QString path(len, Qt::Uninitialized);
+    QChar *out = path.data() + len;
+    if(file) {
+        out -= file->size();
+        memcpy(out, file->constData(), file->size() * sizeof(QChar));
+        *--out = '/';
+    }
+    for(int d=dir; d>=0; d=m_dirParent[d]) {
+        const QString &name = m_dirName[d];
+        out -= name.size();
+        memcpy(out, name.constData(), name.size() * sizeof(QChar));
+        if(m_dirParent[d] >= 0)
+            *--out = '/';
+    }
+    return path;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// trackStore::internDir:
+//
+// Returns the ID of a cleaned directory path, adding it and any
+// missing parents to the table.
+//
+int trackStore::internDir(const QString &path) {
+    QStringList names = path.split('/');
+    int dir = -1;
+    for(int i=0; i<names.size(); i++) {
+        // "/" splits into two empty names
+        if(i > 0 && names[i].isEmpty()) continue;
+
+        dirKey key(dir, names[i]);
+        int id = m_dirIndex.value(key, -1);
+        if(id < 0) {
+            id = m_dirName.size();
+            m_dirParent << dir;
+            m_dirName   << names[i];
+            m_dirIndex.insert(key, id);
+        }
+        dir = id;
+    }
+    return dir;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// trackStore::findDir:
+//
+// Returns the ID of a cleaned directory path, or -1.
+//
+int trackStore::findDir(const QString &path) const {
+    QStringList names = path.split('/');
+    int dir = -1;
+    for(int i=0; i<names.size(); i++) {
+        if(i > 0 && names[i].isEmpty()) continue;
+
+        dir = m_dirIndex.value(dirKey(dir, names[i]), -1);
+        if(dir < 0) return -1;
+    }
+    return dir;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// trackStore::find:
+//
+// Returns the track ID of a cleaned file path, or -1.
+//
+int trackStore::find(const QString &path) const {
+    int slash = path.lastIndexOf('/');
+    if(slash < 0) return -1;
+
+    int dir = findDir(slash ? path.left(slash) : QString());
+    if(dir < 0) return -1;
+    return m_fileIndex.value(dirKey(dir, path.mid(slash + 1)), -1);
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// trackStore::reportMemory:
+//
+// Adds the per-track columns, value tables, directories and albums to
+// report under "library". Collation keys are opaque; they are
+// estimated at a small header plus four bytes per character.
+//
+void trackStore::reportMemory(memoryReport *report) const {
+    typedef memoryReport mr;
+    int n = size();
+
+    qint64 columns = mr::vectorBytes(m_dir) + mr::vectorBytes(m_track) +
+                     mr::vectorBytes(m_seconds) + mr::vectorBytes(m_artOffset) +
+                     mr::vectorBytes(m_artSize) + mr::vectorBytes(m_artMime) +
+                     mr::vectorBytes(m_album);
+    for(int d=0; d<DICTS; d++)
+        columns += mr::vectorBytes(m_values[d]);
+    report->add("library", "track columns", columns, n);
+
+    qint64 files = mr::vectorBytes(m_file);
+    for(int i=0; i<n; i++)
+        files += mr::stringBytes(m_file[i]);
+    report->add("library", "file names", files, n);
+    report->add("library", "path index", mr::hashBytes(m_fileIndex), m_fileIndex.size());
+
+    static const char *names[DICTS] = {"titles", "artists", "albums", "genres"};
+    for(int d=0; d<DICTS; d++) {
+        const dictionary &dict = m_dicts[d];
+        qint64 text = mr::vectorBytes(dict.text);
+        qint64 keys = (qint64) dict.keys.size() * (sizeof(void *) + 32);
+        for(int i=0; i<dict.text.size(); i++) {
+            text += mr::stringBytes(dict.text[i]);
+            keys += dict.text[i].size() * 4;
+        }
+        report->add("library", QString("%1 text").arg(names[d]), text, dict.text.size());
+        report->add("library", QString("%1 sort keys (est.)").arg(names[d]), keys, dict.keys.size());
+        report->add("library", QString("%1 index").arg(names[d]), mr::hashBytes(dict.index), dict.index.size());
+    }
+
+    qint64 dirs = mr::vectorBytes(m_dirName) + mr::vectorBytes(m_dirParent) +
+                  mr::hashBytes(m_dirIndex);
+    for(int i=0; i<m_dirName.size(); i++)
+        dirs += mr::stringBytes(m_dirName[i]);
+    report->add("library", "directories", dirs, m_dirName.size());
+
+    qint64 albums = mr::vectorBytes(m_albums) + mr::hashBytes(m_albumIndex);
+    for(int i=0; i<m_albums.size(); i++)
+        albums += mr::vectorBytes(m_albums[i].ranges);
+    report->add("library", "albums", albums, m_albums.size());
+}
@@ -0,0 +1,160 @@
+#ifndef TRACKSTORE_H
+#define TRACKSTORE_H
+
+#include <QtCore>
+#include "scanArena.h"
+
+class memoryReport;
+
+// track fields; those after PATH are not shown in the table
+enum {TITLE, TRACK, TIME, ARTIST, ALBUM, GENRE, PATH};
+const int COLS = PATH;
+
+// tracks sharing an album artist and album title
+struct trackAlbum {
+    int                     artist;     // ARTIST value ID of the album artist
+    int                     title;      // ALBUM value ID
+    QVector<QPair<int,int>> ranges;     // runs [first, last) of track IDs
+    int                     tracks;
+    qint64                  seconds;    // total of the known lengths
+    int                     art;        // track whose picture is the cover, or -1
+};
+
+///////////////////////////////////////////////////////////////////////////////
+///
+/// \class trackStore
+/// \brief Column-wise storage of the music library.
+///
+/// Each field is kept in its own array indexed by track ID; numbers
+/// are stored as numbers and only formatted for display. Tracks are
+/// added in batches by the scanner and are never removed one by one.
+///
+/// Title, artist, album and genre are stored as IDs into a table of
+/// distinct values per field. Each value carries a collation key made
+/// once when it is first seen, so sorting compares keys instead of
+/// lower-casing strings.
+///
+/// Paths are not stored whole: each track keeps a directory ID and its
+/// file name, and directories form a table of names with parent links,
+/// so a folder's prefix is stored once however many tracks it holds.
+/// Full paths are rebuilt by path() when a file is opened.
+///
+/// Albums are grouped by (album artist, album) as tracks are appended,
+/// so two "Greatest Hits" by different artists stay apart. The album
+/// artist falls back to the track artist when it is not tagged.
+///
+///////////////////////////////////////////////////////////////////////////////
+
+class trackStore
+{
+public:
+    trackStore();
+
+    int             size() const    { return m_file.size(); }
+    bool            isEmpty() const { return m_file.isEmpty(); }
+
+    // display text of a table column or PATH
+    QString         field(int track, int f) const;
+
+    const QString  &title (int track) const { return value(TITLE,  valueId(track, TITLE)); }
+    const QString  &artist(int track) const { return value(ARTIST, valueId(track, ARTIST)); }
+    const QString  &album (int track) const { return value(ALBUM,  valueId(track, ALBUM)); }
+    const QString  &genre (int track) const { return value(GENRE,  valueId(track, GENRE)); }
+    const QString  &fileName(int track) const { return m_file[track]; }
+    int             dir(int track) const    { return m_dir[track]; }
+    QString         path(int track) const   { return joinPath(m_dir[track], &m_file[track]); }
+    int             trackNumber(int track) const { return m_track  [track]; }
+    int             seconds(int track) const     { return m_seconds[track]; }
+
+    // cover picture; artSize is 0 if the track has none
+    qint64          artOffset(int track) const   { return m_artOffset[track]; }
+    qint64          artSize(int track) const     { return m_artSize  [track]; }
+    const QString  &artMime(int track) const     { return m_mimes.at(m_artMime[track]); }
+
+    // distinct values of TITLE, ARTIST, ALBUM and GENRE
+    int             valueId(int track, int f) const { return m_values[dictOf(f)][track]; }
+    const QString  &value(int f, int id) const      { return m_dicts[dictOf(f)].text[id]; }
+    int             valueCount(int f) const         { return m_dicts[dictOf(f)].text.size(); }
+    const QCollatorSortKey &sortKey(int f, int id) const { return m_dicts[dictOf(f)].keys.at(id); }
+
+    // value IDs of f used by tracks (all if NULL), in collation order
+    QVector<int>    distinctValues(int f, const QVector<int> *tracks = NULL) const;
+
+    // albums
+    int             albumCount() const          { return m_albums.size(); }
+    int             albumOf(int track) const    { return m_album[track]; }
+    const trackAlbum &albumInfo(int album) const { return m_albums[album]; }
+    QVector<int>    albumOrder() const;         // by title, then album artist
+
+    // track ID of a cleaned path, or -1
+    int             find(const QString &path) const;
+
+    // directory table
+    int             dirCount() const        { return m_dirName.size(); }
+    int             dirParent(int dir) const { return m_dirParent[dir]; }
+    QString         dirPath(int dir) const  { return joinPath(dir, NULL); }
+    int             findDir(const QString &path) const;
+
+    // moves a batch of scanned records in; returns the first new ID
+    int             append(const QStringList &dirs, const QVector<scanRecord *> &records);
+    // appends all tracks of another store; returns the first new ID
+    int             append(const trackStore &other);
+    void            clear();
+
+    // changes whenever tracks or directories change, and differs between
+    // stores; for caches
+    quint64         generation() const  { return m_generation; }
+
+    // adds the store's rows to a memory report
+    void            reportMemory(memoryReport *report) const;
+
+    static QString  timeString(int seconds);
+
+private:
+    typedef QPair<int, QString> dirKey;     // parent, name
+
+    // distinct values of one text field
+    struct dictionary {
+        QVector<QString>        text;
+        QList<QCollatorSortKey> keys;
+        QHash<QString, int>     index;
+    };
+    enum {DICTS = 4};
+
+    static int      dictOf(int f);
+    int             intern(int d, const scanString &s, const scanString *prev);
+    int             mimeIndex(const scanString &s);
+    QString         joinPath(int dir, const QString *file) const;
+    int             internDir(const QString &path);
+    int             internAlbum(const scanRecord *r, const scanRecord *prev);
+    void            addToAlbum(int album, int track);
+
+    dictionary          m_dicts [DICTS];
+    QVector<qint32>     m_values[DICTS];    // value ID per track
+    QCollator           m_collator;
+    QVector<qint32>     m_dir;
+    QVector<QString>    m_file;
+    QVector<qint32>     m_track;
+    QVector<qint32>     m_seconds;
+    QVector<qint64>     m_artOffset;
+    QVector<qint64>     m_artSize;
+    QVector<quint8>     m_artMime;
+
+    QStringList         m_mimes;        // distinct MIME types; 0 is ""
+    QList<QByteArray>   m_mimeKeys;     // the same as UTF-8
+
+    // directories; the root of an absolute path has an empty name
+    QVector<qint32>     m_dirParent;    // -1 for a root
+    QVector<QString>    m_dirName;
+    QHash<dirKey, int>  m_dirIndex;
+    QHash<dirKey, int>  m_fileIndex;    // (dir, file name) -> track
+
+    // albums; (album artist, album) value IDs -> album ID
+    QVector<qint32>     m_album;        // album ID per track
+    QVector<trackAlbum> m_albums;
+    QHash<QPair<int,int>, int> m_albumIndex;
+
+    quint64             m_generation;
+};
+
+#endif // TRACKSTORE_H
@@ -5,6 +5,8 @@ QT += widgets
 QT += multimedia
 QT += core gui opengl
 QT += opengl
+QT += concurrent
+QT += network
 
 CONFIG += console
 TEMPLATE = app
@@ -13,5 +15,21 @@ INCLUDEPATH += -I /opt/local/include/taglib
 LIBS += -L/opt/local/lib
 LIBS += -ltag
 # Input
-HEADERS += MainWindow.h glWidget.h glvisualizer.h openPrompt.h
-SOURCES += main.cpp MainWindow.cpp glWidget.cpp glvisualizer.cpp openPrompt.cpp
+HEADERS += MainWindow.h glWidget.h glvisualizer.h frameOverlay.h openPrompt.h \
+           waveformCache.h waveformSlider.h \
+           playbackStats.h statsPanel.h memoryPanel.h playQueue.h sessionState.h playlistIO.h \
+           id3Reader.h scanArena.h trackStore.h libraryScanner.h libraryIndex.h coverArt.h allocStats.h memoryReport.h \
+           trackSorter.h trackBitmap.h queryEngine.h resultCache.h traceRecorder.h \
+           metricsRegistry.h metricsExporter.h
+SOURCES += main.cpp MainWindow.cpp glWidget.cpp glvisualizer.cpp frameOverlay.cpp openPrompt.cpp \
+           waveformCache.cpp waveformSlider.cpp \
+           playbackStats.cpp statsPanel.cpp memoryPanel.cpp playQueue.cpp sessionState.cpp playlistIO.cpp \
+           id3Reader.cpp scanArena.cpp trackStore.cpp libraryScanner.cpp libraryIndex.cpp coverArt.cpp allocStats.cpp memoryReport.cpp \
+           trackSorter.cpp trackBitmap.cpp queryEngine.cpp resultCache.cpp traceRecorder.cpp \
+           metricsRegistry.cpp metricsExporter.cpp
+
+# count heap allocations for the scan report (qmake CONFIG+=alloc_stats)
+alloc_stats: DEFINES += QTUNES_ALLOC_STATS
+
+# leave out the trace spans entirely (qmake CONFIG+=no_trace)
+no_trace: DEFINES += QTUNES_NO_TRACE
@@ -0,0 +1,358 @@
+#include "waveformCache.h"
+#include "traceRecorder.h"
+#include <cmath>
+
+// identifies an on-disk overview file
+const quint32 WAVE_MAGIC   = 0x57415645;
+const quint16 WAVE_VERSION = 1;
+
+// decoded blocks per second before reduction to BUCKETS
+const int BLOCKS_PER_SEC = 20;
+
+// number of overviews kept in memory
+const int MEMORY_TRACKS = 256;
+
+// number of overview files kept on disk (~1.2 KB each); the least
+// recently used are removed once this is exceeded
+const int DISK_TRACKS = 8192;
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// waveformCache::waveformCache:
+//
+// Constructor. Sets up the decoder and the cache directory.
+//
+waveformCache::waveformCache(QObject *parent)
+    : QObject(parent), m_memory(MEMORY_TRACKS), m_diskCount(0), m_blockSize(0) {
+    m_dir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation)
+            + "/waveforms";
+    QDir().mkpath(m_dir);
+    pruneDisk();
+
+    // ask for small mono buffers; the overview doesn't need more
+    QAudioFormat format;
+    format.setCodec("audio/pcm");
+    format.setChannelCount(1);
+    format.setSampleRate(8000);
+    format.setSampleSize(16);
+    format.setSampleType(QAudioFormat::SignedInt);
+    format.setByteOrder(QAudioFormat::LittleEndian);
+
+    m_decoder = new QAudioDecoder(this);
+    m_decoder->setAudioFormat(format);
+
+    connect(m_decoder, SIGNAL(bufferReady()), this, SLOT(s_bufferReady()));
+    connect(m_decoder, SIGNAL(finished()),    this, SLOT(s_finished()));
+    connect(m_decoder, SIGNAL(error(QAudioDecoder::Error)),
+            this, SLOT(s_error(QAudioDecoder::Error)));
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// waveformCache::~waveformCache:
+//
+// Destructor.
+//
+waveformCache::~waveformCache() {
+    m_decoder->stop();
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// waveformCache::fingerprint:
+//
+// Identifies a file by path, size and modification time so that
+// edited files get a fresh overview.
+//
+QString waveformCache::fingerprint(const QString &path) const {
+    QFileInfo info(path);
+    QByteArray key = path.toUtf8();
+    key += '\0' + QByteArray::number(info.size());
+    key += '\0' + QByteArray::number(info.lastModified().toMSecsSinceEpoch());
+    return QCryptographicHash::hash(key, QCryptographicHash::Sha1).toHex();
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// waveformCache::cacheFile:
+//
+// Returns the on-disk location of an overview.
+//
+QString waveformCache::cacheFile(const QString &fp) const {
+    return QString("%1/%2.wave").arg(m_dir).arg(fp);
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// waveformCache::lookup:
+//
+// Fetches an overview from memory or disk. Returns false if the track
+// has not been generated yet; the caller should request() it.
+//
+bool waveformCache::lookup(const QString &path, waveformOverview *out) {
+    QString fp = fingerprint(path);
+
+    if(waveformOverview *wave = m_memory.object(fp)) {
+        *out = *wave;
+        return true;
+    }
+
+    if(!readFile(fp, out)) return false;
+
+    // touch the file so pruneDisk() sees it as recently used
+    QFile file(cacheFile(fp));
+    if(file.open(QIODevice::ReadWrite))
+        file.setFileTime(QDateTime::currentDateTime(), QFileDevice::FileModificationTime);
+
+    m_memory.insert(fp, new waveformOverview(*out));
+    return true;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// waveformCache::memoryBytes:
+//
+// Estimates the overviews in memory and the blocks being decoded.
+//
+qint64 waveformCache::memoryBytes() const {
+    // three vectors of BUCKETS bytes plus their headers and the key
+    qint64 perTrack = 3 * (BUCKETS + sizeof(QArrayData)) + sizeof(QArrayData) + 80;
+    return m_memory.size() * perTrack + m_blocks.capacity() * sizeof(block);
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// waveformCache::request:
+//
+// Queues a track for generation. Tracks already cached are ignored.
+//
+void waveformCache::request(const QString &path, bool urgent) {
+    if(path.isEmpty() || path == m_current) return;
+
+    int index = m_pending.indexOf(path);
+    if(index >= 0) {
+        if(urgent) m_pending.move(index, 0);
+        return;
+    }
+
+    QString fp = fingerprint(path);
+    if(m_memory.contains(fp) || QFile::exists(cacheFile(fp))) return;
+
+    if(urgent)
+        m_pending.prepend(path);
+    else
+        m_pending.append(path);
+
+    if(m_current.isEmpty())
+        startNext();
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// waveformCache::startNext:
+//
+// Starts decoding the next queued track, if any.
+//
+void waveformCache::startNext() {
+    m_current.clear();
+    if(m_pending.isEmpty()) return;
+
+    m_current   = m_pending.takeFirst();
+    m_currentFp = fingerprint(m_current);
+    m_blocks.clear();
+    m_blockSize = 0;
+
+    m_decoder->setSourceFilename(m_current);
+    m_decoder->start();
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// waveformCache::addSample:
+//
+// Folds one sample in [-1,1] into the current block.
+//
+void waveformCache::addSample(float s) {
+    if(m_blocks.isEmpty() || m_blocks.last().count >= m_blockSize) {
+        block b = { s, s, 0.0, 0 };
+        m_blocks.append(b);
+    }
+
+    block &b = m_blocks.last();
+    if(s < b.min) b.min = s;
+    if(s > b.max) b.max = s;
+    b.sumSq += s*s;
+    b.count++;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// waveformCache::s_bufferReady:
+//
+// Slot function that consumes one decoded buffer. Samples are reduced
+// to blocks right away so the full decode is never held in memory.
+//
+void waveformCache::s_bufferReady() {
+    TRACE_SLOT("waveformCache::s_bufferReady");
+    QAudioBuffer buffer = m_decoder->read();
+    QAudioFormat format = buffer.format();
+    int channels = format.channelCount();
+    int frames   = buffer.frameCount();
+    if(channels <= 0) return;
+
+    if(!m_blockSize)
+        m_blockSize = qMax(1, format.sampleRate() / BLOCKS_PER_SEC);
+
+    if(format.sampleType() == QAudioFormat::SignedInt && format.sampleSize() == 16) {
+        const qint16 *data = buffer.constData<qint16>();
+        for(int i=0; i<frames; i++) {
+            int sum = 0;
+            for(int c=0; c<channels; c++)
+                sum += data[i*channels + c];
+            addSample(sum / (32768.0f * channels));
+        }
+    }
+    else if(format.sampleType() == QAudioFormat::Float && format.sampleSize() == 32) {
+        const float *data = buffer.constData<float>();
+        for(int i=0; i<frames; i++) {
+            float sum = 0;
+            for(int c=0; c<channels; c++)
+                sum += data[i*channels + c];
+            addSample(sum / channels);
+        }
+    }
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// waveformCache::s_finished:
+//
+// Slot function that reduces the decoded blocks to BUCKETS entries,
+// stores the result and moves on to the next queued track.
+//
+void waveformCache::s_finished() {
+    TRACE_SLOT("waveformCache::s_finished");
+    m_decoder->stop();
+
+    int n = m_blocks.size();
+    if(n > 0) {
+        waveformOverview wave;
+        wave.min.resize(BUCKETS);
+        wave.max.resize(BUCKETS);
+        wave.rms.resize(BUCKETS);
+
+        for(int b=0; b<BUCKETS; b++) {
+            int first = (qint64) b * n / BUCKETS;
+            int last  = qMax(first + 1, (int) ((qint64) (b+1) * n / BUCKETS));
+
+            float  lo = 1.0f, hi = -1.0f;
+            double sumSq = 0;
+            int    count = 0;
+            for(int i=first; i<last && i<n; i++) {
+                lo = qMin(lo, m_blocks[i].min);
+                hi = qMax(hi, m_blocks[i].max);
+                sumSq += m_blocks[i].sumSq;
+                count += m_blocks[i].count;
+            }
+
+            float rms = count ? sqrt(sumSq / count) : 0.0f;
+            wave.min[b] = (qint8)  qBound(-127, qRound(lo  * 127), 127);
+            wave.max[b] = (qint8)  qBound(-127, qRound(hi  * 127), 127);
+            wave.rms[b] = (quint8) qBound(0,    qRound(rms * 255), 255);
+        }
+
+        m_memory.insert(m_currentFp, new waveformOverview(wave));
+        writeFile(m_currentFp, wave);
+        emit ready(m_current);
+    }
+
+    m_blocks.clear();
+    startNext();
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// waveformCache::s_error:
+//
+// Slot function that skips tracks the decoder cannot handle.
+//
+void waveformCache::s_error(QAudioDecoder::Error) {
+    TRACE_SLOT("waveformCache::s_error");
+    qWarning() << "waveform: cannot decode" << m_current << m_decoder->errorString();
+    m_decoder->stop();
+    m_blocks.clear();
+    startNext();
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// waveformCache::readFile:
+//
+// Loads an overview from the disk cache.
+//
+bool waveformCache::readFile(const QString &fp, waveformOverview *out) const {
+    QFile file(cacheFile(fp));
+    if(!file.open(QIODevice::ReadOnly)) return false;
+
+    QDataStream in(&file);
+    quint32 magic;
+    quint16 version;
+    in >> magic >> version;
+    if(magic != WAVE_MAGIC || version != WAVE_VERSION) return false;
+
+    waveformOverview wave;
+    in >> wave.min >> wave.max >> wave.rms;
+    if(in.status() != QDataStream::Ok || wave.rms.size() != BUCKETS) return false;
+
+    *out = wave;
+    return true;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// waveformCache::writeFile:
+//
+// Saves an overview to the disk cache.
+//
+void waveformCache::writeFile(const QString &fp, const waveformOverview &wave) {
+    QSaveFile file(cacheFile(fp));
+    if(!file.open(QIODevice::WriteOnly)) return;
+
+    QDataStream out(&file);
+    out << WAVE_MAGIC << WAVE_VERSION << wave.min << wave.max << wave.rms;
+    if(file.commit() && ++m_diskCount > DISK_TRACKS)
+        pruneDisk();
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// waveformCache::pruneDisk:
+//
+// Removes the least recently used overview files until the disk cache
+// is back to 3/4 of DISK_TRACKS, so pruning doesn't run on every write.
+//
+void waveformCache::pruneDisk() {
+    QDir dir(m_dir);
+    QFileInfoList files = dir.entryInfoList(QStringList("*.wave"), QDir::Files, QDir::Time);
+    m_diskCount = files.size();
+    if(m_diskCount <= DISK_TRACKS) return;
+
+    // newest first, so drop from the back
+    int keep = DISK_TRACKS * 3 / 4;
+    for(int i=files.size()-1; i>=keep; i--)
+        if(QFile::remove(files[i].absoluteFilePath()))
+            m_diskCount--;
+}
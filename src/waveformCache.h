@@ -0,0 +1,74 @@
+#ifndef WAVEFORMCACHE_H
+#define WAVEFORMCACHE_H
+
+#include <QtCore>
+#include <QtMultimedia>
+
+// min/max/rms summary of a whole track, one entry per bucket
+struct waveformOverview {
+    QVector<qint8>  min;
+    QVector<qint8>  max;
+    QVector<quint8> rms;
+
+    bool isEmpty() const { return rms.isEmpty(); }
+};
+
+class waveformCache : public QObject
+{
+    Q_OBJECT
+
+public:
+    // number of buckets stored per track
+    static const int BUCKETS = 400;
+
+    waveformCache(QObject *parent = 0);
+    ~waveformCache();
+
+    // returns cached overview from memory or disk; never decodes
+    bool        lookup(const QString &path, waveformOverview *out);
+
+    // queue path for background generation (urgent requests go first)
+    void        request(const QString &path, bool urgent = false);
+
+    // overviews held in memory and their size
+    int         memoryCount() const     { return m_memory.size(); }
+    qint64      memoryBytes() const;
+
+signals:
+    void        ready(const QString &path);
+
+private slots:
+    void        s_bufferReady();
+    void        s_finished();
+    void        s_error(QAudioDecoder::Error);
+
+private:
+    // accumulated samples of one fine-grained block
+    struct block {
+        float   min;
+        float   max;
+        double  sumSq;
+        int     count;
+    };
+
+    QString     fingerprint(const QString &path) const;
+    QString     cacheFile(const QString &fp) const;
+    bool        readFile(const QString &fp, waveformOverview *out) const;
+    void        writeFile(const QString &fp, const waveformOverview &wave);
+    void        pruneDisk();
+    void        addSample(float s);
+    void        startNext();
+
+    QAudioDecoder               *m_decoder;
+    QStringList                 m_pending;
+    QString                     m_current;
+    QString                     m_currentFp;
+    QString                     m_dir;
+    QCache<QString, waveformOverview> m_memory;
+    int                         m_diskCount;
+
+    QVector<block>              m_blocks;
+    int                         m_blockSize;
+};
+
+#endif // WAVEFORMCACHE_H
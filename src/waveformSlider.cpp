@@ -0,0 +1,154 @@
+#include "waveformSlider.h"
+#include <QtWidgets>
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// waveformSlider::waveformSlider:
+//
+// Constructor. Behaves as a plain horizontal slider until an
+// overview is set.
+//
+waveformSlider::waveformSlider(QWidget *parent)
+    : QSlider(Qt::Horizontal, parent) {
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// waveformSlider::setOverview:
+//
+// Sets the overview of the current track and repaints.
+//
+void waveformSlider::setOverview(const waveformOverview &wave) {
+    m_wave = wave;
+    update();
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// waveformSlider::clearOverview:
+//
+// Drops the overview; the slider is drawn normally again.
+//
+void waveformSlider::clearOverview() {
+    m_wave = waveformOverview();
+    update();
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// waveformSlider::sizeHint:
+//
+// Leave room for the waveform.
+//
+QSize waveformSlider::sizeHint() const {
+    QSize size = QSlider::sizeHint();
+    size.setHeight(qMax(size.height(), 32));
+    return size;
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// waveformSlider::paintEvent:
+//
+// Draws min/max peaks with the rms band on top, the played part
+// highlighted and a line at the current position.
+//
+void waveformSlider::paintEvent(QPaintEvent *event) {
+    if(m_wave.isEmpty()) {
+        QSlider::paintEvent(event);
+        return;
+    }
+
+    QPainter painter(this);
+    int w   = width();
+    int h   = height();
+    int mid = h / 2;
+    int n   = m_wave.rms.size();
+    int range = maximum() - minimum();
+    int played = range > 0 ? (qint64) (value() - minimum()) * w / range : 0;
+
+    QColor peak = palette().color(QPalette::Mid);
+    QColor body = palette().color(QPalette::Dark);
+    QColor done = palette().color(isEnabled() ? QPalette::Highlight : QPalette::Mid);
+
+    painter.fillRect(rect(), palette().color(QPalette::Base));
+
+    for(int x=0; x<w; x++) {
+        int b = x * n / w;
+        int top    = mid - m_wave.max[b] * mid / 127;
+        int bottom = mid - m_wave.min[b] * mid / 127;
+        int rms    = m_wave.rms[b] * mid / 255;
+
+        painter.setPen(x < played ? done.lighter(130) : peak);
+        painter.drawLine(x, top, x, bottom);
+        painter.setPen(x < played ? done : body);
+        painter.drawLine(x, mid - rms, x, mid + rms);
+    }
+
+    painter.setPen(palette().color(QPalette::Text));
+    painter.drawLine(played, 0, played, h);
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// waveformSlider::valueAt:
+//
+// Maps a widget x-coordinate to a slider value.
+//
+int waveformSlider::valueAt(int x) const {
+    return QStyle::sliderValueFromPosition(minimum(), maximum(),
+                                           qBound(0, x, width()), width());
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// waveformSlider::mousePressEvent:
+//
+// Seek directly to the clicked point instead of paging.
+//
+void waveformSlider::mousePressEvent(QMouseEvent *event) {
+    if(m_wave.isEmpty() || event->button() != Qt::LeftButton) {
+        QSlider::mousePressEvent(event);
+        return;
+    }
+    setSliderDown(true);
+    setValue(valueAt(event->x()));
+    event->accept();
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// waveformSlider::mouseMoveEvent:
+//
+// Drag the position while the button is held.
+//
+void waveformSlider::mouseMoveEvent(QMouseEvent *event) {
+    if(m_wave.isEmpty() || !isSliderDown()) {
+        QSlider::mouseMoveEvent(event);
+        return;
+    }
+    setValue(valueAt(event->x()));
+    event->accept();
+}
+
+
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// waveformSlider::mouseReleaseEvent:
+//
+// Finish dragging.
+//
+void waveformSlider::mouseReleaseEvent(QMouseEvent *event) {
+    if(m_wave.isEmpty() || !isSliderDown()) {
+        QSlider::mouseReleaseEvent(event);
+        return;
+    }
+    setSliderDown(false);
+    event->accept();
+}
@@ -0,0 +1,31 @@
+#ifndef WAVEFORMSLIDER_H
+#define WAVEFORMSLIDER_H
+
+#include <QSlider>
+#include "waveformCache.h"
+
+class waveformSlider : public QSlider
+{
+    Q_OBJECT
+
+public:
+    waveformSlider(QWidget *parent = 0);
+
+    // overview drawn behind the play position
+    void        setOverview(const waveformOverview &wave);
+    void        clearOverview();
+
+protected:
+    void        paintEvent(QPaintEvent *);
+    void        mousePressEvent(QMouseEvent *);
+    void        mouseMoveEvent(QMouseEvent *);
+    void        mouseReleaseEvent(QMouseEvent *);
+    QSize       sizeHint() const;
+
+private:
+    int         valueAt(int x) const;
+
+    waveformOverview    m_wave;
+};
+
+#endif // WAVEFORMSLIDER_H